@@ -0,0 +1,108 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+/** \addtogroup Drivers_Programable Drivers Programable
+ ** @{ */
+/** \addtogroup Drivers_Devices Drivers devices
+ ** @{ */
+/** \addtogroup Button Button
+ ** @{ */
+
+/** \brief Software debounce and gesture driver for push buttons.
+ *
+ * All registered buttons are sampled together from one periodic software timer.
+ * Each button runs an integrator: its state only changes after the input stays
+ * at the new level for BUTTON_DEBOUNCE_SAMPLES consecutive samples, so mechanical
+ * bounce is removed without per-edge interruptions. Debounced changes are turned
+ * into events (press, release, long press, double click) that the application
+ * reads from a queue.
+ * 
+ * @note ESP-EDU switches can be registered with ButtonAdd(GPIO_4, true) and 
+ * ButtonAdd(GPIO_15, true).
+ *
+ * @section changelog
+ *
+ * |   Date	    | Description                                    						|
+ * |:----------:|:----------------------------------------------------------------------|
+ * | 19/10/2026 | Document creation		                         						|
+ * 
+ **/
+
+/*==================[inclusions]=============================================*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "gpio_mcu.h"
+/*==================[macros]=================================================*/
+#define BUTTON_MAX_QTY				8		/**< Max number of registered buttons */
+#define BUTTON_SAMPLE_PERIOD_MS		5		/**< Sampling period */
+#define BUTTON_DEBOUNCE_SAMPLES		4		/**< Stable samples needed to accept a change (20 ms) */
+#define BUTTON_LONG_PRESS_MS		1000	/**< Press time to report BUTTON_LONG_PRESS */
+#define BUTTON_DOUBLE_CLICK_MS		400		/**< Max time between releases to report BUTTON_DOUBLE_CLICK */
+#define BUTTON_QUEUE_SIZE			16		/**< Event queue capacity */
+/*==================[typedef]================================================*/
+/**
+ * @brief Button events
+ */
+typedef enum {
+	BUTTON_PRESS = 0,		/**< Button pressed (debounced) */
+	BUTTON_RELEASE,			/**< Button released (debounced) */
+	BUTTON_LONG_PRESS,		/**< Button held for BUTTON_LONG_PRESS_MS (reported once per press) */
+	BUTTON_DOUBLE_CLICK		/**< Second short click within BUTTON_DOUBLE_CLICK_MS (reported after its release) */
+} button_event_type_t;
+
+/**
+ * @brief Button event
+ */
+typedef struct {
+	gpio_t pin;					/**< Button GPIO */
+	button_event_type_t type;	/**< Event */
+	uint32_t time_ms;			/**< Event time in ms since ButtonsInit */
+} button_event_t;
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/**
+ * @brief Create the event queue and start the sampling timer
+ * 
+ * @return true on success
+ */
+bool ButtonsInit(void);
+
+/**
+ * @brief Register a button
+ * 
+ * @param pin Button GPIO (configured as input with pull-up)
+ * @param active_low true if the button pulls the input to GND when pressed
+ * @return true on success, false if BUTTON_MAX_QTY buttons are already registered
+ */
+bool ButtonAdd(gpio_t pin, bool active_low);
+
+/**
+ * @brief Get the next button event
+ * 
+ * @param event Container for the event
+ * @param timeout_ms Max time to wait for an event (0: don't wait)
+ * @return true if an event was read
+ */
+bool ButtonGetEvent(button_event_t *event, uint32_t timeout_ms);
+
+/**
+ * @brief Debounced state of a button
+ * 
+ * @param pin Button GPIO
+ * @return true if pressed
+ */
+bool ButtonIsPressed(gpio_t pin);
+
+/**
+ * @brief Number of events lost because the queue was full
+ * 
+ * @return uint32_t Lost events since ButtonsInit
+ */
+uint32_t ButtonLostEvents(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+#endif
+
+/*==================[end of file]============================================*/
@@ -33,6 +33,8 @@
  * |   Date	    | Description                                    |
  * |:----------:|:-----------------------------------------------|
  * | 18/01/2024 | Document creation		                         |
+ * | 19/10/2026 | SPI device created once, DC set per transaction |
+ * | 19/10/2026 | Pixels streamed from two DMA buffers			 |
  *
  */
 
@@ -34,6 +34,7 @@
 #define MPU6050_ADDRESS_AD0_LOW     0x68 // address pin low (GND), default for InvenSense evaluation board
 #define MPU6050_ADDRESS_AD0_HIGH    0x69 // address pin high (VCC)
 #define MPU6050_DEFAULT_ADDRESS     MPU6050_ADDRESS_AD0_LOW
+#define MPU6050_MOTION6_RAW_SIZE    14   // ACCEL_XOUT_H to GYRO_ZOUT_L
 
 #define MPU6050_RA_XG_OFFS_TC       0x00 //[7] PWR_MODE, [6:1] XG_OFFS_TC, [0] OTP_BNK_VLD
 #define MPU6050_RA_YG_OFFS_TC       0x01 //[7] PWR_MODE, [6:1] YG_OFFS_TC, [0] OTP_BNK_VLD
@@ -1849,6 +1850,30 @@ void MPU6050_getMotion9(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int1
  */
 void MPU6050_getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
 
+/** Request raw 6-axis motion sensor readings through the asynchronous I2C queue.
+ * The call returns immediately; raw is filled by the I2C bus worker, which then
+ * calls func_p and/or notifies notify_task. Decode the result with
+ * MPU6050_parseMotion6(). I2C_QueueInit() must be called first.
+ * @param raw Buffer of MPU6050_MOTION6_RAW_SIZE bytes, valid until completion
+ * @param func_p Completion callback, or NULL
+ * @param param_p Completion callback parameter
+ * @param notify_task Task to notify on completion, or NULL
+ * @return True if the request was queued
+ * @see getMotion6()
+ */
+bool MPU6050_getMotion6Async(uint8_t *raw, void (*func_p)(void *param, esp_err_t result, uint32_t latency_us), void *param_p, TaskHandle_t notify_task);
+
+/** Decode a raw buffer filled by MPU6050_getMotion6Async().
+ * @param raw Buffer of MPU6050_MOTION6_RAW_SIZE bytes
+ * @param ax 16-bit signed integer container for accelerometer X-axis value
+ * @param ay 16-bit signed integer container for accelerometer Y-axis value
+ * @param az 16-bit signed integer container for accelerometer Z-axis value
+ * @param gx 16-bit signed integer container for gyroscope X-axis value
+ * @param gy 16-bit signed integer container for gyroscope Y-axis value
+ * @param gz 16-bit signed integer container for gyroscope Z-axis value
+ */
+void MPU6050_parseMotion6(const uint8_t *raw, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+
 /** Get 3-axis accelerometer readings.
  * These registers store the most recent accelerometer measurements.
  * Accelerometer measurements are written to these registers at the Sample Rate
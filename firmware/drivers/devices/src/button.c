@@ -0,0 +1,162 @@
+/**
+ * @file button.c
+ * @brief Push button debounce and gestures, sampled from a periodic esp_timer
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+/*==================[inclusions]=============================================*/
+#include "button.h"
+#include "gpio_mcu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+/*==================[macros and definitions]=================================*/
+typedef struct{
+	gpio_t pin;				/*!< Button GPIO */
+	bool active_low;		/*!< Pressed level is low */
+	bool pressed;			/*!< Debounced state */
+	bool long_reported;		/*!< BUTTON_LONG_PRESS already sent for this press */
+	bool click_pending;		/*!< A short click was released, waiting for a second one */
+	uint8_t integrator;		/*!< 0: released ... BUTTON_DEBOUNCE_SAMPLES: pressed */
+	uint32_t press_ms;		/*!< Time of the last press */
+	uint32_t release_ms;	/*!< Time of the last short click release */
+} button_t;
+/*==================[internal data declaration]==============================*/
+static button_t buttons[BUTTON_MAX_QTY];
+static volatile uint8_t button_qty = 0;
+static uint32_t tick_ms = 0;
+static uint32_t lost_events = 0;
+static QueueHandle_t button_queue = NULL;
+static esp_timer_handle_t button_timer = NULL;
+/*==================[internal functions declaration]=========================*/
+static void ButtonSendEvent(button_t *btn, button_event_type_t type);
+static void ButtonUpdate(button_t *btn, bool active);
+static void ButtonTimerCallback(void *arg);
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static void ButtonSendEvent(button_t *btn, button_event_type_t type){
+	button_event_t event = {
+		.pin = btn->pin,
+		.type = type,
+		.time_ms = tick_ms,
+	};
+	if(xQueueSend(button_queue, &event, 0) != pdTRUE){
+		lost_events++;
+	}
+}
+
+static void ButtonUpdate(button_t *btn, bool active){
+	/* Integrator: count towards the sampled level, saturating at both ends */
+	if(active){
+		if(btn->integrator < BUTTON_DEBOUNCE_SAMPLES){
+			btn->integrator++;
+		}
+	} else if(btn->integrator > 0){
+		btn->integrator--;
+	}
+
+	if(!btn->pressed && (btn->integrator == BUTTON_DEBOUNCE_SAMPLES)){
+		btn->pressed = true;
+		btn->long_reported = false;
+		btn->press_ms = tick_ms;
+		ButtonSendEvent(btn, BUTTON_PRESS);
+	} else if(btn->pressed && (btn->integrator == 0)){
+		btn->pressed = false;
+		ButtonSendEvent(btn, BUTTON_RELEASE);
+		if(btn->long_reported){
+			btn->click_pending = false;
+		} else if(btn->click_pending && ((tick_ms - btn->release_ms) <= BUTTON_DOUBLE_CLICK_MS)){
+			btn->click_pending = false;
+			ButtonSendEvent(btn, BUTTON_DOUBLE_CLICK);
+		} else {
+			btn->click_pending = true;
+			btn->release_ms = tick_ms;
+		}
+	} else if(btn->pressed && !btn->long_reported && ((tick_ms - btn->press_ms) >= BUTTON_LONG_PRESS_MS)){
+		btn->long_reported = true;
+		ButtonSendEvent(btn, BUTTON_LONG_PRESS);
+	}
+}
+
+static void ButtonTimerCallback(void *arg){
+	uint32_t port = GPIOReadPort();
+	uint8_t qty = button_qty;
+	tick_ms += BUTTON_SAMPLE_PERIOD_MS;
+	for(uint8_t i=0; i<qty; i++){
+		bool level = (port & GPIO_MASK(buttons[i].pin)) != 0;
+		ButtonUpdate(&buttons[i], level != buttons[i].active_low);
+	}
+}
+
+/*==================[external functions definition]==========================*/
+bool ButtonsInit(void){
+	if(button_timer != NULL){
+		return true;
+	}
+	button_queue = xQueueCreate(BUTTON_QUEUE_SIZE, sizeof(button_event_t));
+	if(button_queue == NULL){
+		return false;
+	}
+	const esp_timer_create_args_t timer_args = {
+		.callback = ButtonTimerCallback,
+		.name = "buttons",
+	};
+	if(esp_timer_create(&timer_args, &button_timer) != ESP_OK){
+		vQueueDelete(button_queue);
+		button_queue = NULL;
+		return false;
+	}
+	if(esp_timer_start_periodic(button_timer, BUTTON_SAMPLE_PERIOD_MS * 1000) != ESP_OK){
+		/* nothing would sample the buttons: release everything so a retry starts over */
+		esp_timer_delete(button_timer);
+		button_timer = NULL;
+		vQueueDelete(button_queue);
+		button_queue = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool ButtonAdd(gpio_t pin, bool active_low){
+	uint8_t qty = button_qty;
+	if(qty >= BUTTON_MAX_QTY){
+		return false;
+	}
+	GPIOInit(pin, GPIO_INPUT);
+	buttons[qty] = (button_t){
+		.pin = pin,
+		.active_low = active_low,
+	};
+	/* Publish the new entry only after it is fully initialized */
+	button_qty = qty + 1;
+	return true;
+}
+
+bool ButtonGetEvent(button_event_t *event, uint32_t timeout_ms){
+	if(button_queue == NULL){
+		return false;
+	}
+	return xQueueReceive(button_queue, event, timeout_ms / portTICK_PERIOD_MS) == pdTRUE;
+}
+
+bool ButtonIsPressed(gpio_t pin){
+	for(uint8_t i=0; i<button_qty; i++){
+		if(buttons[i].pin == pin){
+			return buttons[i].pressed;
+		}
+	}
+	return false;
+}
+
+uint32_t ButtonLostEvents(void){
+	return lost_events;
+}
+
+/*==================[end of file]============================================*/
@@ -15,6 +15,7 @@
 #include "spi_mcu.h"
 #include "gpio_mcu.h"
 #include "delay_mcu.h"
+#include "esp_attr.h"
 /*==================[macros and definitions]=================================*/
 #define NULL 0
 
@@ -22,7 +23,7 @@
 #define MAX_PIXEL 320*240*2			/*!< Maximum number of bytes to write on LCD */
 #define MSK_BIT16 0x8000			/*!< 16th bit mask */
 #define MSK_BIT8 0x80				/*!< 8th bit mask */
-#define MAX_VALUE_SIZE 256			/*!< Maximum length of a data array to prevent excessive use of memory */
+#define LCD_BUF_SIZE 3840			/*!< Bytes of each pixel buffer: 8 portrait or 6 landscape lines (SPI bus limit: 4092) */
 #define LEFT -1						/*!< Horizontal grow direction */
 #define RIGHT 1						/*!< Horizontal grow direction */
 #define DOWN 1						/*!< Vertical grow direction */
@@ -62,6 +63,9 @@
 #define EN_3_GAMMA			0xF2	/*!< 3 gamma control enable */
 #define PUMP_RATIO_CTRL		0xF7	/*!< Pump ratio control */
 
+#define LCD_DC_CMD	((void *)0)		/*!< SPI transaction user data: DC low, command */
+#define LCD_DC_DATA	((void *)1)		/*!< SPI transaction user data: DC high, parameters or data */
+
 #define HighByte(x) x >> 8			/*!< High byte of a 16 bits data */
 #define LowByte(x) x & 0xFF			/*!< Low byte of a 16 bits data */
 /*==================[typedef]================================================*/
@@ -86,6 +90,14 @@ typedef struct {
 
 /*==================[internal functions declaration]=========================*/
 
+/**
+ * @brief  		Queue command and parameters/data to LCD, without waiting for the transfer
+ * @param[in]  	data: Structure with the command and parameters/data to send. Data longer than
+ * 				SPI_QUEUE_COPY_LEN must not change until the transfer ends (see WriteLCD)
+ * @retval 		None
+ */
+void QueueLCD(lcd_cmd_t * data);
+
 /**
  * @brief  		Send command and parameters/data to LCD
  * @param[in]  	data: Structure with the command and parameters/data to send
@@ -93,6 +105,26 @@ typedef struct {
  */
 void WriteLCD(lcd_cmd_t * data);
 
+/**
+ * @brief  		Get the pixel buffer to fill next, waits for the transfer that was using it
+ * @retval 		Pointer to a LCD_BUF_SIZE bytes DMA buffer
+ */
+uint8_t * PixelBuffer(void);
+
+/**
+ * @brief  		Queue the pixel buffer given by PixelBuffer, the other one is used next
+ * @param[in]  	bytes: Number of bytes filled
+ * @retval 		None
+ */
+void SendPixelBuffer(uint32_t bytes);
+
+/**
+ * @brief  		SPI pre-transfer callback: sets DC for the transaction about to start
+ * @param[in]  	dc: LCD_DC_CMD or LCD_DC_DATA
+ * @retval 		None
+ */
+void LcdPreTransfer(void * dc);
+
 /**
  * @brief  		Define an area of frame memory where MCU can access
  * @param[in]  	x1: Start column
@@ -183,6 +215,9 @@ spi_mcu_config_t spi_conf = {
 	.param_p = NULL };
 
 static spi_dev_t ili9341_spi;				/*!< uC SPI port */
+/* Ping-pong pixel buffers: one is filled while the other is on the wire */
+static DMA_ATTR uint8_t pixel_buf[2][LCD_BUF_SIZE];
+static uint8_t pixel_buf_idx = 0;			/*!< Buffer given by PixelBuffer */
 static gpio_t ili9341_dc, ili9341_rst;		/*!< uC GPIO ports to use as CS, DC and RST */
 
 static orientation_properties_t lcd_orientation = {
@@ -193,22 +228,40 @@ static orientation_properties_t lcd_orientation = {
 
 /*==================[internal functions definition]==========================*/
 
-void WriteLCD(lcd_cmd_t * data){
-	SpiInit(&spi_conf);
+void IRAM_ATTR LcdPreTransfer(void * dc){
+	GPIOWriteMask(GPIO_MASK(ili9341_dc), (dc == LCD_DC_DATA) ? GPIO_MASK(ili9341_dc) : 0);
+}
+
+void QueueLCD(lcd_cmd_t * data){
 	/* If command is NULL don't send command */
 	if (data->cmd != NULL){
-		/* Send command */
-		GPIOOff(ili9341_dc);
-		SpiWrite(ili9341_spi, &data->cmd, 1);
+		/* Send command, DC is set by LcdPreTransfer right before it goes out */
+		SpiQueueWrite(ili9341_spi, &data->cmd, 1, LCD_DC_CMD);
 	}
 	/* If there are parameters or data to send */
 	if (data->databytes != NULL){
 		/* Send parameters or data */
-		GPIOOn(ili9341_dc);
-		SpiWrite(ili9341_spi, data->data, data->databytes);
+		SpiQueueWrite(ili9341_spi, data->data, data->databytes, LCD_DC_DATA);
 	}
 }
 
+void WriteLCD(lcd_cmd_t * data){
+	QueueLCD(data);
+	/* data buffers may be reused (or go out of scope) after returning */
+	SpiQueueWait(ili9341_spi);
+}
+
+uint8_t * PixelBuffer(void){
+	/* writes end in order: all but the last one (the other buffer) are done */
+	SpiQueueWaitPending(ili9341_spi, 1);
+	return pixel_buf[pixel_buf_idx];
+}
+
+void SendPixelBuffer(uint32_t bytes){
+	SpiQueueWrite(ili9341_spi, pixel_buf[pixel_buf_idx], bytes, LCD_DC_DATA);
+	pixel_buf_idx ^= 1;
+}
+
 void SetCursorPosition(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1){
 	static uint16_t aux;
 	/* The lower column must be send first */
@@ -227,15 +280,16 @@ void SetCursorPosition(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1){
 	lcd_cmd_t lcd_columns = {COLUMN_ADDR_SET, 4, columns};
 	uint8_t rows[] = {HighByte(y0), LowByte(y0), HighByte(y1), LowByte(y1)};
 	lcd_cmd_t lcd_rows = {PAGE_ADDR_SET, 4, rows};
-	WriteLCD(&lcd_columns);
-	WriteLCD(&lcd_rows);
+	/* parameters are copied into the transactions, the next WriteLCD waits for them */
+	QueueLCD(&lcd_columns);
+	QueueLCD(&lcd_rows);
 }
 
 void Fill(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color){
-	static uint16_t i;
-	static int32_t bytes_count;
+	static uint32_t i;
+	static int32_t bytes_count, bytes_buf;
 	static int16_t x_dist, y_dist;
-	static uint8_t pixel[MAX_VALUE_SIZE];
+	uint8_t *pixel;
 
 	x_dist = x1 - x0;
 	y_dist = y1 - y0;
@@ -250,21 +304,22 @@ void Fill(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color){
 	/* Define area to fill */
 	SetCursorPosition(x0, y0, x1, y1);
 
-	for (i = 0; i < MAX_VALUE_SIZE; i += 2){
+	/* The same buffer goes out again and again, it's filled only once */
+	bytes_buf = (bytes_count < LCD_BUF_SIZE) ? bytes_count : LCD_BUF_SIZE;
+	pixel = PixelBuffer();
+	for (i = 0; i < bytes_buf; i += 2){
 		pixel[i] = HighByte(color);
 		pixel[i + 1] = LowByte(color);
 	}
 	/* Start writing LCD memory */
 	lcd_cmd_t lcd_write = {MEM_WRITE, NULL, NULL};
-	WriteLCD(&lcd_write);
+	QueueLCD(&lcd_write);
 
-	while(bytes_count - MAX_VALUE_SIZE > 0){
-		lcd_cmd_t lcd_pixel = {NULL, MAX_VALUE_SIZE, pixel};
-		WriteLCD(&lcd_pixel);
-		bytes_count -= MAX_VALUE_SIZE;
+	while(bytes_count > 0){
+		SpiQueueWrite(ili9341_spi, pixel, (bytes_count < bytes_buf) ? bytes_count : bytes_buf, LCD_DC_DATA);
+		bytes_count -= bytes_buf;
 	}
-	lcd_cmd_t lcd_pixel = {NULL, bytes_count, pixel};
-	WriteLCD(&lcd_pixel);
+	SpiQueueWait(ili9341_spi);
 }
 
 /*==================[external functions definition]==========================*/
@@ -272,12 +327,15 @@ void Fill(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color){
 uint8_t ILI9341Init(spi_dev_t spi_dev, uint8_t gpio_dc, uint8_t gpio_rst){
 	/* SPI configuration */
 	spi_conf.device = spi_dev;
+	spi_conf.pre_func_p = LcdPreTransfer;
 	ili9341_spi = spi_dev;
 	/* GPIOs configuration and initialization */
 	ili9341_dc = gpio_dc;
 	ili9341_rst = gpio_rst;
 	GPIOInit(ili9341_dc, GPIO_OUTPUT);
 	GPIOInit(ili9341_rst, GPIO_OUTPUT);
+	/* The SPI device is created once, every transfer uses it */
+	SpiInit(&spi_conf);
 
 	/* RST must be held low for minimum 10µsec after VCC have been applied */
 	DelayUs(10);
@@ -350,11 +408,10 @@ void ILI9341Rotate(ili9341_orientation_t orientation){
 }
 
 void ILI9341DrawChar(uint16_t x, uint16_t y, char data, Font_t* font, uint16_t foreground, uint16_t background){
-	static uint32_t i, j, k;
+	static uint32_t i, j, n;
 	static uint32_t char_row;
-	static uint16_t lcd_x, lcd_y;
-	static int32_t bytes_count, bytes_row;
-	static uint8_t pixel[MAX_VALUE_SIZE];
+	static uint16_t lcd_x, lcd_y, color;
+	uint8_t *pixel;
 
 	/* Set coordinates */
 	lcd_x = x;
@@ -368,55 +425,48 @@ void ILI9341DrawChar(uint16_t x, uint16_t y, char data, Font_t* font, uint16_t f
 
 	SetCursorPosition(lcd_x, lcd_y, lcd_x + font->info[data - ' '].width - 1, lcd_y + font->font_height - 1);
 
-	/* Number of bytes to write. We have to write 2 bytes/pixel */
-	bytes_count = font->font_height * font->info[data - ' '].width * 2;
-
 	/* Start writing LCD memory */
 	lcd_cmd_t lcd_write = {MEM_WRITE, NULL, NULL};
-	WriteLCD(&lcd_write);
+	QueueLCD(&lcd_write);
 
-	/* Draw font data */
+	/* Draw font data, 2 bytes/pixel */
+	pixel = PixelBuffer();
+	n = 0;
 	/* go through character rows */
-	k = 0;
 	for (i = 0; i < font->font_height; i++)	{
-		/* */
 		char_row = font->info[data - ' '].offset + i * ((font->info[data - ' '].width + 7) / 8);
 		/* go through character columns */
-		bytes_row = -1;
 		for (j = 0; j < font->info[data - ' '].width; j++){
-			if(j % 8 == 0){
-				bytes_row++;
-			}
-			/* If exceed buffer size, send buffer */
-			if ((2 * j + i * font->info[data - ' '].width * 2 - k * MAX_VALUE_SIZE + 1) > MAX_VALUE_SIZE){
-				lcd_cmd_t lcd_pixels = {NULL, MAX_VALUE_SIZE, pixel};
-				WriteLCD(&lcd_pixels);
-				bytes_count -= MAX_VALUE_SIZE;
-				k++;
-			}
-			/* The n=FontWidth first bits of the 16bits row data draws the corresponding part of a character */
-			if (font->data[char_row + bytes_row] & (MSK_BIT8 >> (j % 8))){
+			/* The n=FontWidth first bits of the row data draws the corresponding part of a character */
+			if (font->data[char_row + j / 8] & (MSK_BIT8 >> (j % 8))){
 				/* if bit = 1, draw put foreground color */
-				pixel[2 * j + i * font->info[data - ' '].width * 2 - k * MAX_VALUE_SIZE] = HighByte(foreground);
-				pixel[2 * j + i * font->info[data - ' '].width * 2 - k * MAX_VALUE_SIZE + 1] = LowByte(foreground);
+				color = foreground;
 			}
 			else{
-				pixel[2 * j + i * font->info[data - ' '].width * 2 - k * MAX_VALUE_SIZE] = HighByte(background);
-				pixel[2 * j + i * font->info[data - ' '].width * 2 - k * MAX_VALUE_SIZE + 1] = LowByte(background);
+				color = background;
+			}
+			pixel[n++] = HighByte(color);
+			pixel[n++] = LowByte(color);
+			/* Buffer full: send it and go on with the other one */
+			if (n == LCD_BUF_SIZE){
+				SendPixelBuffer(n);
+				pixel = PixelBuffer();
+				n = 0;
 			}
 		}
 	}
 	/* Send the rest of the buffer */
-	lcd_cmd_t lcd_pixels = {NULL, bytes_count, pixel};
-	WriteLCD(&lcd_pixels);
+	if (n > 0){
+		SendPixelBuffer(n);
+	}
+	SpiQueueWait(ili9341_spi);
 }
 
 void ILI9341DrawIcon(uint16_t x, uint16_t y, icon_t icon, icon_font_t* icon_font, uint16_t foreground, uint16_t background){
-	static uint32_t i, j, k;
+	static uint32_t i, j, n;
 	static uint32_t char_row;
-	static uint16_t lcd_x, lcd_y;
-	static int32_t bytes_count, bytes_row;
-	static uint8_t pixel[MAX_VALUE_SIZE];
+	static uint16_t lcd_x, lcd_y, color;
+	uint8_t *pixel;
 
 	/* Set coordinates */
 	lcd_x = x;
@@ -430,47 +480,40 @@ void ILI9341DrawIcon(uint16_t x, uint16_t y, icon_t icon, icon_font_t* icon_font
 
 	SetCursorPosition(lcd_x, lcd_y, lcd_x + icon_font->width - 1, lcd_y + icon_font->height - 1);
 
-	/* Number of bytes to write. We have to write 2 bytes/pixel */
-	bytes_count = icon_font->height * icon_font->width * 2;
-
 	/* Start writing LCD memory */
 	lcd_cmd_t lcd_write = {MEM_WRITE, NULL, NULL};
-	WriteLCD(&lcd_write);
+	QueueLCD(&lcd_write);
 
-	/* Draw font data */
-	/* go through character rows */
-	k = 0;
+	/* Draw icon data, 2 bytes/pixel */
+	pixel = PixelBuffer();
+	n = 0;
+	/* go through icon rows */
 	for (i = 0; i < icon_font->height; i++)	{
-		/*  */
 		char_row = icon * icon_font->offset + i * ((icon_font->width + 7) / 8);
-		/* go through character columns */
-		bytes_row = -1;
+		/* go through icon columns */
 		for (j = 0; j < icon_font->width; j++){
-			if(j % 8 == 0){
-				bytes_row++;
-			}
-			/* If exceed buffer size, send buffer */
-			if ((2 * j + i * icon_font->width * 2 - k * MAX_VALUE_SIZE + 1) > MAX_VALUE_SIZE){
-				lcd_cmd_t lcd_pixels = {NULL, MAX_VALUE_SIZE, pixel};
-				WriteLCD(&lcd_pixels);
-				bytes_count -= MAX_VALUE_SIZE;
-				k++;
-			}
-			/* The n=FontWidth first bits of the 16bits row data draws the corresponding part of a character */
-			if (icon_font->data[char_row + bytes_row] & (MSK_BIT8 >> (j % 8))){
+			if (icon_font->data[char_row + j / 8] & (MSK_BIT8 >> (j % 8))){
 				/* if bit = 1, draw put foreground color */
-				pixel[2 * j + i * icon_font->width * 2 - k * MAX_VALUE_SIZE] = HighByte(foreground);
-				pixel[2 * j + i * icon_font->width * 2 - k * MAX_VALUE_SIZE + 1] = LowByte(foreground);
+				color = foreground;
 			}
 			else{
-				pixel[2 * j + i * icon_font->width * 2 - k * MAX_VALUE_SIZE] = HighByte(background);
-				pixel[2 * j + i * icon_font->width * 2 - k * MAX_VALUE_SIZE + 1] = LowByte(background);
+				color = background;
+			}
+			pixel[n++] = HighByte(color);
+			pixel[n++] = LowByte(color);
+			/* Buffer full: send it and go on with the other one */
+			if (n == LCD_BUF_SIZE){
+				SendPixelBuffer(n);
+				pixel = PixelBuffer();
+				n = 0;
 			}
 		}
 	}
 	/* Send the rest of the buffer */
-	lcd_cmd_t lcd_pixels = {NULL, bytes_count, pixel};
-	WriteLCD(&lcd_pixels);
+	if (n > 0){
+		SendPixelBuffer(n);
+	}
+	SpiQueueWait(ili9341_spi);
 }
 
 void ILI9341DrawInt(uint16_t x, uint16_t y, uint32_t num, uint8_t dig, Font_t* font, uint16_t foreground, uint16_t background){
@@ -800,9 +843,8 @@ void ILI9341DrawFilledTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, i
 }
 
 void ILI9341DrawPicture(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* pic){
-	static uint16_t i, j;
-	static int32_t bytes_count;
-	static uint8_t pixel[MAX_VALUE_SIZE];
+	static int32_t i, bytes_count, bytes_buf;
+	uint8_t *pixel;
 
 	SetCursorPosition(x, y, x + width - 1, y + height - 1);
 
@@ -811,23 +853,20 @@ void ILI9341DrawPicture(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
 
 	/* Start writing LCD memory */
 	lcd_cmd_t lcd_write = {MEM_WRITE, NULL, NULL};
-	WriteLCD(&lcd_write);
-
-	j = 0;
-	while(bytes_count - MAX_VALUE_SIZE > 0){
-		for (i = 0; i < MAX_VALUE_SIZE; i++){
-			pixel[i] = pic[j * MAX_VALUE_SIZE + i];
+	QueueLCD(&lcd_write);
+
+	/* pictures are usually in flash, which DMA can't read: they go through the pixel buffers */
+	while(bytes_count > 0){
+		bytes_buf = (bytes_count < LCD_BUF_SIZE) ? bytes_count : LCD_BUF_SIZE;
+		pixel = PixelBuffer();
+		for (i = 0; i < bytes_buf; i++){
+			pixel[i] = pic[i];
 		}
-		lcd_cmd_t lcd_pixel = {NULL, MAX_VALUE_SIZE, pixel};
-		WriteLCD(&lcd_pixel);
-		bytes_count -= MAX_VALUE_SIZE;
-		j++;
-	}
-	for (i = 0; i < bytes_count; i++){
-		pixel[i] = pic[j * MAX_VALUE_SIZE + i];
+		SendPixelBuffer(bytes_buf);
+		pic += bytes_buf;
+		bytes_count -= bytes_buf;
 	}
-	lcd_cmd_t lcd_pixel = {NULL, bytes_count, pixel};
-	WriteLCD(&lcd_pixel);
+	SpiQueueWait(ili9341_spi);
 }
 
 uint8_t ILI9341DeInit(void){
@@ -18,6 +18,7 @@
 #define MAX_B_SPEED 	-100	/*!< Max backward speed */
 #define PWM_FREQ 		50		/*!< PWM frequency (Hz) */
 #define N_MOTORS		2		/*!< Number of motors */
+#define MOTOR_2_PHASE	50		/*!< Motor 2 PWM phase offset (% of period) */
 #define EN_1_2			GPIO_22
 #define A_1				GPIO_21
 #define A_2				GPIO_20
@@ -40,6 +41,8 @@
 uint8_t L293Init(void){
 	PWMInit(PWM_0, EN_1_2, PWM_FREQ);
 	PWMInit(PWM_1, EN_3_4, PWM_FREQ);
+	/* Both motors share the PWM timer: enable them half a period apart to reduce supply current peaks */
+	PWMSetPhase(PWM_1, MOTOR_2_PHASE);
 	GPIOInit(A_1, GPIO_OUTPUT);
 	GPIOInit(A_2, GPIO_OUTPUT);
 	GPIOInit(A_3, GPIO_OUTPUT);
@@ -20,6 +20,7 @@
 #define GPIO_SEL_1	GPIO_19
 #define GPIO_SEL_2	GPIO_18
 #define GPIO_SEL_3	GPIO_9
+#define GPIO_BCD_MASK	(GPIO_MASK(GPIO_BCD_1) | GPIO_MASK(GPIO_BCD_2) | GPIO_MASK(GPIO_BCD_3) | GPIO_MASK(GPIO_BCD_4))
 /*==================[internal data definition]===============================*/
 static uint16_t actual_value = 0; /*variable that saves the value to be shown in the display LCD*/
 /*==================[internal functions declaration]=========================*/
@@ -27,10 +28,8 @@ static uint16_t actual_value = 0; /*variable that saves the value to be shown in
  *
  */
 bool LcdItsE0803BCDtoPin(uint8_t value){
-	GPIOState(GPIO_BCD_1, (value & (1<<0))>>0);
-	GPIOState(GPIO_BCD_2, (value & (1<<1))>>1);
-	GPIOState(GPIO_BCD_3, (value & (1<<2))>>2);
-	GPIOState(GPIO_BCD_4, (value & (1<<3))>>3);
+	/* BCD pins are consecutive GPIOs, so the digit is written to the port in one shot */
+	GPIOWriteMask(GPIO_BCD_MASK, (uint32_t)(value & 0x0F) << GPIO_BCD_1);
 	return true;
 }
 /*==================[external functions definition]==========================*/
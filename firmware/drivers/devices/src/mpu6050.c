@@ -20,6 +20,20 @@
 uint8_t devAddr;
 uint8_t buffer[14];
 /*==================[internal functions declaration]=========================*/
+static void MPU6050_ShadowConfig(void);
+
+/*==================[internal functions definition]==========================*/
+/** Enable the I2C register cache, leaving out registers the device updates
+ * by itself (sensor data, status, FIFO) or that hold self-clearing bits.
+ */
+static void MPU6050_ShadowConfig(void){
+	I2C_ShadowEnable(devAddr);
+	I2C_ShadowSetVolatile(devAddr, MPU6050_RA_I2C_SLV4_CTRL, MPU6050_RA_I2C_MST_STATUS - MPU6050_RA_I2C_SLV4_CTRL + 1);
+	I2C_ShadowSetVolatile(devAddr, MPU6050_RA_DMP_INT_STATUS, MPU6050_RA_MOT_DETECT_STATUS - MPU6050_RA_DMP_INT_STATUS + 1);
+	I2C_ShadowSetVolatile(devAddr, MPU6050_RA_SIGNAL_PATH_RESET, 1);
+	I2C_ShadowSetVolatile(devAddr, MPU6050_RA_USER_CTRL, 1);
+	I2C_ShadowSetVolatile(devAddr, MPU6050_RA_BANK_SEL, MPU6050_RA_FIFO_R_W - MPU6050_RA_BANK_SEL + 1);
+}
 
 /*==================[external functions definition]==========================*/
 void MPU6050_ReadRegister(uint8_t reg, uint8_t *data, uint8_t len){
@@ -47,6 +61,7 @@ void MPU6050_Address(uint8_t address) {
 
 void MPU6050_initialize() {
 	devAddr = MPU6050_DEFAULT_ADDRESS;
+	MPU6050_ShadowConfig();
     MPU6050_setClockSource(MPU6050_CLOCK_PLL_XGYRO);
     MPU6050_setFullScaleGyroRange(MPU6050_GYRO_FS_250);
     MPU6050_setFullScaleAccelRange(MPU6050_ACCEL_FS_2);
@@ -1783,6 +1798,28 @@ void MPU6050_getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int1
     *gy = (((int16_t)buffer[10]) << 8) | buffer[11];
     *gz = (((int16_t)buffer[12]) << 8) | buffer[13];
 }
+bool MPU6050_getMotion6Async(uint8_t *raw, void (*func_p)(void *param, esp_err_t result, uint32_t latency_us), void *param_p, TaskHandle_t notify_task) {
+    i2c_transaction_t trans = {
+        .dev_addr = devAddr,
+        .reg_addr = MPU6050_RA_ACCEL_XOUT_H,
+        .dir = I2C_TRANS_READ,
+        .data = raw,
+        .length = MPU6050_MOTION6_RAW_SIZE,
+        .timeout_ms = I2C_MASTER_TIMEOUT_MS,
+        .func_p = func_p,
+        .param_p = param_p,
+        .notify_task = notify_task,
+    };
+    return I2C_Submit(&trans);
+}
+void MPU6050_parseMotion6(const uint8_t *raw, int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
+    *ax = (((int16_t)raw[0]) << 8) | raw[1];
+    *ay = (((int16_t)raw[2]) << 8) | raw[3];
+    *az = (((int16_t)raw[4]) << 8) | raw[5];
+    *gx = (((int16_t)raw[8]) << 8) | raw[9];
+    *gy = (((int16_t)raw[10]) << 8) | raw[11];
+    *gz = (((int16_t)raw[12]) << 8) | raw[13];
+}
 /** Get 3-axis accelerometer readings.
  * These registers store the most recent accelerometer measurements.
  * Accelerometer measurements are written to these registers at the Sample Rate
@@ -2409,6 +2446,7 @@ void MPU6050_resetSensors() {
  */
 void MPU6050_reset() {
     I2C_writeBit(devAddr, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
+    I2C_ShadowInvalidate(devAddr);
 }
 /** Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
@@ -9,7 +9,6 @@
 #define ANG_RANGE	180.0
 #define PERIOD_MS   20.0
 #define PULSEW_MS   1.0
-#define PERCENT   	100.0
 /*==================[internal data declaration]==============================*/
 
 /*==================[internal functions declaration]=========================*/
@@ -19,14 +18,12 @@
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
-uint8_t Angle2DutyCicle(int8_t angle){
-	static float h_time;
-	static float duty_cicle;
-	static int16_t deg;
+uint32_t Angle2Duty(int8_t angle, uint32_t max_duty){
+	float h_time;
+	int16_t deg;
 	deg = 2 * angle + MAX_ANG;	// NOTE: adjusted (angle x 2) for the available servos
 	h_time = (float)(deg/ANG_RANGE) + PULSEW_MS;
-	duty_cicle = (float)(h_time/PERIOD_MS) * PERCENT;
-	return (uint8_t) duty_cicle;
+	return (uint32_t)((h_time/PERIOD_MS) * max_duty);
 }
 /*==================[external functions definition]==========================*/
 
@@ -49,27 +46,28 @@ uint8_t ServoInit(servo_out_t servo, gpio_t gpio){
 }
 
 void ServoMove(servo_out_t servo, int8_t ang){
-	static uint8_t dc;
+	pwm_out_t pwm;
 	if(ang < MIN_ANG){
 		ang = MIN_ANG;
 	} else if(ang > MAX_ANG){
 		ang = MAX_ANG;
 	}
-	dc = Angle2DutyCicle(ang);
 	switch(servo){
 		case SERVO_0:
-			PWMSetDutyCycle(PWM_0, dc);
+			pwm = PWM_0;
 			break;
 		case SERVO_1:
-			PWMSetDutyCycle(PWM_1, dc);
+			pwm = PWM_1;
 			break;
 		case SERVO_2:
-			PWMSetDutyCycle(PWM_2, dc);
+			pwm = PWM_2;
 			break;
 		case SERVO_3:
-			PWMSetDutyCycle(PWM_3, dc);
+		default:
+			pwm = PWM_3;
 			break;
 	}
+	PWMSetDutyRaw(pwm, Angle2Duty(ang, PWMGetMaxDuty(pwm)));
 }
 
 /*==================[end of file]============================================*/
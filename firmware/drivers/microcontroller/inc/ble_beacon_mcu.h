@@ -0,0 +1,136 @@
+#ifndef BLE_BEACON_MCU_H
+#define BLE_BEACON_MCU_H
+/** \addtogroup Drivers_Programable Drivers Programable
+ ** @{ */
+/** \addtogroup Drivers_Microcontroller Drivers microcontroller
+ ** @{ */
+/** \addtogroup BLE_Beacon BLE Beacon
+ ** @{ */
+
+/** \brief Connectionless BLE telemetry for the ESP-EDU Board.
+ *
+ * The latest value of every reading is broadcast in the advertising packets, any number
+ * of gateways (phones, PCs, other boards) can listen without connecting. The payload is
+ * refreshed every update_ms with the readings set since the last refresh.
+ *
+ * Readings go in a Manufacturer Specific Data structure (AD type 0xFF), little endian:
+ *
+ * | Byte | Field                                                              |
+ * |:----:|:-------------------------------------------------------------------|
+ * | 0-1  | Company id 0xFFFF (reserved for tests, not assigned to a company)  |
+ * | 2    | Format version (BLE_BEACON_VERSION)                                |
+ * | 3    | Node id                                                            |
+ * | 4    | Frame counter, incremented every time a reading changes            |
+ * | 5-   | Readings: tag (id << 3 | ble_beacon_format_t) followed by the value |
+ *
+ * Values take 1, 2 or 4 bytes according to their format. A decoder skips readings with an
+ * unknown format only if it knows their size, so new formats need a new version.
+ * firmware/tools/ble/ble_beacon_decoder.py is a reference decoder for the host side.
+ *
+ * Legacy advertising fits 21 bytes of readings and is received by every phone. Extended
+ * advertising (BLE 5) adds the device name and takes 239 bytes minus the name length. In
+ * periodic mode the readings (244 bytes) go in the periodic train, the advertising set
+ * only carries the name and the header, scanners must synchronize to the train.
+ *
+ * @note It can't be used together with ble_mcu or ble_hid_mcu.
+ *
+ * @section changelog
+ *
+ * |   Date	    | Description                                    						|
+ * |:----------:|:----------------------------------------------------------------------|
+ * | 19/10/2026 | Document creation		                         						|
+ *
+ **/
+
+/*==================[inclusions]=============================================*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+/*==================[macros]=================================================*/
+#define BLE_BEACON_VERSION		1		/*!< Version of the payload format */
+#define BLE_BEACON_READINGS_MAX	32		/*!< Reading ids: 0 to 31 */
+#define BLE_BEACON_COMPANY_ID	0xFFFF	/*!< Company id of the Manufacturer Specific Data */
+/*==================[typedef]================================================*/
+/**
+ * @brief Advertising mode
+ */
+typedef enum ble_beacon_mode {
+	BLE_BEACON_LEGACY,		/*!< Legacy advertising (BLE 4), 21 bytes of readings */
+	BLE_BEACON_EXTENDED,	/*!< Extended advertising (BLE 5), 239 bytes of readings minus the name */
+	BLE_BEACON_PERIODIC		/*!< Periodic advertising (BLE 5), 244 bytes of readings, scanners synchronize */
+} ble_beacon_mode_t;
+
+/**
+ * @brief Format of a reading (same codes as ble_stream_format_t of ble_mcu.h)
+ */
+typedef enum ble_beacon_format {
+	BLE_BEACON_INT8,		/*!< int8_t value */
+	BLE_BEACON_UINT8,		/*!< uint8_t value */
+	BLE_BEACON_INT16,		/*!< int16_t value */
+	BLE_BEACON_UINT16,		/*!< uint16_t value */
+	BLE_BEACON_INT32,		/*!< int32_t value */
+	BLE_BEACON_FLOAT		/*!< float value */
+} ble_beacon_format_t;
+
+/**
+ * @brief BLE beacon configuration struct
+ */
+typedef struct {
+	char * device_name;			/*!< Device name, sent in extended and periodic modes */
+	uint8_t node_id;			/*!< Id of this node, to tell apart several boards */
+	ble_beacon_mode_t mode;		/*!< Advertising mode */
+	uint16_t adv_interval_ms;	/*!< Time between advertising events (20 to 10000 ms) */
+	uint32_t update_ms;			/*!< Payload refresh period (100 ms or more) */
+} ble_beacon_config_t;
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/**
+ * @brief Bluetooth initialization as a broadcaster
+ *
+ * @note It starts advertising (without readings) as soon as the controller is ready.
+ *
+ * @param config BLE beacon configuration struct
+ */
+void BleBeaconInit(ble_beacon_config_t *config);
+
+/**
+ * @brief Sets the value of a reading
+ *
+ * @note The value is copied and broadcast from the next refresh on. Setting it several times
+ * between refreshes only sends the last value.
+ *
+ * @param id        Reading id (0 to BLE_BEACON_READINGS_MAX - 1)
+ * @param format    Value format
+ * @param value     Pointer to the value (int8_t, uint16_t, float, etc. according to format)
+ * @return true if the reading fits in the payload of the advertising mode
+ */
+bool BleBeaconSetReading(uint8_t id, ble_beacon_format_t format, const void *value);
+
+/**
+ * @brief Removes a reading from the payload
+ *
+ * @param id        Reading id
+ */
+void BleBeaconClearReading(uint8_t id);
+
+/**
+ * @brief Gets the bytes left in the payload for more readings
+ *
+ * @return size_t Free bytes (a reading takes its value size plus 1)
+ */
+size_t BleBeaconFree(void);
+
+/**
+ * @brief Tells whether the device is advertising
+ *
+ * @return true once the controller accepted the advertising parameters and data
+ */
+bool BleBeaconActive(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+#endif /* BLE_BEACON_MCU_H */
+
+/*==================[end of file]============================================*/
@@ -20,12 +20,16 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 22/03/2024 | Document creation		                         						|
+ * | 19/10/2026 | NimBLE host support (selected by Kconfig), start up time and heap log	|
+ * | 19/10/2026 | Mouse report scheduler: motion coalescing at the connection interval	|
+ * | 19/10/2026 | Text typing (BleHidTypeString) with US and Latin American layouts		|
  * 
  **/
 
 /*==================[inclusions]=============================================*/
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 /*==================[macros]=================================================*/
 
 
@@ -172,6 +176,13 @@ typedef enum mouse_cmd {
     HID_MOUSE_MIDDLE    = 254,
     HID_MOUSE_RIGHT     = 255
 } mouse_cmd_t;
+/**
+ * @brief Keyboard layout of the host, for BleHidTypeString
+ */
+typedef enum ble_hid_layout {
+	BLE_HID_LAYOUT_US,		/*!< English (US) */
+	BLE_HID_LAYOUT_LATAM	/*!< Spanish (Latin America) */
+} ble_hid_layout_t;
 /*==================[external data declaration]==============================*/
 
 /*==================[external functions declaration]=========================*/
@@ -203,12 +214,79 @@ void BleHidSendKeyboard(key_mask_t special_key_mask, keyboard_cmd_t *keyboard_cm
 /**
  * @brief Send mouse position and click event
  * 
+ * @note Same as BleHidMouseButton followed by BleHidMouseMove: the report is sent 
+ * by the scheduler, merged with other motion of the same connection interval.
+ * 
  * @param mouse_button      Button to be clicked
  * @param delta_x           X cursor relative position
  * @param delta_y           Y cursor relative position
  */
 void BleHidSendMouse(mouse_cmd_t mouse_button, int8_t delta_x, int8_t delta_y);
 
+/**
+ * @brief Adds a mouse motion to the next report
+ * 
+ * @note Motion is accumulated between connection events and sent once per connection 
+ * interval, so it can be called as often as the sensor is read. Motions larger than 
+ * a report (-127 to 127) are split in consecutive reports, none is lost.
+ * 
+ * @param delta_x           X cursor relative position
+ * @param delta_y           Y cursor relative position
+ * @param wheel             Wheel relative position
+ */
+void BleHidMouseMove(int16_t delta_x, int16_t delta_y, int8_t wheel);
+
+/**
+ * @brief Sets the pressed mouse button
+ * 
+ * @note Every change is sent in its own report, so a click shorter than the connection 
+ * interval still reaches the host as a press and a release.
+ * 
+ * @param mouse_button      Pressed button (HID_NO_BUTTON to release)
+ */
+void BleHidMouseButton(mouse_cmd_t mouse_button);
+
+/**
+ * @brief Gets the number of reports the scheduler is sending
+ * 
+ * @note At most a few reports per connection interval are sent, so it shows whether 
+ * the central granted a short enough interval for smooth motion.
+ * 
+ * @return uint16_t Reports per second in the last second (0 while idle)
+ */
+uint16_t BleHidGetReportRate(void);
+
+/**
+ * @brief Types a text on the host
+ * 
+ * @note Characters are queued and typed by the report scheduler, packing several 
+ * keys in each keyboard report and sending a few reports per connection interval. 
+ * It blocks while the queue is full. Characters the layout can't type are skipped. 
+ * With BLE_HID_LAYOUT_LATAM the text is UTF-8, so ñ, ¿, ¡, etc. can be typed too.
+ * 
+ * @param text              Null terminated text
+ * @param layout            Keyboard layout configured on the host
+ * @return size_t Number of characters queued (less than the text if the link is lost)
+ */
+size_t BleHidTypeString(const char *text, ble_hid_layout_t layout);
+
+/**
+ * @brief Sets the number of keys pressed together in each report while typing
+ * 
+ * @note Keys of the same report are pressed at the same time, most hosts type them 
+ * in the report order but some don't. Use 1 if the host swaps characters.
+ * 
+ * @param keys              Keys per report, 1 to 6 (default: 6)
+ */
+void BleHidSetTypingKeys(uint8_t keys);
+
+/**
+ * @brief Gets the number of keystrokes waiting to be typed
+ * 
+ * @return size_t Keystrokes in the queue
+ */
+size_t BleHidTypePending(void);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
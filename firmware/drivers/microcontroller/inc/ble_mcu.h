@@ -13,6 +13,29 @@
  * so it can be used to communicate with common Android apps, like "Bluetooth Electronics"
  * (https://play.google.com/store/apps/details?id=com.keuwl.arduinobluetooth)
  * 
+ * Binary sample streams are notified on a second characteristic (UUID 0xFFE2) of the same 
+ * service. Every notification holds one packet: an 8 bytes little endian header followed by 
+ * the samples, also little endian:
+ * 
+ * | Byte | Field                                                        |
+ * |:----:|:-------------------------------------------------------------|
+ * | 0    | Stream id                                                    |
+ * | 1    | Header version (high nibble) and ble_stream_format_t (low)   |
+ * | 2-3  | Sequence number, per stream, to detect lost packets          |
+ * | 4-7  | Time stamp of the first sample (us, low 32 bits)             |
+ * | 8-   | Samples (count = payload size / sample size)                 |
+ * 
+ * firmware/tools/ble/ble_stream_decoder.py is a reference decoder for the host side.
+ * 
+ * Up to BLE_MAX_CONN centrals (e.g. a logger and a display phone) can be connected at 
+ * the same time. Every BleSend* or BleStreamSend call goes to all the centrals subscribed 
+ * to the characteristic, notified from the same buffer. Notifications are sized for the 
+ * smallest MTU, and the slowest central sets the pace for all of them.
+ * 
+ * @note Data is only sent to centrals that enabled notifications (CCCD) of the characteristic,
+ * what's sent while no central is subscribed is discarded (see ble_stats_t.unsubscribed_dropped).
+ * Bonded centrals keep their subscriptions across reconnections, with both host stacks.
+ * 
  * @author Albano Peñalva
  *
  * @section changelog
@@ -20,14 +43,31 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 22/03/2024 | Document creation		                         						|
+ * | 19/10/2026 | MTU negotiation, data length extension and 2M PHY						|
+ * | 19/10/2026 | Event-driven send task with flow control and throughput counters		|
+ * | 19/10/2026 | TX ring buffer, BleSendBuffer takes size_t lengths						|
+ * | 19/10/2026 | Optional coalescing of small sends, latency and packing statistics	|
+ * | 19/10/2026 | Binary sensor stream characteristic (0xFFE2)							|
+ * | 19/10/2026 | Connection parameters control										|
+ * | 19/10/2026 | Single copy RX path, long (prepared) writes							|
+ * | 19/10/2026 | NimBLE host support (selected by Kconfig), start up time and heap log	|
+ * | 19/10/2026 | Several simultaneous connections, sends fan out to every subscriber	|
  * 
  **/
 
 /*==================[inclusions]=============================================*/
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 /*==================[macros]=================================================*/
 #define BLE_NO_INT	0		/*!< Flag used when no reading interruption is required */
+#define BLE_TX_BUFFER_SIZE	4096	/*!< Bytes that can wait for transmission (power of 2) */
+#define BLE_STREAM_HDR_SIZE	8		/*!< Header size of every stream packet */
+#define BLE_STREAM_VERSION	1		/*!< Version of the stream packet header */
+#define BLE_RX_MAX_LEN		512		/*!< Maximum length of a write (long writes included) */
+#ifndef BLE_MAX_CONN
+#define BLE_MAX_CONN		3		/*!< Simultaneous connections, up to CONFIG_BT_ACL_CONNECTIONS / CONFIG_BT_NIMBLE_MAX_CONNECTIONS */
+#endif
 /*==================[typedef]================================================*/
 /**
  * @brief Prototype of callback function for reading received data 
@@ -37,12 +77,46 @@
  */
 typedef void (*read_func) (uint8_t * data, uint8_t length);
 
+/**
+ * @brief Prototype of callback function for reading received data of any length
+ * 
+ * @param data      pointer to received data array
+ * @param length    number of bytes of received data (up to BLE_RX_MAX_LEN)
+ */
+typedef void (*read_long_func) (uint8_t * data, size_t length);
+
+/**
+ * @brief Connection parameters, in Bluetooth units
+ */
+typedef struct {
+	uint16_t interval;		/*!< Connection interval (x 1.25 ms) */
+	uint16_t latency;		/*!< Connection events the peripheral may skip */
+	uint16_t timeout;		/*!< Supervision timeout (x 10 ms) */
+} ble_conn_params_t;
+
+/**
+ * @brief Prototype of callback function called when connection parameters change
+ * 
+ * @param params    connection parameters granted by the central
+ */
+typedef void (*conn_func) (const ble_conn_params_t * params);
+
+/**
+ * @brief Predefined connection parameters
+ */
+typedef enum ble_conn_profile {
+	BLE_CONN_LOW_LATENCY,	/*!< 7.5 ms interval, for streaming */
+	BLE_CONN_BALANCED,		/*!< 30 - 50 ms interval */
+	BLE_CONN_LOW_POWER		/*!< 200 - 400 ms interval and 4 events of latency, for idle sessions */
+} ble_conn_profile_t;
+
 /**
  * @brief BLE configuration struct
  */
 typedef struct {			
 	char * device_name;		/*!< BLE device name */
 	read_func func_p;		/*!< Pointer to callback function to call when receiving data (= BLE_NO_INT if not requiered) */
+	read_long_func long_func_p;	/*!< Optional, used instead of func_p for writes longer than 255 bytes (NULL if not requiered) */
 } ble_config_t;
 
 /**
@@ -53,6 +127,59 @@ typedef enum ble_status {
 	BLE_DISCONNECTED,		/*!< BLE device disconnected */
 	BLE_CONNECTED			/*!< BLE device connected */
 } ble_status_t;
+
+/**
+ * @brief BLE traffic counters, cleared on every new connection
+ */
+typedef struct {
+	uint32_t bytes_sent;		/*!< Payload bytes accepted by the stack */
+	uint32_t notifications;		/*!< Notifications accepted by the stack */
+	uint32_t bytes_received;	/*!< Payload bytes written by the central */
+	uint32_t rx_dropped;		/*!< Received bytes discarded because the read callback fell behind */
+	uint32_t congestions;		/*!< Times the stack reported a congested link */
+	uint32_t send_errors;		/*!< Notifications rejected by the stack (retried) */
+	uint32_t dropped;			/*!< Bytes discarded after repeated stack errors or a disconnection */
+	uint32_t unsubscribed_dropped;	/*!< Bytes discarded because no connected central was subscribed to the characteristic */
+	uint32_t tx_waits;			/*!< Times a BleSend* call blocked on a full TX buffer */
+	uint32_t throughput;		/*!< Average TX throughput since the connection started (bytes/s) */
+	uint32_t avg_latency_us;	/*!< Average time from BleSend* call to notification */
+	uint32_t max_latency_us;	/*!< Maximum time from BleSend* call to notification */
+	uint32_t deadline_flushes;	/*!< Partial notifications sent because the coalescing deadline expired */
+	uint32_t stream_packets;	/*!< Stream packets notified */
+	uint8_t efficiency;			/*!< Payload bytes over notification capacity (MTU - 3), in percent */
+} ble_stats_t;
+
+/**
+ * @brief State of one connection
+ */
+typedef struct {
+	uint16_t mtu;				/*!< ATT MTU negotiated with this central */
+	ble_conn_params_t params;	/*!< Connection parameters in use */
+	bool data_subscribed;		/*!< Notifications of the data characteristic (0xFFE1) enabled */
+	bool stream_subscribed;		/*!< Notifications of the stream characteristic (0xFFE2) enabled */
+} ble_conn_info_t;
+
+/**
+ * @brief Sample format of a binary stream
+ */
+typedef enum ble_stream_format {
+	BLE_STREAM_INT8,		/*!< int8_t samples */
+	BLE_STREAM_UINT8,		/*!< uint8_t samples */
+	BLE_STREAM_INT16,		/*!< int16_t samples */
+	BLE_STREAM_UINT16,		/*!< uint16_t samples */
+	BLE_STREAM_INT32,		/*!< int32_t samples */
+	BLE_STREAM_FLOAT		/*!< float samples */
+} ble_stream_format_t;
+
+/**
+ * @brief Binary sample stream descriptor
+ */
+typedef struct {
+	uint8_t id;						/*!< Stream id, written in every packet */
+	ble_stream_format_t format;		/*!< Sample format */
+	uint32_t period_us;				/*!< Sample period, used to time stamp packets after the first one */
+	uint16_t seq;					/*!< Sequence number of the next packet (managed by the driver, init to 0) */
+} ble_stream_t;
 /*==================[external data declaration]==============================*/
 
 /*==================[external functions declaration]=========================*/
@@ -68,10 +195,122 @@ void BleInit(ble_config_t * ble_device);
 /**
  * @brief Gets BLE connection status
  * 
- * @return ble_status_t Connection status
+ * @return ble_status_t Connection status (BLE_CONNECTED with at least one central)
  */
 ble_status_t BleStatus(void);
 
+/**
+ * @brief Gets the number of connected centrals
+ * 
+ * @return uint8_t Connections (0 to BLE_MAX_CONN)
+ */
+uint8_t BleConnCount(void);
+
+/**
+ * @brief Gets the state of one connection
+ * 
+ * @param conn  Connection index (0 to BLE_MAX_CONN - 1)
+ * @param info  Pointer to struct where the state is copied
+ * @return true if there is a central connected with that index
+ */
+bool BleGetConnInfo(uint8_t conn, ble_conn_info_t *info);
+
+/**
+ * @brief Gets the ATT MTU used for notifications
+ * 
+ * @note Each notification carries up to (MTU - 3) bytes. With several centrals it's the 
+ * smallest of their MTUs. Returns 23 (BLE default) while disconnected or before the 
+ * central completes the MTU exchange.
+ * 
+ * @return uint16_t ATT MTU in bytes
+ */
+uint16_t BleGetMtu(void);
+
+/**
+ * @brief Enables coalescing of small sends into full notifications
+ * 
+ * @note With coalescing enabled, consecutive BleSend* calls are packed in (MTU - 3) bytes 
+ * notifications. A partial notification is only sent once its oldest byte has waited 
+ * deadline_ms. Compare avg_latency_us and efficiency of BleGetStats to tune it.
+ * 
+ * @param deadline_ms Maximum time data waits to be packed (0: disabled, default)
+ */
+void BleSetCoalescing(uint16_t deadline_ms);
+
+/**
+ * @brief Requests a predefined set of connection parameters
+ * 
+ * @note The request is sent now to every connected central and on every following connection. The central 
+ * has the final word: the granted values are reported by the callback set with 
+ * BleSetConnCallback and by BleGetConnParams.
+ * 
+ * @param profile Connection profile
+ * @return true if the request was sent (or stored until the next connection)
+ */
+bool BleSetConnProfile(ble_conn_profile_t profile);
+
+/**
+ * @brief Requests a connection interval range
+ * 
+ * @param min_int Minimum interval (x 1.25 ms, 6 to 3200)
+ * @param max_int Maximum interval (x 1.25 ms, 6 to 3200)
+ * @return true if the request was sent (or stored until the next connection)
+ */
+bool BleSetConnInterval(uint16_t min_int, uint16_t max_int);
+
+/**
+ * @brief Requests a peripheral latency
+ * 
+ * @param latency Connection events that can be skipped when there is no data (0 to 499)
+ * @return true if the request was sent (or stored until the next connection)
+ */
+bool BleSetConnLatency(uint16_t latency);
+
+/**
+ * @brief Requests a supervision timeout
+ * 
+ * @note It must be larger than (1 + latency) * max_int * 2.
+ * 
+ * @param timeout Supervision timeout (x 10 ms, 10 to 3200)
+ * @return true if the request was sent (or stored until the next connection)
+ */
+bool BleSetConnTimeout(uint16_t timeout);
+
+/**
+ * @brief Gets the connection parameters in use
+ * 
+ * @note With several centrals, the ones of the first connection (see BleGetConnInfo).
+ * 
+ * @param params Pointer to struct where parameters are copied
+ */
+void BleGetConnParams(ble_conn_params_t *params);
+
+/**
+ * @brief Sets a function to be called every time the connection parameters change
+ * 
+ * @note It's called from the Bluetooth stack task, it must return quickly.
+ * 
+ * @param func_p Pointer to callback function (NULL to disable)
+ */
+void BleSetConnCallback(conn_func func_p);
+
+/**
+ * @brief Gets the free space in the TX buffer
+ * 
+ * @note BleSendByte, BleSendString and BleSendBuffer block while the buffer is full 
+ * (link slower than the application). Check this first to avoid blocking.
+ * 
+ * @return size_t Free bytes (0 to BLE_TX_BUFFER_SIZE)
+ */
+size_t BleSendFree(void);
+
+/**
+ * @brief Gets the traffic counters of the current connection
+ * 
+ * @param stats Pointer to struct where counters are copied
+ */
+void BleGetStats(ble_stats_t *stats);
+
 /**
  * @brief Send a single byte trough BLE (if connected)
  * 
@@ -87,12 +326,30 @@ void BleSendByte(const char *data);
 void BleSendString(const char *msg);
 
 /**
- * @brief Send multiple bytes through serial port
+ * @brief Send multiple bytes trough BLE (if connected)
+ * 
+ * @note Data is split in notifications of (MTU - 3) bytes. Blocks while the TX buffer 
+ * is full, so any length can be sent.
  * 
  * @param data Pointer to array of data to be transmitted
  * @param nbytes Number of bytes to be sended
+ * @return size_t Number of bytes queued (less than nbytes only if the device disconnects)
+ */
+size_t BleSendBuffer(const char *data, size_t nbytes);
+
+/**
+ * @brief Send samples trough the binary stream characteristic (if connected and subscribed)
+ * 
+ * @note Samples are split in as many packets as needed to fit the negotiated MTU, each one 
+ * with the next sequence number. Blocks while the stream buffer is full.
+ * 
+ * @param stream Stream descriptor
+ * @param samples Pointer to array of samples, in the stream format
+ * @param count Number of samples
+ * @param timestamp_us Time of the first sample (e.g. esp_timer_get_time())
+ * @return size_t Number of samples queued
  */
-void BleSendBuffer(const char *data, uint8_t nbytes);
+size_t BleStreamSend(ble_stream_t *stream, const void *samples, size_t count, int64_t timestamp_us);
 
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
@@ -16,6 +16,7 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 20/11/2023 | Document creation		                         						|
+ * | 19/10/2026 | Multiple bundles, input bundles, masked writes and parallel bus		|
  * 
  **/
 
@@ -24,28 +25,92 @@
 #include <stdint.h>
 #include "gpio_mcu.h"
 /*==================[macros]=================================================*/
-
+#define GPIO_FAST_BUNDLE_QTY	4	/**< Max number of simultaneous bundles */
+#define GPIO_FAST_MAX_PINS		8	/**< Max number of GPIOs in a bundle (dedicated GPIO channels) */
 /*==================[typedef]================================================*/
-
+/**
+ * @brief Handle of a bundle of dedicated GPIOs (NULL if creation failed)
+ * 
+ * Bit n of bundle values corresponds to the n-th GPIO of the pin list used to create it.
+ */
+typedef struct gpio_fast_bundle_s *gpio_fast_bundle_t;
 /*==================[external data declaration]==============================*/
 
 /*==================[external functions declaration]=========================*/
 
 /**
- * @brief 
+ * @brief Create the default output bundle used by GPIOFastWrite
  * 
- * @param pin_list 
- * @param pin_qty 
+ * @param pin_list List of GPIOs
+ * @param pin_qty Number of GPIOs in pin_list (up to GPIO_FAST_MAX_PINS)
  */
 void GPIOFastInit(gpio_t *pin_list, uint8_t pin_qty);
 
 /**
- * @brief 
+ * @brief Write all GPIOs of the default bundle
  * 
- * @param value 
+ * @param value New state (bit n: n-th GPIO of the list given to GPIOFastInit)
  */
 void GPIOFastWrite(uint16_t value);
 
+/**
+ * @brief Create a bundle of dedicated GPIOs
+ * 
+ * @param pin_list List of GPIOs
+ * @param pin_qty Number of GPIOs in pin_list (up to GPIO_FAST_MAX_PINS)
+ * @param io Bundle direction (GPIO_INPUT bundles have pull-up resistors)
+ * @return gpio_fast_bundle_t Bundle handle, NULL on error
+ */
+gpio_fast_bundle_t GPIOFastBundleNew(gpio_t *pin_list, uint8_t pin_qty, io_t io);
+
+/**
+ * @brief Delete a bundle and release its dedicated GPIO channels
+ * 
+ * @param bundle Bundle handle
+ */
+void GPIOFastBundleDelete(gpio_fast_bundle_t bundle);
+
+/**
+ * @brief Write the selected GPIOs of an output bundle, leaving the rest unchanged
+ * 
+ * @param bundle Bundle handle
+ * @param mask GPIOs to change
+ * @param value New state of the GPIOs in mask
+ */
+void GPIOFastBundleWrite(gpio_fast_bundle_t bundle, uint32_t mask, uint32_t value);
+
+/**
+ * @brief Read all GPIOs of an input bundle
+ * 
+ * @param bundle Bundle handle
+ * @return uint32_t Input state (bit n: n-th GPIO of the bundle), 0 if bundle is NULL
+ */
+uint32_t GPIOFastBundleRead(gpio_fast_bundle_t bundle);
+
+/**
+ * @brief Create a clocked parallel bus: data lines plus one or more strobe lines
+ * 
+ * Data GPIOs use the dedicated GPIO channels, so a full byte fits (e.g. the data
+ * bus of an 8-bit peripheral plus its write strobe). Strobe GPIOs are regular outputs
+ * driven with GPIOWriteMask, a single register write per edge.
+ * 
+ * @param data_pins Data GPIOs, least significant bit first
+ * @param data_qty Number of data GPIOs (1 to GPIO_FAST_MAX_PINS)
+ * @param strobe_pins Strobe GPIOs (active high)
+ * @param strobe_qty Number of strobe GPIOs (1 to GPIO_FAST_MAX_PINS)
+ * @return gpio_fast_bundle_t Bus handle, NULL on error
+ */
+gpio_fast_bundle_t GPIOFastBusInit(gpio_t *data_pins, uint8_t data_qty, gpio_t *strobe_pins, uint8_t strobe_qty);
+
+/**
+ * @brief Put a word on the data lines and pulse one strobe line
+ * 
+ * @param bus Bus handle
+ * @param strobe Strobe line index (0 for the first GPIO of strobe_pins, ignored if out of range)
+ * @param word Data word
+ */
+void GPIOFastBusWrite(gpio_fast_bundle_t bus, uint8_t strobe, uint8_t word);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
@@ -26,6 +26,8 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 23/10/2023 | Document creation		                         						|
+ * | 19/10/2026 | Multi-pin port access (GPIOWriteMask, GPIOReadPort)					|
+ * | 19/10/2026 | Timestamped edge capture (GPIOCapture*)								|
  * 
  **/
 
@@ -33,6 +35,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 /*==================[macros]=================================================*/
+#define GPIO_MASK(pin)	(1UL << (pin))	/**< Port mask of a single GPIO, to build GPIOWriteMask arguments */
+#define GPIO_CAPTURE_BUF_SIZE	64		/**< Capacity of the edge capture buffer (power of 2) */
 
 /*==================[typedef]================================================*/
 /**
@@ -75,6 +79,26 @@ typedef enum gpio_list{
 	GPIO_23, 	/**< GPIO23 */
 } gpio_t;
 
+/**
+ * @brief Edges recorded by the capture mode
+ * 
+ */
+typedef enum {
+	GPIO_EDGE_RISING = 0,	/**< Positive edges */
+	GPIO_EDGE_FALLING,		/**< Negative edges */
+	GPIO_EDGE_BOTH			/**< Both edges */
+} gpio_edge_t;
+
+/**
+ * @brief Edge recorded by the capture mode
+ * 
+ */
+typedef struct {
+	int64_t timestamp;		/**< Edge time in us since boot (esp_timer time base) */
+	gpio_t pin;				/**< GPIO number */
+	bool level;				/**< GPIO level after the edge */
+} gpio_capture_event_t;
+
 /*==================[internal data declaration]==============================*/
 
 /*==================[internal functions declaration]=========================*/
@@ -124,6 +148,28 @@ void GPIOToggle(gpio_t pin);
  */
 bool GPIORead(gpio_t pin);
 
+/**
+ * @brief Change the state of several GPIOs at once
+ * 
+ * Writes the output registers directly, without going through the GPIO driver. All
+ * the selected GPIOs change in a single register write, without intermediate states
+ * (e.g. a BCD digit going from 0111 to 1000 never shows 1111).
+ * 
+ * @note GPIOs must be previously configured as outputs with GPIOInit.
+ * @note It's placed in IRAM, so it can be called from interrupt routines.
+ * 
+ * @param mask GPIOs to change (bit n corresponds to GPIO_n, see GPIO_MASK)
+ * @param values New state of the GPIOs in mask (bit set: high - bit clear: low)
+ */
+void GPIOWriteMask(uint32_t mask, uint32_t values);
+
+/**
+ * @brief Reads the input state of all GPIOs at once
+ * 
+ * @return uint32_t Input port value (bit n corresponds to GPIO_n)
+ */
+uint32_t GPIOReadPort(void);
+
 /**
  * @brief Configure GPIO input interruption
  * 
@@ -134,15 +180,61 @@ bool GPIORead(gpio_t pin);
  */
 void GPIOActivInt(gpio_t pin, void *ptr_int_func, bool edge, void *args);
 
+/**
+ * @brief Enable timestamped edge capture on a GPIO
+ * 
+ * The driver interruption records GPIO number, level and time of every configured
+ * edge into a lock-free buffer shared by all captured GPIOs. Events are read in
+ * batches with GPIOCaptureRead, so no user interruption is needed.
+ * 
+ * @note GPIO must be previously configured as input with GPIOInit. The GPIO can't be
+ * used with GPIOActivInt at the same time.
+ * 
+ * @param pin GPIO number
+ * @param edge Edges to record
+ */
+void GPIOCaptureEnable(gpio_t pin, gpio_edge_t edge);
+
+/**
+ * @brief Disable edge capture on a GPIO
+ * 
+ * @param pin GPIO number
+ */
+void GPIOCaptureDisable(gpio_t pin);
+
+/**
+ * @brief Number of captured events waiting to be read
+ * 
+ * @return uint16_t Pending events
+ */
+uint16_t GPIOCaptureAvailable(void);
+
+/**
+ * @brief Read captured events (oldest first)
+ * 
+ * @param events Buffer for the events
+ * @param max Capacity of the buffer
+ * @return uint16_t Number of events copied
+ */
+uint16_t GPIOCaptureRead(gpio_capture_event_t *events, uint16_t max);
+
+/**
+ * @brief Number of edges lost because the capture buffer was full
+ * 
+ * @return uint32_t Lost edges since boot
+ */
+uint32_t GPIOCaptureOverflows(void);
+
 /**
  * @brief Configure an input glitch filter to a GPIO
  * 
- * @note You can add filters to up to 8 GPIO
+ * @note You can add filters to up to 8 GPIO. These filters only remove glitches
+ * shorter than 1 us, use the Button driver to debounce mechanical switches.
  * 
  * @param pin GPIO number
- * @param filter filter number
+ * @return true if the filter was added, false if all filters are in use
  */
-void GPIOInputFilter(gpio_t pin);
+bool GPIOInputFilter(gpio_t pin);
 
 /**
  * @brief GPIO de-initialization
@@ -21,6 +21,8 @@
  * |   Date	    | Description                                    |
  * |:----------:|:-----------------------------------------------|
  * | 30/01/2024 | Document creation		                         |
+ * | 19/10/2026 | Register shadow cache for read-modify-write    |
+ * | 19/10/2026 | Asynchronous transaction queue                 |
  *
  */
 
@@ -29,6 +31,8 @@
 #include <stdbool.h>
 #include "esp_log.h"
 #include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "gpio_mcu.h"
 /*==================[macros]=================================================*/
 
@@ -40,6 +44,45 @@
 #define I2C_MASTER_TX_BUF_DISABLE   0           /*!< I2C master doesn't need buffer */
 #define I2C_MASTER_RX_BUF_DISABLE   0           /*!< I2C master doesn't need buffer */
 #define I2C_MASTER_TIMEOUT_MS       1000
+#define I2C_SHADOW_DEV_QTY          2           /*!< Max number of devices with register shadow cache */
+#define I2C_QUEUE_DEPTH             16          /*!< Max number of pending asynchronous transactions */
+
+/**
+ * @brief Direction of an asynchronous transaction
+ */
+typedef enum {
+	I2C_TRANS_READ,			/*!< Read length bytes starting at reg_addr */
+	I2C_TRANS_WRITE			/*!< Write length bytes starting at reg_addr */
+} i2c_trans_dir_t;
+
+/**
+ * @brief Asynchronous transaction descriptor
+ * 
+ * @note The descriptor is copied on submission, but data must remain valid until completion.
+ */
+typedef struct {
+	uint8_t dev_addr;		/*!< I2C slave device address */
+	uint8_t reg_addr;		/*!< First register address */
+	i2c_trans_dir_t dir;	/*!< Transfer direction */
+	uint8_t *data;			/*!< Buffer to read into / write from */
+	uint8_t length;			/*!< Number of bytes to transfer */
+	uint16_t timeout_ms;	/*!< Bus timeout (0 for I2C_MASTER_TIMEOUT_MS) */
+	void (*func_p)(void *param, esp_err_t result, uint32_t latency_us);	/*!< Completion callback (called from the bus worker task), or NULL */
+	void *param_p;			/*!< Completion callback parameter */
+	TaskHandle_t notify_task;	/*!< Task notified with xTaskNotifyGive on completion, or NULL */
+} i2c_transaction_t;
+
+/**
+ * @brief Asynchronous transaction statistics
+ */
+typedef struct {
+	uint32_t completed;			/*!< Completed transactions (successful or not) */
+	uint32_t errors;			/*!< Transactions finished with a bus error */
+	uint32_t rejected;			/*!< Submissions rejected because the queue was full */
+	uint32_t last_latency_us;	/*!< Submission to completion time of the last transaction */
+	uint32_t max_latency_us;	/*!< Worst submission to completion time */
+	uint64_t total_latency_us;	/*!< Sum of latencies (divide by completed for the mean) */
+} i2c_queue_stats_t;
 /*==================[external data declaration]==============================*/
 
 /*==================[external functions declaration]=========================*/
@@ -165,6 +208,75 @@ bool I2C_writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *d
  */
 void I2C_SelectRegister(uint8_t devAddr, uint8_t reg);
 
+/** @fn bool I2C_ShadowEnable(uint8_t devAddr)
+ * @brief Enable the register shadow cache for a device.
+ * 
+ * Register values are cached on the first read and updated on every write, so
+ * later reads and read-modify-write operations (I2C_writeBit, I2C_writeBits) on
+ * cached registers don't generate bus traffic.
+ * Registers changed by the device itself (data, status, FIFO, self-clearing
+ * bits) must be declared with I2C_ShadowSetVolatile.
+ * @param devAddr I2C slave device address
+ * @return true if the cache is enabled, false if there is no free slot
+ */
+bool I2C_ShadowEnable(uint8_t devAddr);
+
+/** @fn void I2C_ShadowDisable(uint8_t devAddr)
+ * @brief Disable the register shadow cache for a device and release its slot.
+ * @param devAddr I2C slave device address
+ */
+void I2C_ShadowDisable(uint8_t devAddr);
+
+/** @fn void I2C_ShadowSetVolatile(uint8_t devAddr, uint8_t regAddr, uint8_t length)
+ * @brief Declare a range of registers as volatile (never cached).
+ * @param devAddr I2C slave device address
+ * @param regAddr First volatile register
+ * @param length Number of consecutive volatile registers
+ */
+void I2C_ShadowSetVolatile(uint8_t devAddr, uint8_t regAddr, uint8_t length);
+
+/** @fn void I2C_ShadowInvalidate(uint8_t devAddr)
+ * @brief Drop every cached value of a device (e.g. after a device reset).
+ * @param devAddr I2C slave device address
+ */
+void I2C_ShadowInvalidate(uint8_t devAddr);
+
+/** @fn bool I2C_QueueInit(void)
+ * @brief Create the bus worker task that serves asynchronous transactions.
+ * 
+ * Pending transactions are executed back to back, in submission order, by a single task,
+ * so a slow or NACKing device only delays the bus worker and not the callers.
+ * The worker and the blocking I2C_* functions share a bus lock: each transaction (and
+ * each read-modify-write of I2C_writeBit / I2C_writeBits) runs without interleaving.
+ * @note I2C_initialize must be called first.
+ * @return true on success
+ */
+bool I2C_QueueInit(void);
+
+/** @fn bool I2C_Submit(const i2c_transaction_t *trans)
+ * @brief Queue an asynchronous transaction. Never blocks.
+ * @param trans Transaction descriptor
+ * @return true if queued, false if the queue is full or not initialized
+ */
+bool I2C_Submit(const i2c_transaction_t *trans);
+
+/** @fn uint8_t I2C_QueuePending(void)
+ * @brief Number of transactions waiting for the bus worker.
+ * @return Pending transactions
+ */
+uint8_t I2C_QueuePending(void);
+
+/** @fn void I2C_QueueGetStats(i2c_queue_stats_t *stats)
+ * @brief Copy the asynchronous transaction statistics.
+ * @param stats Container for the statistics
+ */
+void I2C_QueueGetStats(i2c_queue_stats_t *stats);
+
+/** @fn void I2C_QueueResetStats(void)
+ * @brief Clear the asynchronous transaction statistics.
+ */
+void I2C_QueueResetStats(void);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
@@ -11,8 +11,13 @@
  *
  * This driver provide functions to generate PWM signals 
  *
- * @note It can setup up to 4 PWM outputs, with independet duty 
- * cycle and frequency configuration
+ * @note It can setup up to 6 PWM outputs, with independet duty 
+ * cycle. Outputs with the same frequency share one of the 4 LEDC timers,
+ * so up to 4 different frequencies can be used at the same time.
+ * 
+ * @note Duty resolution is the highest available for each frequency
+ * (e.g. 20 bits at 50 Hz, 13 bits at 5 kHz). Use PWMSetDutyRaw and
+ * PWMGetMaxDuty to use all of it.
  *
  * @author Albano Peñalva
  * 
@@ -21,6 +26,9 @@
  * |   Date	    | Description                                    |
  * |:----------:|:-----------------------------------------------|
  * | 23/01/2024 | Document creation		                         |
+ * | 19/10/2026 | Hardware fades (PWMFadeTo, PWMFadeStep)        |
+ * | 19/10/2026 | 6 outputs on shared timers, raw duty API       |
+ * | 19/10/2026 | Grouped duty updates and phase offsets         |
  *
  */
 
@@ -28,13 +36,15 @@
 #include <stdint.h>
 #include <gpio_mcu.h>
 /*==================[macros]=================================================*/
-
+#define PWM_QTY		6	/**< Number of PWM outputs */
 /*==================[typedef]================================================*/
 typedef enum pwm_out {
 	PWM_0,      /**< PWM output 1 */
 	PWM_1,		/**< PWM output 2 */
 	PWM_2,		/**< PWM output 3 */
-	PWM_3		/**< PWM output 4 */
+	PWM_3,		/**< PWM output 4 */
+	PWM_4,		/**< PWM output 5 */
+	PWM_5		/**< PWM output 6 */
 } pwm_out_t;
 /*==================[internal data declaration]==============================*/
 
@@ -48,7 +58,7 @@ typedef enum pwm_out {
  * @param out PWM output
  * @param gpio GPIO pin number
  * @param freq PWM wave frequency
- * @return uint8_t 
+ * @return uint8_t 0 on success, 1 if all timers are in use at other frequencies
  */
 uint8_t PWMInit(pwm_out_t out, gpio_t gpio, uint16_t freq);
 
@@ -74,15 +84,119 @@ void PWMOff(pwm_out_t out);
  */
 void PWMSetDutyCycle(pwm_out_t out, uint8_t duty_cycle);
 
+/**
+ * @brief Change PWM duty of an PWM output in timer ticks
+ * 
+ * @param out PWM output 
+ * @param duty Duty in ticks (0 to PWMGetMaxDuty)
+ */
+void PWMSetDutyRaw(pwm_out_t out, uint32_t duty);
+
+/**
+ * @brief Duty value of 100% for an PWM output (2^resolution)
+ * 
+ * @param out PWM output 
+ * @return uint32_t Max duty in ticks, 0 if output is not initialized
+ */
+uint32_t PWMGetMaxDuty(pwm_out_t out);
+
+/**
+ * @brief Duty resolution of an PWM output
+ * 
+ * @param out PWM output 
+ * @return uint8_t Resolution in bits, 0 if output is not initialized
+ */
+uint8_t PWMGetResolution(pwm_out_t out);
+
+/**
+ * @brief Change duty of several PWM outputs at the same period boundary
+ * 
+ * All duty registers are loaded first and then latched back to back, so outputs
+ * sharing a timer (same frequency) switch to the new duty in the same PWM period.
+ * 
+ * @param outs List of PWM outputs
+ * @param duty New duty of each output in ticks (0 to PWMGetMaxDuty)
+ * @param qty Number of outputs in the list (up to PWM_QTY, invalid or uninitialized outputs are skipped)
+ */
+void PWMSetDutyGroupRaw(const pwm_out_t *outs, const uint32_t *duty, uint8_t qty);
+
+/**
+ * @brief Change duty cycle of several PWM outputs at the same period boundary
+ * 
+ * @param outs List of PWM outputs
+ * @param duty_cycle New duty cycle of each output in % (0 to 100)
+ * @param qty Number of outputs in the list (up to PWM_QTY)
+ */
+void PWMSetDutyCycleGroup(const pwm_out_t *outs, const uint8_t *duty_cycle, uint8_t qty);
+
+/**
+ * @brief Delay the rising edge of an PWM output inside the period
+ * 
+ * Staggering the edges of outputs that share a timer spreads their switching
+ * current over the period, instead of all of them turning on together.
+ * 
+ * @param out PWM output 
+ * @param phase Phase offset in % of the period (0 to 99)
+ */
+void PWMSetPhase(pwm_out_t out, uint8_t phase);
+
+/**
+ * @brief Delay the rising edge of an PWM output inside the period, in timer ticks
+ * 
+ * @param out PWM output 
+ * @param hpoint Phase offset in ticks (0 to PWMGetMaxDuty - 1)
+ */
+void PWMSetPhaseRaw(pwm_out_t out, uint32_t hpoint);
+
 /**
  * @brief Change frequency of an PWM output
  * 
+ * @note If other outputs share its timer, the output is moved to another
+ * timer, so the other outputs keep their frequency.
+ * 
  * @param out PWM output 
  * @param freq Frequency of PWM output (40kHz máx)
- * @return uint8_t 
+ * @return uint8_t 0 on success, 1 if no timer is available
  */
 uint8_t PWMSetFreq(pwm_out_t out, uint32_t freq);
 
+/**
+ * @brief Ramp the duty cycle of a PWM output in hardware
+ * 
+ * The ramp runs in the LEDC peripheral, without CPU intervention, and the function
+ * returns immediately. A new fade, duty or phase change on the same output stops
+ * the running ramp at its current duty and takes over from there.
+ * 
+ * @param out PWM output 
+ * @param duty_cycle Final duty cycle in % (0 to 100)
+ * @param time_ms Ramp duration in ms
+ */
+void PWMFadeTo(pwm_out_t out, uint8_t duty_cycle, uint32_t time_ms);
+
+/**
+ * @brief Ramp the duty cycle of a PWM output in hardware, with explicit steps
+ * 
+ * Duty changes by step ticks (see PWMGetMaxDuty) every cycle_num PWM periods,
+ * until duty_cycle is reached.
+ * 
+ * @param out PWM output 
+ * @param duty_cycle Final duty cycle in % (0 to 100)
+ * @param step Duty increment/decrement per step (ticks)
+ * @param cycle_num PWM periods between steps
+ */
+void PWMFadeStep(pwm_out_t out, uint8_t duty_cycle, uint32_t step, uint32_t cycle_num);
+
+/**
+ * @brief Register a function to call when a fade ends
+ * 
+ * @note The callback is called from an interrupt: keep it short and use only ISR-safe functions.
+ * 
+ * @param out PWM output 
+ * @param func_p Pointer to callback function (NULL to remove)
+ * @param param_p Pointer to callback function parameter
+ */
+void PWMFadeCallback(pwm_out_t out, void (*func_p)(void *), void *param_p);
+
 /**
  * @brief PWM output de-inicialization
  * 
@@ -7,17 +7,14 @@
 /** \addtogroup RTC Real Time Clock
  ** @{ */
 
-/** \brief GPIO driver for the ESP-EDU Board.
+/** \brief Real time clock driver for the ESP-EDU Board.
  *
- * This driver provide functions to configure and handle the ESP-EDU General
- * Purpose Input-Outputs .
+ * This driver keeps date and time from the system monotonic microsecond clock.
+ * Date is converted once per day and cached, so reading the time or timestamping
+ * samples only costs a few arithmetic operations.
  * 
- * @note GPIO_4 and GPIO_15 are connected to ESP-EDU switches (only GPIO_15 is available in headers)
- * 
- * @note GPIO_5, GPIO_10 and GPIO_11 are connected to ESP-EDU LEDs.
- * 
- * @note GPIO_12 and GPIO_13 are not recommended for use, because using them will
- * overwrite the flash and debug functionalities via USB.
+ * @note Time is kept in UTC (no time zone or daylight saving correction) and is
+ * lost on reset.
  * 
  * @author Albano Peñalva
  *
@@ -26,6 +23,7 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 23/10/2023 | Document creation		                         						|
+ * | 19/10/2026 | Monotonic clock, cached calendar conversion and batch timestamps		|
  * 
  **/
 
@@ -47,7 +45,7 @@ typedef struct {
    uint16_t year;	    /* 1 to 4095 */
    uint8_t  month;      /* 1 to 12   */
    uint8_t  mday;	    /* 1 to 31   */
-   uint8_t  wday;	    /* 1 to 7    */
+   uint8_t  wday;	    /* 1 to 7 (1: sunday), computed from the date */
    uint8_t  hour;	    /* 0 to 23   */
    uint8_t  min;	    /* 0 to 59   */
    uint8_t  sec;	    /* 0 to 59   */
@@ -72,6 +70,37 @@ bool RtcConfig(rtc_t * rtc);
  */
 void RtcRead(rtc_t * rtc);
 
+/**
+ * @brief Monotonic time since boot.
+ * 
+ * @return int64_t Time in us (never goes back, not affected by RtcConfig).
+ */
+int64_t RtcGetUs(void);
+
+/**
+ * @brief Actual date and time as microseconds since 1970-01-01 00:00:00.
+ * 
+ * @return int64_t Epoch time in us.
+ */
+int64_t RtcGetEpochUs(void);
+
+/**
+ * @brief Converts an epoch time (e.g. a stored timestamp) to date and time.
+ * 
+ * @param epoch_us  Epoch time in us (see RtcGetEpochUs).
+ * @param rtc       Pointer to structure to store date and time.
+ */
+void RtcEpochToDate(int64_t epoch_us, rtc_t * rtc);
+
+/**
+ * @brief Timestamps a batch of samples taken at a fixed period, the last one now.
+ * 
+ * @param timestamps    Array to store the epoch time (us) of each sample, oldest first.
+ * @param qty           Number of samples.
+ * @param period_us     Sampling period in us.
+ */
+void RtcTimestampBatch(int64_t * timestamps, uint16_t qty, uint32_t period_us);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
@@ -21,12 +21,15 @@
  * |   Date	    | Description                                    						|
  * |:----------:|:----------------------------------------------------------------------|
  * | 09/02/2024 | Document creation		                         						|
+ * | 19/10/2026 | Queued writes with a pre-transfer callback (SpiQueue*)				|
  * 
  **/
 /*==================[inclusions]=============================================*/
 #include <stdbool.h>
 #include <stdint.h>
 /*==================[macros]=================================================*/
+#define SPI_QUEUE_SIZE		8	/*!< Transactions of a device queued at the same time */
+#define SPI_QUEUE_COPY_LEN	4	/*!< Queued writes up to this length are copied, longer buffers must stay valid */
 
 /*==================[typedef]================================================*/
 
@@ -68,6 +71,8 @@ typedef struct{
 	transfer_mode_t transfer_mode;	/*!< Transfer mode */
 	void *func_p;					/*!< Pointer to callback function for transaction end */
 	void *param_p;					/*!< Pointer to callback parameter */
+	void *pre_func_p;				/*!< Pointer to callback function called before every transaction (from an interrupt,
+										 must be in IRAM), it receives the user data of SpiQueueWrite (NULL for the rest) */
 } spi_mcu_config_t;
 /*==================[external data declaration]==============================*/
 
@@ -108,6 +113,44 @@ void SpiWrite(spi_dev_t device, uint8_t * tx_buffer, uint32_t tx_buffer_size);
  */
 void SpiReadWrite(spi_dev_t device, uint8_t * tx_buffer, uint8_t * rx_buffer, uint32_t buffer_size);
 
+/**
+ * @brief Queue data to write to SPI port, without waiting for the transfer
+ * 
+ * Transactions of a device are sent in order, one after the other, while the CPU keeps working.
+ * The pre-transfer callback of the device runs before each one with its user data (e.g. to set
+ * the data/command line of a display).
+ * 
+ * @note Queued writes always use interrupts, whatever the transfer mode of the device. If
+ * SPI_QUEUE_SIZE transactions are pending, it waits for the oldest one to finish.
+ * 
+ * @param device SPI device to write to
+ * @param tx_buffer pointer to data to write. Up to SPI_QUEUE_COPY_LEN bytes it's copied,
+ * longer buffers must not change until SpiQueueWait returns
+ * @param tx_buffer_size numbers of bytes to write (up to 4092)
+ * @param user user data, given to the pre-transfer callback
+ */
+void SpiQueueWrite(spi_dev_t device, const uint8_t * tx_buffer, uint32_t tx_buffer_size, void *user);
+
+/**
+ * @brief Wait for every queued write of a device to finish
+ * 
+ * @note SpiRead, SpiWrite and SpiReadWrite wait for them too before starting.
+ * 
+ * @param device SPI device
+ */
+void SpiQueueWait(spi_dev_t device);
+
+/**
+ * @brief Wait until no more than a number of queued writes of a device are pending
+ * 
+ * Writes finish in order, so with pending = 1 every write but the last one is done: the
+ * buffer of the previous one can be filled again while the last one is on the wire.
+ * 
+ * @param device SPI device
+ * @param pending writes that may still be pending when it returns
+ */
+void SpiQueueWaitPending(spi_dev_t device, uint8_t pending);
+
 /**
  * @brief De-Initialize SPI module with the corresponding configuration
  * 
@@ -0,0 +1,238 @@
+/**
+ * @file ble_beacon_mcu.c
+ * @brief Connectionless BLE telemetry: payload encoding and refresh schedule (see ble_beacon_mcu.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_beacon_mcu.h"
+#include "ble_beacon_mcu_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_beacon"
+#define AD_FLAGS			0x01	/* AD types */
+#define AD_SHORT_NAME		0x08
+#define AD_COMPLETE_NAME	0x09
+#define AD_MANUFACTURER		0xFF
+#define AD_FLAGS_LEN		3		/* Flags structure: length, type and value */
+#define AD_HDR_LEN			2		/* Length and type of a structure */
+#define FLAG_NO_BR_EDR		0x04	/* LE only, not discoverable: there is nothing to connect to */
+#define MSD_HDR_LEN			5		/* Company id, version, node id and frame counter */
+#define NAME_MAX_LEN		29		/* Longer names are sent shortened */
+#define ADV_INTERVAL_MIN	20		/* Non connectable advertising, ms */
+#define ADV_INTERVAL_MAX	10000
+#define UPDATE_MS_MIN		100
+#define TAG_FORMAT_MASK		0x07	/* Reading tag: id in the upper 5 bits, format in the lower 3 */
+#define TAG_ID_SHIFT		3
+/*==================[typedef]================================================*/
+typedef struct {
+	bool set;
+	ble_beacon_format_t format;
+	uint8_t value[4];							/* Little endian copy of the value */
+} beacon_reading_t;
+/*==================[internal data declaration]==============================*/
+static ble_beacon_config_t beacon;
+static beacon_reading_t readings[BLE_BEACON_READINGS_MAX];
+static size_t readings_len = 0;					/* Bytes taken by the readings, tags included */
+static size_t readings_cap = 0;					/* Bytes available for readings in the current mode */
+static bool changed = false;					/* Readings set or cleared since the last refresh */
+static uint8_t frame = 0;						/* Frame counter, sent in the payload */
+static volatile bool active = false;
+static int64_t init_start_us;					/* BleBeaconInit time stamp, for the start up time */
+static SemaphoreHandle_t readings_mutex = NULL;
+static TaskHandle_t update_task_handle = NULL;
+/* Payload being built, sized for the largest mode */
+static uint8_t adv_buf[BLE_BEACON_EXT_LEN];
+static uint8_t periodic_buf[BLE_BEACON_EXT_LEN];
+static const uint8_t value_size[] = {
+	[BLE_BEACON_INT8] = 1, [BLE_BEACON_UINT8] = 1, [BLE_BEACON_INT16] = 2,
+	[BLE_BEACON_UINT16] = 2, [BLE_BEACON_INT32] = 4, [BLE_BEACON_FLOAT] = 4,
+};
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static uint8_t name_len(void) {
+	size_t len = (beacon.device_name != NULL) ? strlen(beacon.device_name) : 0;
+	return (len > NAME_MAX_LEN) ? NAME_MAX_LEN : len;
+}
+
+/* Manufacturer Specific Data structure, with the readings if with_readings */
+static uint8_t encode_msd(uint8_t *buf, bool with_readings) {
+	uint8_t len = AD_HDR_LEN;
+	buf[1] = AD_MANUFACTURER;
+	buf[len++] = BLE_BEACON_COMPANY_ID & 0xFF;
+	buf[len++] = BLE_BEACON_COMPANY_ID >> 8;
+	buf[len++] = BLE_BEACON_VERSION;
+	buf[len++] = beacon.node_id;
+	buf[len++] = frame;
+	for(uint8_t id = 0; with_readings && (id < BLE_BEACON_READINGS_MAX); id++){
+		if(readings[id].set){
+			buf[len++] = (id << TAG_ID_SHIFT) | readings[id].format;
+			memcpy(&buf[len], readings[id].value, value_size[readings[id].format]);
+			len += value_size[readings[id].format];
+		}
+	}
+	buf[0] = len - 1;
+	return len;
+}
+
+/* Advertising data: flags, name (BLE 5 modes) and Manufacturer Specific Data */
+static uint8_t encode_adv(uint8_t *buf) {
+	uint8_t len = 0, name = name_len();
+	buf[len++] = AD_FLAGS_LEN - 1;
+	buf[len++] = AD_FLAGS;
+	buf[len++] = FLAG_NO_BR_EDR;
+	if((beacon.mode != BLE_BEACON_LEGACY) && (name > 0)){
+		buf[len++] = name + 1;
+		buf[len++] = (name < strlen(beacon.device_name)) ? AD_SHORT_NAME : AD_COMPLETE_NAME;
+		memcpy(&buf[len], beacon.device_name, name);
+		len += name;
+	}
+	/* in periodic mode scanners find the node by the header and synchronize for the readings */
+	return len + encode_msd(&buf[len], beacon.mode != BLE_BEACON_PERIODIC);
+}
+
+static void refresh(void) {
+	uint8_t adv_len, periodic_len = 0;
+	xSemaphoreTake(readings_mutex, portMAX_DELAY);
+	adv_len = encode_adv(adv_buf);
+	if(beacon.mode == BLE_BEACON_PERIODIC){
+		periodic_len = encode_msd(periodic_buf, true);
+	}
+	changed = false;
+	xSemaphoreGive(readings_mutex);
+	if(!BleBeaconPortSetData(adv_buf, adv_len, (periodic_len > 0) ? periodic_buf : NULL, periodic_len)){
+		ESP_LOGE(TAG, "Advertising data update failed");
+	}
+}
+
+static void update_task(void* pvParameters) {
+	TickType_t last_wake = xTaskGetTickCount();
+	bool pending;
+	while(1) {
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(beacon.update_ms));
+		xSemaphoreTake(readings_mutex, portMAX_DELAY);
+		pending = changed;
+		if(pending){
+			frame++;
+		}
+		xSemaphoreGive(readings_mutex);
+		/* the controller repeats the last data, nothing to send if no reading changed */
+		if(pending){
+			refresh();
+		}
+	}
+}
+/*==================[external functions definition]==========================*/
+void BleBeaconOnAdvertising(void){
+	if(!active){
+		active = true;
+		ESP_LOGI(TAG, "Advertising %lld us after BleBeaconInit", (long long)(esp_timer_get_time() - init_start_us));
+	}
+}
+
+void BleBeaconInit(ble_beacon_config_t *config){
+	esp_err_t ret;
+	beacon = *config;
+	init_start_us = esp_timer_get_time();
+	if(beacon.adv_interval_ms < ADV_INTERVAL_MIN){
+		beacon.adv_interval_ms = ADV_INTERVAL_MIN;
+	}else if(beacon.adv_interval_ms > ADV_INTERVAL_MAX){
+		beacon.adv_interval_ms = ADV_INTERVAL_MAX;
+	}
+	if(beacon.update_ms < UPDATE_MS_MIN){
+		beacon.update_ms = UPDATE_MS_MIN;
+	}
+	switch(beacon.mode){
+		case BLE_BEACON_LEGACY:
+			readings_cap = BLE_BEACON_LEGACY_LEN - AD_FLAGS_LEN - AD_HDR_LEN - MSD_HDR_LEN;
+			break;
+		case BLE_BEACON_EXTENDED:
+			readings_cap = BLE_BEACON_EXT_LEN - AD_FLAGS_LEN - AD_HDR_LEN - name_len() - AD_HDR_LEN - MSD_HDR_LEN;
+			break;
+		case BLE_BEACON_PERIODIC:
+			/* periodic data carries no flags */
+			readings_cap = BLE_BEACON_EXT_LEN - AD_HDR_LEN - MSD_HDR_LEN;
+			break;
+	}
+	/* Initialize NVS, the controller keeps its calibration there */
+	ret = nvs_flash_init();
+	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		ret = nvs_flash_init();
+	}
+	ESP_ERROR_CHECK(ret);
+
+	readings_mutex = xSemaphoreCreateMutex();
+	configASSERT(readings_mutex);
+	/* the backend starts advertising with this payload: header only, no readings yet */
+	refresh();
+	if(!BleBeaconPortInit(beacon.mode, beacon.adv_interval_ms)){
+		return;
+	}
+	xTaskCreate(update_task, "ble_beacon", 1024*3, NULL, 2, &update_task_handle);
+}
+
+bool BleBeaconSetReading(uint8_t id, ble_beacon_format_t format, const void *value){
+	size_t len;
+	if((id >= BLE_BEACON_READINGS_MAX) || (format > BLE_BEACON_FLOAT) || (readings_mutex == NULL)){
+		return false;
+	}
+	xSemaphoreTake(readings_mutex, portMAX_DELAY);
+	len = readings_len + 1 + value_size[format];
+	if(readings[id].set){
+		len -= 1 + value_size[readings[id].format];
+	}
+	if(len > readings_cap){
+		xSemaphoreGive(readings_mutex);
+		return false;
+	}
+	readings_len = len;
+	readings[id].set = true;
+	readings[id].format = format;
+	/* the ESP32 is little endian, like the payload */
+	memcpy(readings[id].value, value, value_size[format]);
+	changed = true;
+	xSemaphoreGive(readings_mutex);
+	return true;
+}
+
+void BleBeaconClearReading(uint8_t id){
+	if((id >= BLE_BEACON_READINGS_MAX) || (readings_mutex == NULL)){
+		return;
+	}
+	xSemaphoreTake(readings_mutex, portMAX_DELAY);
+	if(readings[id].set){
+		readings[id].set = false;
+		readings_len -= 1 + value_size[readings[id].format];
+		changed = true;
+	}
+	xSemaphoreGive(readings_mutex);
+}
+
+size_t BleBeaconFree(void){
+	return readings_cap - readings_len;
+}
+
+bool BleBeaconActive(void){
+	return active;
+}
+/*==================[end of file]============================================*/
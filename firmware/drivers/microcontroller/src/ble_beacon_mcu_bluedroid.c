@@ -0,0 +1,244 @@
+/**
+ * @file ble_beacon_mcu_bluedroid.c
+ * @brief Bluedroid host glue of the BLE beacon driver (see ble_beacon_mcu_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_beacon_mcu_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "esp_bt.h"
+#include "esp_gap_ble_api.h"
+#include "esp_bt_defs.h"
+#include "esp_bt_main.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_beacon"
+#define GAP_WAIT_MS		1000	/* Maximum wait for the completion event of a GAP command */
+/*==================[typedef]================================================*/
+
+/*==================[internal data declaration]==============================*/
+static ble_beacon_mode_t beacon_mode;
+static bool started = false;					/* Advertising set enabled, data goes straight to the controller */
+static SemaphoreHandle_t gap_done = NULL;		/* Given by the GAP callback when a command completes */
+static esp_bt_status_t gap_status;
+static uint8_t adv_data[BLE_BEACON_EXT_LEN];	/* Copy of the last payload */
+static uint8_t adv_len = 0;
+static uint8_t periodic_data[BLE_BEACON_EXT_LEN];
+static uint8_t periodic_len = 0;
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+	switch (event) {
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+		case ESP_GAP_BLE_EXT_ADV_SET_PARAMS_COMPLETE_EVT:
+			gap_status = param->ext_adv_set_params.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT:
+			gap_status = param->ext_adv_data_set.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT:
+			gap_status = param->ext_adv_start.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_PERIODIC_ADV_SET_PARAMS_COMPLETE_EVT:
+			gap_status = param->peroid_adv_set_params.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_PERIODIC_ADV_DATA_SET_COMPLETE_EVT:
+			gap_status = param->period_adv_data_set.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_PERIODIC_ADV_START_COMPLETE_EVT:
+			gap_status = param->period_adv_start.status;
+			xSemaphoreGive(gap_done);
+			break;
+#else
+		case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
+			gap_status = param->adv_data_raw_cmpl.status;
+			xSemaphoreGive(gap_done);
+			break;
+		case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+			gap_status = param->adv_start_cmpl.status;
+			xSemaphoreGive(gap_done);
+			break;
+#endif
+		default:
+			break;
+	}
+}
+
+/* Waits for the completion event of a GAP command */
+static bool gap_wait(esp_err_t ret, const char *command) {
+	if(ret == ESP_OK){
+		if(xSemaphoreTake(gap_done, pdMS_TO_TICKS(GAP_WAIT_MS)) != pdTRUE){
+			ret = ESP_ERR_TIMEOUT;
+		}else if(gap_status != ESP_BT_STATUS_SUCCESS){
+			ret = ESP_FAIL;
+		}
+	}
+	if(ret != ESP_OK){
+		ESP_LOGE(TAG, "%s failed, error = %x, status = %x", command, ret, gap_status);
+		return false;
+	}
+	return true;
+}
+
+/* Sends the payload to the controller, it keeps repeating it */
+static bool set_data(void) {
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	if(!gap_wait(esp_ble_gap_config_ext_adv_data_raw(BLE_BEACON_ADV_INSTANCE, adv_len, adv_data), "ext adv data")){
+		return false;
+	}
+	if(periodic_len > 0){
+#if CONFIG_BT_BLE_FEAT_PERIODIC_ADV_ENH
+		return gap_wait(esp_ble_gap_config_periodic_adv_data_raw(BLE_BEACON_ADV_INSTANCE, periodic_len, periodic_data, false), "periodic adv data");
+#else
+		return gap_wait(esp_ble_gap_config_periodic_adv_data_raw(BLE_BEACON_ADV_INSTANCE, periodic_len, periodic_data), "periodic adv data");
+#endif
+	}
+	return true;
+#else
+	return gap_wait(esp_ble_gap_config_adv_data_raw(adv_data, adv_len), "adv data");
+#endif
+}
+
+static bool start(uint16_t interval_ms) {
+	/* advertising interval in 0.625 ms units, periodic interval in 1.25 ms units */
+	uint32_t interval = (uint32_t)interval_ms * 8 / 5;
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	esp_ble_gap_ext_adv_params_t params = {
+		/* nothing to connect to or to scan for: the payload is all there is */
+		.type = (beacon_mode == BLE_BEACON_LEGACY) ? ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY : ESP_BLE_GAP_SET_EXT_ADV_PROP_NONCONN_NONSCANNABLE_UNDIRECTED,
+		.interval_min = interval,
+		.interval_max = interval,
+		.channel_map = ADV_CHNL_ALL,
+		.filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+		.primary_phy = ESP_BLE_GAP_PRI_PHY_1M,
+		.max_skip = 0,
+		.secondary_phy = ESP_BLE_GAP_PHY_1M,
+		.sid = BLE_BEACON_SID,
+		.scan_req_notif = false,
+		.own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+		.tx_power = EXT_ADV_TX_PWR_NO_PREFERENCE,
+	};
+	esp_ble_gap_ext_adv_t ext_adv = {
+		.instance = BLE_BEACON_ADV_INSTANCE,
+		.duration = 0,
+		.max_events = 0,
+	};
+	if(!gap_wait(esp_ble_gap_ext_adv_set_params(BLE_BEACON_ADV_INSTANCE, &params), "ext adv params")){
+		return false;
+	}
+	if(beacon_mode == BLE_BEACON_PERIODIC){
+		esp_ble_gap_periodic_adv_params_t periodic_params = {
+			.interval_min = interval / 2,
+			.interval_max = interval / 2,
+			.properties = 0,
+		};
+		if(!gap_wait(esp_ble_gap_periodic_adv_set_params(BLE_BEACON_ADV_INSTANCE, &periodic_params), "periodic adv params")){
+			return false;
+		}
+	}
+	if(!set_data()){
+		return false;
+	}
+	if(beacon_mode == BLE_BEACON_PERIODIC){
+#if CONFIG_BT_BLE_FEAT_PERIODIC_ADV_ENH
+		if(!gap_wait(esp_ble_gap_periodic_adv_start(BLE_BEACON_ADV_INSTANCE, false), "periodic adv start")){
+#else
+		if(!gap_wait(esp_ble_gap_periodic_adv_start(BLE_BEACON_ADV_INSTANCE), "periodic adv start")){
+#endif
+			return false;
+		}
+	}
+	return gap_wait(esp_ble_gap_ext_adv_start(1, &ext_adv), "ext adv start");
+#else
+	esp_ble_adv_params_t params = {
+		.adv_int_min = interval,
+		.adv_int_max = interval,
+		.adv_type = ADV_TYPE_NONCONN_IND,
+		.own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+		.channel_map = ADV_CHNL_ALL,
+		.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+	};
+	if(beacon_mode != BLE_BEACON_LEGACY){
+		ESP_LOGE(TAG, "Extended advertising needs CONFIG_BT_BLE_50_FEATURES_SUPPORTED");
+		return false;
+	}
+	if(!set_data()){
+		return false;
+	}
+	return gap_wait(esp_ble_gap_start_advertising(&params), "adv start");
+#endif
+}
+/*==================[external functions definition]==========================*/
+bool BleBeaconPortInit(ble_beacon_mode_t mode, uint16_t interval_ms){
+	esp_err_t ret;
+	beacon_mode = mode;
+	gap_done = xSemaphoreCreateBinary();
+	configASSERT(gap_done);
+	ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+	esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+	ret = esp_bt_controller_init(&bt_cfg);
+	if (ret) {
+		ESP_LOGE(TAG, "%s init controller failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+	if (ret) {
+		ESP_LOGE(TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bluedroid_init();
+	if (ret) {
+		ESP_LOGE(TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bluedroid_enable();
+	if (ret) {
+		ESP_LOGE(TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_ble_gap_register_callback(gap_event_handler);
+	if (ret){
+		ESP_LOGE(TAG, "gap register error, error code = %x", ret);
+		return false;
+	}
+	/* Bluedroid is ready once enabled, commands can be sent from here */
+	if(!start(interval_ms)){
+		return false;
+	}
+	started = true;
+	BleBeaconOnAdvertising();
+	return true;
+}
+
+bool BleBeaconPortSetData(const uint8_t *adv, uint8_t adv_length, const uint8_t *periodic, uint8_t periodic_length){
+	memcpy(adv_data, adv, adv_length);
+	adv_len = adv_length;
+	if(periodic != NULL){
+		memcpy(periodic_data, periodic, periodic_length);
+	}
+	periodic_len = (periodic != NULL) ? periodic_length : 0;
+	/* complete data in one command: the controller accepts it with the set enabled */
+	return started ? set_data() : true;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,220 @@
+/**
+ * @file ble_beacon_mcu_nimble.c
+ * @brief NimBLE host glue of the BLE beacon driver (see ble_beacon_mcu_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_beacon_mcu_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_beacon"
+/*==================[typedef]================================================*/
+
+/*==================[internal data declaration]==============================*/
+static ble_beacon_mode_t beacon_mode;
+static uint16_t adv_interval_ms;
+static uint8_t own_addr_type;
+static bool started = false;					/* Advertising set enabled, data goes straight to the controller */
+static SemaphoreHandle_t data_mutex = NULL;		/* The payload is set by the core task and used by the host task */
+static uint8_t adv_data[BLE_BEACON_EXT_LEN];	/* Copy of the last payload */
+static uint8_t adv_len = 0;
+static uint8_t periodic_data[BLE_BEACON_EXT_LEN];
+static uint8_t periodic_len = 0;
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+/* Sends the payload to the controller, it keeps repeating it. Called with data_mutex taken. */
+static int set_data(void) {
+	int rc;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+	struct os_mbuf *om;
+	/* the stack frees om, also on error */
+	om = ble_hs_mbuf_from_flat(adv_data, adv_len);
+	if(om == NULL){
+		return BLE_HS_ENOMEM;
+	}
+	rc = ble_gap_ext_adv_set_data(BLE_BEACON_ADV_INSTANCE, om);
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+	if((rc == 0) && (periodic_len > 0)){
+		om = ble_hs_mbuf_from_flat(periodic_data, periodic_len);
+		if(om == NULL){
+			return BLE_HS_ENOMEM;
+		}
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_ENH
+		rc = ble_gap_periodic_adv_set_data(BLE_BEACON_ADV_INSTANCE, om, NULL);
+#else
+		rc = ble_gap_periodic_adv_set_data(BLE_BEACON_ADV_INSTANCE, om);
+#endif
+	}
+#endif
+#else
+	rc = ble_gap_adv_set_data(adv_data, adv_len);
+#endif
+	return rc;
+}
+
+static int start(void) {
+	int rc;
+#if CONFIG_BT_NIMBLE_EXT_ADV
+	/* advertising interval in 0.625 ms units */
+	struct ble_gap_ext_adv_params params = {
+		/* nothing to connect to or to scan for: the payload is all there is */
+		.connectable = 0,
+		.scannable = 0,
+		.legacy_pdu = (beacon_mode == BLE_BEACON_LEGACY),
+		.itvl_min = (uint32_t)adv_interval_ms * 8 / 5,
+		.itvl_max = (uint32_t)adv_interval_ms * 8 / 5,
+		.own_addr_type = own_addr_type,
+		.primary_phy = BLE_HCI_LE_PHY_1M,
+		.secondary_phy = BLE_HCI_LE_PHY_1M,
+		.tx_power = 127,
+		.sid = BLE_BEACON_SID,
+	};
+	rc = ble_gap_ext_adv_configure(BLE_BEACON_ADV_INSTANCE, &params, NULL, NULL, NULL);
+	if(rc != 0){
+		return rc;
+	}
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+	if(beacon_mode == BLE_BEACON_PERIODIC){
+		/* periodic interval in 1.25 ms units */
+		struct ble_gap_periodic_adv_params periodic_params = {
+			.itvl_min = (uint32_t)adv_interval_ms * 4 / 5,
+			.itvl_max = (uint32_t)adv_interval_ms * 4 / 5,
+		};
+		rc = ble_gap_periodic_adv_configure(BLE_BEACON_ADV_INSTANCE, &periodic_params);
+		if(rc != 0){
+			return rc;
+		}
+	}
+#endif
+	rc = set_data();
+	if(rc != 0){
+		return rc;
+	}
+#if CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+	if(beacon_mode == BLE_BEACON_PERIODIC){
+#if CONFIG_BT_NIMBLE_PERIODIC_ADV_ENH
+		rc = ble_gap_periodic_adv_start(BLE_BEACON_ADV_INSTANCE, NULL);
+#else
+		rc = ble_gap_periodic_adv_start(BLE_BEACON_ADV_INSTANCE);
+#endif
+		if(rc != 0){
+			return rc;
+		}
+	}
+#endif
+	return ble_gap_ext_adv_start(BLE_BEACON_ADV_INSTANCE, 0, 0);
+#else
+	struct ble_gap_adv_params params = {
+		.conn_mode = BLE_GAP_CONN_MODE_NON,
+		.disc_mode = BLE_GAP_DISC_MODE_NON,
+		.itvl_min = (uint32_t)adv_interval_ms * 8 / 5,
+		.itvl_max = (uint32_t)adv_interval_ms * 8 / 5,
+	};
+	rc = set_data();
+	if(rc != 0){
+		return rc;
+	}
+	return ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &params, NULL, NULL);
+#endif
+}
+
+static void on_reset(int reason) {
+	ESP_LOGE(TAG, "Host reset, reason = %d", reason);
+}
+
+static void on_sync(void) {
+	int rc;
+	ble_hs_util_ensure_addr(0);
+	ble_hs_id_infer_auto(0, &own_addr_type);
+	xSemaphoreTake(data_mutex, portMAX_DELAY);
+	rc = start();
+	started = (rc == 0);
+	xSemaphoreGive(data_mutex);
+	if(rc != 0){
+		ESP_LOGE(TAG, "Advertising start failed, error code = %d", rc);
+		return;
+	}
+	BleBeaconOnAdvertising();
+}
+
+static void host_task(void *param) {
+	/* returns only when the host is stopped */
+	nimble_port_run();
+	nimble_port_freertos_deinit();
+}
+
+/*==================[external functions definition]==========================*/
+bool BleBeaconPortInit(ble_beacon_mode_t mode, uint16_t interval_ms){
+	esp_err_t ret;
+	beacon_mode = mode;
+	adv_interval_ms = interval_ms;
+#if !CONFIG_BT_NIMBLE_EXT_ADV
+	if(mode != BLE_BEACON_LEGACY){
+		ESP_LOGE(TAG, "Extended advertising needs CONFIG_BT_NIMBLE_EXT_ADV");
+		return false;
+	}
+#elif !CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV
+	if(mode == BLE_BEACON_PERIODIC){
+		ESP_LOGE(TAG, "Periodic advertising needs CONFIG_BT_NIMBLE_ENABLE_PERIODIC_ADV");
+		return false;
+	}
+#endif
+	/* initializes the controller too */
+	ret = nimble_port_init();
+	if (ret) {
+		ESP_LOGE(TAG, "%s init nimble failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ble_hs_cfg.reset_cb = on_reset;
+	ble_hs_cfg.sync_cb = on_sync;
+	/* advertising starts in on_sync, once the host and the controller are in sync */
+	nimble_port_freertos_init(host_task);
+	return true;
+}
+
+bool BleBeaconPortSetData(const uint8_t *adv, uint8_t adv_length, const uint8_t *periodic, uint8_t periodic_length){
+	int rc = 0;
+	/* the core sets the first payload before BleBeaconPortInit */
+	if(data_mutex == NULL){
+		data_mutex = xSemaphoreCreateMutex();
+		configASSERT(data_mutex);
+	}
+	xSemaphoreTake(data_mutex, portMAX_DELAY);
+	memcpy(adv_data, adv, adv_length);
+	adv_len = adv_length;
+	if(periodic != NULL){
+		memcpy(periodic_data, periodic, periodic_length);
+	}
+	periodic_len = (periodic != NULL) ? periodic_length : 0;
+	/* complete data in one command: the controller accepts it with the set enabled */
+	if(started){
+		rc = set_data();
+	}
+	xSemaphoreGive(data_mutex);
+	if(rc != 0){
+		ESP_LOGE(TAG, "Advertising data update failed, error code = %d", rc);
+	}
+	return rc == 0;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,45 @@
+#ifndef BLE_BEACON_MCU_PORT_H
+#define BLE_BEACON_MCU_PORT_H
+/**
+ * @file ble_beacon_mcu_port.h
+ * @brief Internal interface between the ble_beacon_mcu core and the Bluetooth host stack.
+ *
+ * ble_beacon_mcu.c (payload encoding, refresh schedule and public API) doesn't depend
+ * on the host stack. The advertising set is handled by ble_beacon_mcu_bluedroid.c or
+ * ble_beacon_mcu_nimble.c, only one of them is compiled.
+ *
+ * - BlePort* functions are implemented by the backend and called by the core, they
+ *   may block until the controller answers.
+ * - BleOn* functions are implemented by the core and called by the backend from
+ *   the stack context, they must not block.
+ *
+ * Not part of the driver API, applications must use ble_beacon_mcu.h.
+ *
+ * @version 0.1
+ * @date 19/10/2026
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_beacon_mcu.h"
+#include <stdint.h>
+#include <stdbool.h>
+/*==================[macros]=================================================*/
+#define BLE_BEACON_ADV_INSTANCE		0		/* Advertising set */
+#define BLE_BEACON_SID				0		/* Advertising set id, periodic scanners filter by it */
+#define BLE_BEACON_LEGACY_LEN		31		/* Advertising data of legacy PDUs */
+#define BLE_BEACON_EXT_LEN			251		/* Extended and periodic data, what fits in one HCI command */
+/*==================[external functions declaration]=========================*/
+/* Implemented by the backend */
+bool BleBeaconPortInit(ble_beacon_mode_t mode, uint16_t interval_ms);
+/* adv goes in the advertising set, periodic (NULL in the other modes) in the periodic train.
+ * The backend keeps a copy: the first one, set before BleBeaconPortInit, is used when advertising starts. */
+bool BleBeaconPortSetData(const uint8_t *adv, uint8_t adv_len, const uint8_t *periodic, uint8_t periodic_len);
+
+/* Implemented by the core */
+void BleBeaconOnAdvertising(void);
+
+#endif /* BLE_BEACON_MCU_PORT_H */
+/*==================[end of file]============================================*/
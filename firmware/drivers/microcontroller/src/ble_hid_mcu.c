@@ -11,506 +11,172 @@
 
 /*==================[inclusions]=============================================*/
 #include "ble_hid_mcu.h"
+#include "ble_hid_mcu_port.h"
 #include <stdint.h>
 #include <string.h>
 
 #include "nvs_flash.h"
 
 #include "esp_log.h"
-
-#include "esp_bt.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_bt_defs.h"
-#include "esp_bt_main.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include "freertos/semphr.h"
 /*==================[macros and definitions]=================================*/
 #define TAG "ble_hid"
-/********************esp_hidd_prf_api**********************/
-// HID keyboard input report length
-#define HID_KEYBOARD_IN_RPT_LEN     		8
-// HID LED output report length
-#define HID_LED_OUT_RPT_LEN         		1
-// HID mouse input report length
-#define HID_MOUSE_IN_RPT_LEN        		5
-// HID consumer control input report length
-#define HID_CC_IN_RPT_LEN           		2
-/*************************hid_dev**************************/
-/* HID Report type */
-#define HID_TYPE_INPUT       				1
-#define HID_TYPE_OUTPUT      				2
-#define HID_TYPE_FEATURE     				3
-
-/*************************hidd_le**************************/
-/// Maximal number of HIDS that can be added in the DB
-#ifndef USE_ONE_HIDS_INSTANCE
-#define HIDD_LE_NB_HIDS_INST_MAX            (2)
-#else
-#define HIDD_LE_NB_HIDS_INST_MAX            (1)
-#endif
-#define HIDD_GREAT_VER   					0x01  //Version + Subversion
-#define HIDD_SUB_VER     					0x00  //Version + Subversion
-#define HIDD_VERSION     					((HIDD_GREAT_VER<<8)|HIDD_SUB_VER)  //Version + Subversion
-#define HID_MAX_APPS                 		1
-// Number of HID reports defined in the service
-#define HID_NUM_REPORTS          			9
-// HID Report IDs for the service
-#define HID_RPT_ID_MOUSE_IN      			1   // Mouse input report ID
-#define HID_RPT_ID_KEY_IN        			2   // Keyboard input report ID
-#define HID_RPT_ID_CC_IN         			3   //Consumer Control input report ID
-#define HID_RPT_ID_VENDOR_OUT    			4   // Vendor output report ID
-#define HID_RPT_ID_LED_OUT       			2  // LED output report ID
-#define HID_RPT_ID_FEATURE       			0  // Feature report ID
-#define HIDD_APP_ID							0x1812//ATT_SVC_HID
-#define BATTRAY_APP_ID       				0x180f
-#define ATT_SVC_HID          				0x1812
-/// Maximal number of Report Char. that can be added in the DB for one HIDS - Up to 11
-#define HIDD_LE_NB_REPORT_INST_MAX          (5)
-/// Maximal length of Report Char. Value
-#define HIDD_LE_REPORT_MAX_LEN              (255)
-/// Maximal length of Report Map Char. Value
-#define HIDD_LE_REPORT_MAP_MAX_LEN          (512)
-/// Length of Boot Report Char. Value Maximal Length
-#define HIDD_LE_BOOT_REPORT_MAX_LEN         (8)
-/// Boot KB Input Report Notification Configuration Bit Mask
-#define HIDD_LE_BOOT_KB_IN_NTF_CFG_MASK     (0x40)
-/// Boot KB Input Report Notification Configuration Bit Mask
-#define HIDD_LE_BOOT_MOUSE_IN_NTF_CFG_MASK  (0x80)
-/// Boot Report Notification Configuration Bit Mask
-#define HIDD_LE_REPORT_NTF_CFG_MASK         (0x20)
-/* HID information flags */
-#define HID_FLAGS_REMOTE_WAKE           	0x01      // RemoteWake
-#define HID_FLAGS_NORMALLY_CONNECTABLE  	0x02      // NormallyConnectable
-/* Control point commands */
-#define HID_CMD_SUSPEND                 	0x00      // Suspend
-#define HID_CMD_EXIT_SUSPEND            	0x01      // Exit Suspend
-/* HID protocol mode values */
-#define HID_PROTOCOL_MODE_BOOT          	0x00      // Boot Protocol Mode
-#define HID_PROTOCOL_MODE_REPORT        	0x01      // Report Protocol Mode
-/* Attribute value lengths */
-#define HID_PROTOCOL_MODE_LEN           	1         // HID Protocol Mode
-#define HID_INFORMATION_LEN             	4         // HID Information
-#define HID_REPORT_REF_LEN              	2         // HID Report Reference Descriptor
-#define HID_EXT_REPORT_REF_LEN          	2         // External Report Reference Descriptor
-// HID feature flags
-#define HID_KBD_FLAGS             			HID_FLAGS_REMOTE_WAKE
-/* HID Report type */
-#define HID_REPORT_TYPE_INPUT       		1
-#define HID_REPORT_TYPE_OUTPUT      		2
-#define HID_REPORT_TYPE_FEATURE     		3
-/// HID Service Attributes Indexes
-enum {
-    HIDD_LE_IDX_SVC,
-    // Included Service
-    HIDD_LE_IDX_INCL_SVC,
-    // HID Information
-    HIDD_LE_IDX_HID_INFO_CHAR,
-    HIDD_LE_IDX_HID_INFO_VAL,
-    // HID Control Point
-    HIDD_LE_IDX_HID_CTNL_PT_CHAR,
-    HIDD_LE_IDX_HID_CTNL_PT_VAL,
-    // Report Map
-    HIDD_LE_IDX_REPORT_MAP_CHAR,
-    HIDD_LE_IDX_REPORT_MAP_VAL,
-    HIDD_LE_IDX_REPORT_MAP_EXT_REP_REF,
-    // Protocol Mode
-    HIDD_LE_IDX_PROTO_MODE_CHAR,
-    HIDD_LE_IDX_PROTO_MODE_VAL,
-    // Report mouse input
-    HIDD_LE_IDX_REPORT_MOUSE_IN_CHAR,
-    HIDD_LE_IDX_REPORT_MOUSE_IN_VAL,
-    HIDD_LE_IDX_REPORT_MOUSE_IN_CCC,
-    HIDD_LE_IDX_REPORT_MOUSE_REP_REF,
-    //Report Key input
-    HIDD_LE_IDX_REPORT_KEY_IN_CHAR,
-    HIDD_LE_IDX_REPORT_KEY_IN_VAL,
-    HIDD_LE_IDX_REPORT_KEY_IN_CCC,
-    HIDD_LE_IDX_REPORT_KEY_IN_REP_REF,
-    ///Report Led output
-    HIDD_LE_IDX_REPORT_LED_OUT_CHAR,
-    HIDD_LE_IDX_REPORT_LED_OUT_VAL,
-    HIDD_LE_IDX_REPORT_LED_OUT_REP_REF,
-    HIDD_LE_IDX_REPORT_CC_IN_CHAR,
-    HIDD_LE_IDX_REPORT_CC_IN_VAL,
-    HIDD_LE_IDX_REPORT_CC_IN_CCC,
-    HIDD_LE_IDX_REPORT_CC_IN_REP_REF,
-    // Boot Keyboard Input Report
-    HIDD_LE_IDX_BOOT_KB_IN_REPORT_CHAR,
-    HIDD_LE_IDX_BOOT_KB_IN_REPORT_VAL,
-    HIDD_LE_IDX_BOOT_KB_IN_REPORT_NTF_CFG,
-    // Boot Keyboard Output Report
-    HIDD_LE_IDX_BOOT_KB_OUT_REPORT_CHAR,
-    HIDD_LE_IDX_BOOT_KB_OUT_REPORT_VAL,
-    // Boot Mouse Input Report
-    HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_CHAR,
-    HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_VAL,
-    HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_NTF_CFG,
-    // Report
-    HIDD_LE_IDX_REPORT_CHAR,
-    HIDD_LE_IDX_REPORT_VAL,
-    HIDD_LE_IDX_REPORT_REP_REF,
-    //HIDD_LE_IDX_REPORT_NTF_CFG,
-    HIDD_LE_IDX_NB,
-};
-/// Attribute Table Indexes
-enum {
-    HIDD_LE_INFO_CHAR,
-    HIDD_LE_CTNL_PT_CHAR,
-    HIDD_LE_REPORT_MAP_CHAR,
-    HIDD_LE_REPORT_CHAR,
-    HIDD_LE_PROTO_MODE_CHAR,
-    HIDD_LE_BOOT_KB_IN_REPORT_CHAR,
-    HIDD_LE_BOOT_KB_OUT_REPORT_CHAR,
-    HIDD_LE_BOOT_MOUSE_IN_REPORT_CHAR,
-    HIDD_LE_CHAR_MAX //= HIDD_LE_REPORT_CHAR + HIDD_LE_NB_REPORT_INST_MAX,
-};
-///att read event table Indexs
-enum {
-    HIDD_LE_READ_INFO_EVT,
-    HIDD_LE_READ_CTNL_PT_EVT,
-    HIDD_LE_READ_REPORT_MAP_EVT,
-    HIDD_LE_READ_REPORT_EVT,
-    HIDD_LE_READ_PROTO_MODE_EVT,
-    HIDD_LE_BOOT_KB_IN_REPORT_EVT,
-    HIDD_LE_BOOT_KB_OUT_REPORT_EVT,
-    HIDD_LE_BOOT_MOUSE_IN_REPORT_EVT,
-
-    HID_LE_EVT_MAX
-};
-/// Client Characteristic Configuration Codes
-enum {
-    HIDD_LE_DESC_MASK = 0x10,
-
-    HIDD_LE_BOOT_KB_IN_REPORT_CFG     = HIDD_LE_BOOT_KB_IN_REPORT_CHAR | HIDD_LE_DESC_MASK,
-    HIDD_LE_BOOT_MOUSE_IN_REPORT_CFG  = HIDD_LE_BOOT_MOUSE_IN_REPORT_CHAR | HIDD_LE_DESC_MASK,
-    HIDD_LE_REPORT_CFG                = HIDD_LE_REPORT_CHAR | HIDD_LE_DESC_MASK,
-};
-/// Features Flag Values
-enum {
-    HIDD_LE_CFG_KEYBOARD      = 0x01,
-    HIDD_LE_CFG_MOUSE         = 0x02,
-    HIDD_LE_CFG_PROTO_MODE    = 0x04,
-    HIDD_LE_CFG_MAP_EXT_REF   = 0x08,
-    HIDD_LE_CFG_BOOT_KB_WR    = 0x10,
-    HIDD_LE_CFG_BOOT_MOUSE_WR = 0x20,
-};
-/// Report Char. Configuration Flag Values
-enum {
-    HIDD_LE_CFG_REPORT_IN     = 0x01,
-    HIDD_LE_CFG_REPORT_OUT    = 0x02,
-    //HOGPD_CFG_REPORT_FEAT can be used as a mask to check Report type
-    HIDD_LE_CFG_REPORT_FEAT   = 0x03,
-    HIDD_LE_CFG_REPORT_WR     = 0x10,
-};
-/// Pointer to the connection clean-up function
-#define HIDD_LE_CLEANUP_FNCT	(NULL)
-/// Battery Service Attributes Indexes
-enum{
-    BAS_IDX_SVC,
-
-    BAS_IDX_BATT_LVL_CHAR,
-    BAS_IDX_BATT_LVL_VAL,
-    BAS_IDX_BATT_LVL_NTF_CFG,
-    BAS_IDX_BATT_LVL_PRES_FMT,
-
-    BAS_IDX_NB,
-};
-#define HI_UINT16(a) 			(((a) >> 8) & 0xFF)
-#define LO_UINT16(a) 			((a) & 0xFF)
-#define PROFILE_NUM            	1
-#define PROFILE_APP_IDX        	0
-#define CHAR_DECLARATION_SIZE   (sizeof(uint8_t))
-
-/***************************hidd****************************/
-
+#define HID_DEFAULT_INTERVAL	12		/* 15 ms, until the central reports the real one */
+#define HID_MOUSE_BURST			3		/* Reports per connection interval while a large motion is pending */
+#define HID_BUTTON_QUEUE		8		/* Button changes waiting to be reported (power of 2) */
+#define HID_DELTA_MAX			127		/* Mouse report range: -127 to 127 */
+#define HID_ACC_MAX				32767	/* Saturation of the motion accumulators */
+#define HID_RATE_WINDOW_US		1000000	/* Report rate measurement window */
+#define HID_KEY_BURST			3		/* Keyboard reports per connection interval while typing */
+#define HID_KEY_QUEUE			256		/* Keystrokes waiting to be typed (power of 2) */
+#define HID_KEY_SLOTS			(HID_KEYBOARD_IN_RPT_LEN - 2)	/* Keys per keyboard report */
+#define HID_KEY_WAIT_MS			100		/* Maximum wait for queue space before checking the link again */
+#define HID_KEY_NON_US_BSLASH	0x64	/* ISO key between left shift and Z */
+#define HID_DEAD_KEY			RIGHT_GUI_KEY_MASK	/* Layout flag: dead key, typed with a space after it */
+/* Layout table entries: plain key, with shift, with AltGr and dead key with AltGr */
+#define KEY(key)				{key, 0}
+#define SFT(key)				{key, LEFT_SHIFT_KEY_MASK}
+#define AGR(key)				{key, RIGHT_ALT_KEY_MASK}
+#define DEAD(key)				{key, RIGHT_ALT_KEY_MASK | HID_DEAD_KEY}
 /*==================[typedef]================================================*/
-/********************esp_hidd_prf_api**********************/
-typedef enum {
-    ESP_HIDD_EVENT_REG_FINISH = 0,
-    ESP_BAT_EVENT_REG,
-    ESP_HIDD_EVENT_DEINIT_FINISH,
-    ESP_HIDD_EVENT_BLE_CONNECT,
-    ESP_HIDD_EVENT_BLE_DISCONNECT,
-    ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT,
-    ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT,
-} esp_hidd_cb_event_t;
-/// HID config status
-typedef enum {
-    ESP_HIDD_STA_CONN_SUCCESS = 0x00,
-    ESP_HIDD_STA_CONN_FAIL    = 0x01,
-} esp_hidd_sta_conn_state_t;
-/// HID init status
-typedef enum {
-    ESP_HIDD_INIT_OK = 0,
-    ESP_HIDD_INIT_FAILED = 1,
-} esp_hidd_init_state_t;
-/// HID deinit status
-typedef enum {
-    ESP_HIDD_DEINIT_OK = 0,
-    ESP_HIDD_DEINIT_FAILED = 0,
-} esp_hidd_deinit_state_t;
-/**
- * @brief HIDD callback parameters union
- */
-typedef union {
-    /**
-	 * @brief ESP_HIDD_EVENT_INIT_FINISH
-	 */
-    struct hidd_init_finish_evt_param {
-        esp_hidd_init_state_t state;				/*!< Initial status */
-        esp_gatt_if_t gatts_if;
-    } init_finish;							      /*!< HID callback param of ESP_HIDD_EVENT_INIT_FINISH */
-    /**
-	 * @brief ESP_HIDD_EVENT_DEINIT_FINISH
-	 */
-    struct hidd_deinit_finish_evt_param {
-        esp_hidd_deinit_state_t state;				/*!< De-initial status */
-    } deinit_finish;								/*!< HID callback param of ESP_HIDD_EVENT_DEINIT_FINISH */
-    /**
-     * @brief ESP_HIDD_EVENT_CONNECT
-	 */
-    struct hidd_connect_evt_param {
-        uint16_t conn_id;
-        esp_bd_addr_t remote_bda;                   /*!< HID Remote bluetooth connection index */
-    } connect;									    /*!< HID callback param of ESP_HIDD_EVENT_CONNECT */
-    /**
-     * @brief ESP_HIDD_EVENT_DISCONNECT
-	 */
-    struct hidd_disconnect_evt_param {
-        esp_bd_addr_t remote_bda;                   /*!< HID Remote bluetooth device address */
-    } disconnect;									/*!< HID callback param of ESP_HIDD_EVENT_DISCONNECT */
-    /**
-     * @brief ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT
-	 */
-    struct hidd_vendor_write_evt_param {
-        uint16_t conn_id;                           /*!< HID connection index */
-        uint16_t report_id;                         /*!< HID report index */
-        uint16_t length;                            /*!< data length */
-        uint8_t  *data;                             /*!< The pointer to the data */
-    } vendor_write;									/*!< HID callback param of ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT */
-    /**
-     * @brief ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT
-     */
-    struct hidd_led_write_evt_param {
-        uint16_t conn_id;
-        uint8_t report_id;
-        uint8_t length;
-        uint8_t *data;
-    } led_write;
-} esp_hidd_cb_param_t;
-/**
- * @brief HID device event callback function type
- * @param event : Event type
- * @param param : Point to callback parameter, currently is union type
- */
-typedef void (*esp_hidd_event_cb_t) (esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param);
-
-/*************************hid_dev**************************/
-// HID report mapping table
-typedef struct{
-  uint16_t    handle;           // Handle of report characteristic
-  uint16_t    cccdHandle;       // Handle of CCCD for report characteristic
-  uint8_t     id;               // Report ID
-  uint8_t     type;             // Report type
-  uint8_t     mode;             // Protocol mode (report or boot)
-} hid_report_map_t;
-// HID dev configuration structure
-typedef struct{
-  uint32_t    idleTimeout;      // Idle timeout in milliseconds
-  uint8_t     hidFlags;         // HID feature flags
-} hid_dev_cfg_t;
-
-/*************************hidd_le**************************/
-/// HIDD Features structure
+/** @brief Key and modifiers that type a character */
 typedef struct {
-    /// Service Features
-    uint8_t svc_features;
-    /// Number of Report Char. instances to add in the database
-    uint8_t report_nb;
-    /// Report Char. Configuration
-    uint8_t report_char_cfg[HIDD_LE_NB_REPORT_INST_MAX];
-} hidd_feature_t;
-//
-typedef struct {
-    bool                        in_use;
-    bool                        congest;
-    uint16_t                  conn_id;
-    bool                        connected;
-    esp_bd_addr_t         remote_bda;
-    uint32_t                  trans_id;
-    uint8_t                    cur_srvc_id;
-} hidd_clcb_t;
-// HID report mapping table
-typedef struct {
-    uint16_t    handle;           // Handle of report characteristic
-    uint16_t    cccdHandle;       // Handle of CCCD for report characteristic
-    uint8_t     id;               // Report ID
-    uint8_t     type;             // Report type
-    uint8_t     mode;             // Protocol mode (report or boot)
-} hidRptMap_t;
-//
-typedef struct {
-    /// hidd profile id
-    uint8_t app_id;
-    /// Notified handle
-    uint16_t ntf_handle;
-    ///Attribute handle Table
-    uint16_t att_tbl[HIDD_LE_IDX_NB];
-    /// Supported Features
-    hidd_feature_t   hidd_feature[HIDD_LE_NB_HIDS_INST_MAX];
-    /// Current Protocol Mode
-    uint8_t proto_mode[HIDD_LE_NB_HIDS_INST_MAX];
-    /// Number of HIDS added in the database
-    uint8_t hids_nb;
-    uint8_t pending_evt;
-    uint16_t pending_hal;
-} hidd_inst_t;
-/// Report Reference structure
-typedef struct{
-    ///Report ID
-    uint8_t report_id;
-    ///Report Type
-    uint8_t report_type;
-}hids_report_ref_t;
-/// HID Information structure
-typedef struct{
-    /// bcdHID
-    uint16_t bcdHID;
-    /// bCountryCode
-    uint8_t bCountryCode;
-    /// Flags
-    uint8_t flags;
-}hids_hid_info_t;
-/* service engine control block */
-typedef struct {
-    hidd_clcb_t                  hidd_clcb[HID_MAX_APPS];          /* connection link*/
-    esp_gatt_if_t                gatt_if;
-    bool                         enabled;
-    bool                         is_take;
-    bool                         is_primery;
-    hidd_inst_t                  hidd_inst;
-    esp_hidd_event_cb_t          hidd_cb;
-    uint8_t                      inst_id;
-} hidd_le_env_t;
+    uint8_t key;        /* Usage ID, 0: the layout can't type it */
+    uint8_t mods;       /* key_mask_t, plus HID_DEAD_KEY */
+} hid_keystroke_t;
 
-/***************************hidd****************************/
+/** @brief Non ASCII character of a layout */
+typedef struct {
+    uint16_t code;      /* Unicode code point */
+    hid_keystroke_t stroke;
+} hid_extra_char_t;
 
+/** @brief Precomputed layout: ASCII table plus a few characters of the national keys */
+typedef struct {
+    const hid_keystroke_t *ascii;
+    const hid_extra_char_t *extra;
+    uint8_t extra_qty;
+} hid_layout_table_t;
 /*==================[internal data declaration]==============================*/
-/********************esp_hidd_prf_api**********************/
-
-
-/*************************hid_dev**************************/
-static hid_report_map_t *hid_dev_rpt_tbl;
-static uint8_t hid_dev_rpt_tbl_Len;
-
-/*************************hidd_le**************************/
-extern hidd_le_env_t hidd_le_env;
-extern uint8_t hidProtocolMode;
-/// characteristic presentation information
-struct prf_char_pres_fmt{
-    /// Unit (The Unit is a UUID)
-    uint16_t unit;
-    /// Description
-    uint16_t description;
-    /// Format
-    uint8_t format;
-    /// Exponent
-    uint8_t exponent;
-    /// Name space
-    uint8_t name_space;
-};
-// HID report mapping table
-static hid_report_map_t hid_rpt_map[HID_NUM_REPORTS];
-//
-struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-};
-hidd_le_env_t hidd_le_env;
-char * device_name;         /* Device name */
+static ble_status_t status = BLE_OFF;
+static int64_t init_start_us;					/* BleHidInit time stamp, for the start up time */
+static volatile uint16_t conn_interval = HID_DEFAULT_INTERVAL;	/* x 1.25 ms */
+static TaskHandle_t report_task_handle = NULL;
+static esp_timer_handle_t report_timer = NULL;	/* Paces reports at the connection interval */
+static SemaphoreHandle_t report_mutex = NULL;
+static bool pacing = false;						/* report_timer running, the next report waits for it */
+/* Mouse motion not reported yet, every report takes up to HID_DELTA_MAX of it */
+static int32_t acc_x, acc_y, acc_wheel;
+static uint8_t buttons = 0;						/* Buttons state in the last report */
+static uint8_t last_buttons = 0;				/* Buttons state requested by the application */
+static uint8_t button_queue[HID_BUTTON_QUEUE];	/* Button changes, one report each */
+static uint8_t button_head = 0, button_tail = 0;
+static uint32_t rate_reports = 0;				/* Reports sent in the current window */
+static int64_t rate_start_us = 0;
+static uint16_t report_rate = 0;				/* Reports per second in the last window */
+/* Keystrokes queue, filled by BleHidTypeString and packed in reports by the report task */
+static hid_keystroke_t key_queue[HID_KEY_QUEUE];
+static volatile size_t key_head = 0;			/* Written by producers (under report_mutex) */
+static volatile size_t key_tail = 0;			/* Written by the report task (under report_mutex) */
+static SemaphoreHandle_t key_space = NULL;		/* Given by the report task every time it frees space */
+static SemaphoreHandle_t type_mutex = NULL;		/* Keeps strings from different tasks contiguous */
+static uint8_t keys_down[HID_KEY_SLOTS];		/* Keys pressed in the last keyboard report */
+static uint8_t keys_down_qty = 0;
+static uint8_t typing_keys = HID_KEY_SLOTS;		/* Keys packed per report */
 
 /*==================[internal functions declaration]=========================*/
-/********************esp_hidd_prf_api**********************/
-/**
- * @brief           This function is called to receive hid device callback event
- */
-esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks);
-/**
- * @brief           This function is called to initialize hid device profile
- */
-esp_err_t esp_hidd_profile_init(void);
-/**
- * @brief           This function is called to de-initialize hid device profile
- */
-esp_err_t esp_hidd_profile_deinit(void);
-/**
- * @brief           Get hidd profile version
- */
-uint16_t esp_hidd_get_version(void);
-
-/*************************hid_dev**************************/
-/**
- * @brief           
- */
-void hid_dev_register_reports(uint8_t num_reports, hid_report_map_t *p_report);
-/**
- * @brief           
- */
-void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
-    					uint8_t id, uint8_t type, uint8_t length, uint8_t *data);
-
-/*************************hidd_le**************************/
-/**
- * @brief           
- */
-void hidd_clcb_alloc (uint16_t conn_id, esp_bd_addr_t bda);
-/**
- * @brief           
- */
-bool hidd_clcb_dealloc (uint16_t conn_id);
-/**
- * @brief           
- */
-void hidd_le_create_service(esp_gatt_if_t gatts_if);
-/**
- * @brief           
- */
-void hidd_set_attr_value(uint16_t handle, uint16_t val_len, const uint8_t *value);
-/**
- * @brief           
- */
-void hidd_get_attr_value(uint16_t handle, uint16_t *length, uint8_t **value);
-/**
- * @brief           
- */
-esp_err_t hidd_register_cb(void);
-/**
- * @brief           
- */
-static void hid_add_id_tbl(void);
-
-/***************************hidd****************************/
-/**
- * @brief           
- */
-static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param);
 
 /*==================[internal data definition]===============================*/
-/********************esp_hidd_prf_api**********************/
+/* US layout */
+static const hid_keystroke_t layout_us[128] = {
+    ['\b'] = KEY(HID_KEY_DELETE), ['\t'] = KEY(HID_KEY_TAB), ['\n'] = KEY(HID_KEY_RETURN),
+    [' '] = KEY(HID_KEY_SPACEBAR),
+    ['a'] = KEY(HID_KEY_A), ['b'] = KEY(HID_KEY_B), ['c'] = KEY(HID_KEY_C), ['d'] = KEY(HID_KEY_D),
+    ['e'] = KEY(HID_KEY_E), ['f'] = KEY(HID_KEY_F), ['g'] = KEY(HID_KEY_G), ['h'] = KEY(HID_KEY_H),
+    ['i'] = KEY(HID_KEY_I), ['j'] = KEY(HID_KEY_J), ['k'] = KEY(HID_KEY_K), ['l'] = KEY(HID_KEY_L),
+    ['m'] = KEY(HID_KEY_M), ['n'] = KEY(HID_KEY_N), ['o'] = KEY(HID_KEY_O), ['p'] = KEY(HID_KEY_P),
+    ['q'] = KEY(HID_KEY_Q), ['r'] = KEY(HID_KEY_R), ['s'] = KEY(HID_KEY_S), ['t'] = KEY(HID_KEY_T),
+    ['u'] = KEY(HID_KEY_U), ['v'] = KEY(HID_KEY_V), ['w'] = KEY(HID_KEY_W), ['x'] = KEY(HID_KEY_X),
+    ['y'] = KEY(HID_KEY_Y), ['z'] = KEY(HID_KEY_Z),
+    ['A'] = SFT(HID_KEY_A), ['B'] = SFT(HID_KEY_B), ['C'] = SFT(HID_KEY_C), ['D'] = SFT(HID_KEY_D),
+    ['E'] = SFT(HID_KEY_E), ['F'] = SFT(HID_KEY_F), ['G'] = SFT(HID_KEY_G), ['H'] = SFT(HID_KEY_H),
+    ['I'] = SFT(HID_KEY_I), ['J'] = SFT(HID_KEY_J), ['K'] = SFT(HID_KEY_K), ['L'] = SFT(HID_KEY_L),
+    ['M'] = SFT(HID_KEY_M), ['N'] = SFT(HID_KEY_N), ['O'] = SFT(HID_KEY_O), ['P'] = SFT(HID_KEY_P),
+    ['Q'] = SFT(HID_KEY_Q), ['R'] = SFT(HID_KEY_R), ['S'] = SFT(HID_KEY_S), ['T'] = SFT(HID_KEY_T),
+    ['U'] = SFT(HID_KEY_U), ['V'] = SFT(HID_KEY_V), ['W'] = SFT(HID_KEY_W), ['X'] = SFT(HID_KEY_X),
+    ['Y'] = SFT(HID_KEY_Y), ['Z'] = SFT(HID_KEY_Z),
+    ['1'] = KEY(HID_KEY_1), ['2'] = KEY(HID_KEY_2), ['3'] = KEY(HID_KEY_3), ['4'] = KEY(HID_KEY_4),
+    ['5'] = KEY(HID_KEY_5), ['6'] = KEY(HID_KEY_6), ['7'] = KEY(HID_KEY_7), ['8'] = KEY(HID_KEY_8),
+    ['9'] = KEY(HID_KEY_9), ['0'] = KEY(HID_KEY_0),
+    ['!'] = SFT(HID_KEY_1), ['@'] = SFT(HID_KEY_2), ['#'] = SFT(HID_KEY_3), ['$'] = SFT(HID_KEY_4),
+    ['%'] = SFT(HID_KEY_5), ['^'] = SFT(HID_KEY_6), ['&'] = SFT(HID_KEY_7), ['*'] = SFT(HID_KEY_8),
+    ['('] = SFT(HID_KEY_9), [')'] = SFT(HID_KEY_0),
+    ['-'] = KEY(HID_KEY_MINUS), ['_'] = SFT(HID_KEY_MINUS), ['='] = KEY(HID_KEY_EQUAL), ['+'] = SFT(HID_KEY_EQUAL),
+    ['['] = KEY(HID_KEY_LEFT_BRKT), ['{'] = SFT(HID_KEY_LEFT_BRKT), [']'] = KEY(HID_KEY_RIGHT_BRKT),
+    ['}'] = SFT(HID_KEY_RIGHT_BRKT), ['\\'] = KEY(HID_KEY_BACK_SLASH), ['|'] = SFT(HID_KEY_BACK_SLASH),
+    [';'] = KEY(HID_KEY_SEMI_COLON), [':'] = SFT(HID_KEY_SEMI_COLON), ['\''] = KEY(HID_KEY_SGL_QUOTE),
+    ['"'] = SFT(HID_KEY_SGL_QUOTE), ['`'] = KEY(HID_KEY_GRV_ACCENT), ['~'] = SFT(HID_KEY_GRV_ACCENT),
+    [','] = KEY(HID_KEY_COMMA), ['<'] = SFT(HID_KEY_COMMA), ['.'] = KEY(HID_KEY_DOT), ['>'] = SFT(HID_KEY_DOT),
+    ['/'] = KEY(HID_KEY_FWD_SLASH), ['?'] = SFT(HID_KEY_FWD_SLASH),
+};
 
+/* Latin American layout, keys named after their US position */
+static const hid_keystroke_t layout_latam[128] = {
+    ['\b'] = KEY(HID_KEY_DELETE), ['\t'] = KEY(HID_KEY_TAB), ['\n'] = KEY(HID_KEY_RETURN),
+    [' '] = KEY(HID_KEY_SPACEBAR),
+    ['a'] = KEY(HID_KEY_A), ['b'] = KEY(HID_KEY_B), ['c'] = KEY(HID_KEY_C), ['d'] = KEY(HID_KEY_D),
+    ['e'] = KEY(HID_KEY_E), ['f'] = KEY(HID_KEY_F), ['g'] = KEY(HID_KEY_G), ['h'] = KEY(HID_KEY_H),
+    ['i'] = KEY(HID_KEY_I), ['j'] = KEY(HID_KEY_J), ['k'] = KEY(HID_KEY_K), ['l'] = KEY(HID_KEY_L),
+    ['m'] = KEY(HID_KEY_M), ['n'] = KEY(HID_KEY_N), ['o'] = KEY(HID_KEY_O), ['p'] = KEY(HID_KEY_P),
+    ['q'] = KEY(HID_KEY_Q), ['r'] = KEY(HID_KEY_R), ['s'] = KEY(HID_KEY_S), ['t'] = KEY(HID_KEY_T),
+    ['u'] = KEY(HID_KEY_U), ['v'] = KEY(HID_KEY_V), ['w'] = KEY(HID_KEY_W), ['x'] = KEY(HID_KEY_X),
+    ['y'] = KEY(HID_KEY_Y), ['z'] = KEY(HID_KEY_Z),
+    ['A'] = SFT(HID_KEY_A), ['B'] = SFT(HID_KEY_B), ['C'] = SFT(HID_KEY_C), ['D'] = SFT(HID_KEY_D),
+    ['E'] = SFT(HID_KEY_E), ['F'] = SFT(HID_KEY_F), ['G'] = SFT(HID_KEY_G), ['H'] = SFT(HID_KEY_H),
+    ['I'] = SFT(HID_KEY_I), ['J'] = SFT(HID_KEY_J), ['K'] = SFT(HID_KEY_K), ['L'] = SFT(HID_KEY_L),
+    ['M'] = SFT(HID_KEY_M), ['N'] = SFT(HID_KEY_N), ['O'] = SFT(HID_KEY_O), ['P'] = SFT(HID_KEY_P),
+    ['Q'] = SFT(HID_KEY_Q), ['R'] = SFT(HID_KEY_R), ['S'] = SFT(HID_KEY_S), ['T'] = SFT(HID_KEY_T),
+    ['U'] = SFT(HID_KEY_U), ['V'] = SFT(HID_KEY_V), ['W'] = SFT(HID_KEY_W), ['X'] = SFT(HID_KEY_X),
+    ['Y'] = SFT(HID_KEY_Y), ['Z'] = SFT(HID_KEY_Z),
+    ['1'] = KEY(HID_KEY_1), ['2'] = KEY(HID_KEY_2), ['3'] = KEY(HID_KEY_3), ['4'] = KEY(HID_KEY_4),
+    ['5'] = KEY(HID_KEY_5), ['6'] = KEY(HID_KEY_6), ['7'] = KEY(HID_KEY_7), ['8'] = KEY(HID_KEY_8),
+    ['9'] = KEY(HID_KEY_9), ['0'] = KEY(HID_KEY_0),
+    ['!'] = SFT(HID_KEY_1), ['"'] = SFT(HID_KEY_2), ['#'] = SFT(HID_KEY_3), ['$'] = SFT(HID_KEY_4),
+    ['%'] = SFT(HID_KEY_5), ['&'] = SFT(HID_KEY_6), ['/'] = SFT(HID_KEY_7), ['('] = SFT(HID_KEY_8),
+    [')'] = SFT(HID_KEY_9), ['='] = SFT(HID_KEY_0),
+    ['\''] = KEY(HID_KEY_MINUS), ['?'] = SFT(HID_KEY_MINUS), ['\\'] = AGR(HID_KEY_MINUS),
+    ['@'] = AGR(HID_KEY_Q), ['|'] = KEY(HID_KEY_GRV_ACCENT),
+    ['+'] = KEY(HID_KEY_RIGHT_BRKT), ['*'] = SFT(HID_KEY_RIGHT_BRKT), ['~'] = AGR(HID_KEY_RIGHT_BRKT),
+    ['{'] = KEY(HID_KEY_SGL_QUOTE), ['['] = SFT(HID_KEY_SGL_QUOTE), ['^'] = DEAD(HID_KEY_SGL_QUOTE),
+    ['}'] = KEY(HID_KEY_BACK_SLASH), [']'] = SFT(HID_KEY_BACK_SLASH), ['`'] = DEAD(HID_KEY_BACK_SLASH),
+    ['<'] = KEY(HID_KEY_NON_US_BSLASH), ['>'] = SFT(HID_KEY_NON_US_BSLASH),
+    [','] = KEY(HID_KEY_COMMA), [';'] = SFT(HID_KEY_COMMA), ['.'] = KEY(HID_KEY_DOT), [':'] = SFT(HID_KEY_DOT),
+    ['-'] = KEY(HID_KEY_FWD_SLASH), ['_'] = SFT(HID_KEY_FWD_SLASH),
+};
 
-/*************************hid_dev**************************/
+static const hid_extra_char_t layout_latam_extra[] = {
+    {0x00F1, KEY(HID_KEY_SEMI_COLON)},    /* ñ */
+    {0x00D1, SFT(HID_KEY_SEMI_COLON)},    /* Ñ */
+    {0x00BF, KEY(HID_KEY_EQUAL)},         /* ¿ */
+    {0x00A1, SFT(HID_KEY_EQUAL)},         /* ¡ */
+    {0x00B0, SFT(HID_KEY_GRV_ACCENT)},    /* ° */
+    {0x00AC, AGR(HID_KEY_GRV_ACCENT)},    /* ¬ */
+};
 
+static const hid_layout_table_t layouts[] = {
+    [BLE_HID_LAYOUT_US] = {layout_us, NULL, 0},
+    [BLE_HID_LAYOUT_LATAM] = {layout_latam, layout_latam_extra, sizeof(layout_latam_extra) / sizeof(hid_extra_char_t)},
+};
 
-/*************************hidd_le**************************/
-// HID Report Map characteristic value
+/*==================[external data definition]===============================*/
+// HID Report Map characteristic value, the same for both hosts
 // Keyboard report descriptor (using format for Boot interface descriptor)
-static const uint8_t hidReportMap[] = {
+const uint8_t ble_hid_report_map[] = {
     0x05, 0x01,  // Usage Page (Generic Desktop)
     0x09, 0x02,  // Usage (Mouse)
     0xA1, 0x01,  // Collection (Application)
@@ -645,727 +311,247 @@ static const uint8_t hidReportMap[] = {
     0xC0,            // End Collectionq
 };
 // HID report map length
-uint8_t hidReportMapLen = sizeof(hidReportMap);
-uint8_t hidProtocolMode = HID_PROTOCOL_MODE_REPORT;
-// HID Information characteristic value
-static const uint8_t hidInfo[HID_INFORMATION_LEN] = {
-    LO_UINT16(0x0111), HI_UINT16(0x0111),             // bcdHID (USB HID version)
-    0x00,                                             // bCountryCode
-    HID_KBD_FLAGS                                     // Flags
-};
-// HID External Report Reference Descriptor
-static uint16_t hidExtReportRefDesc = ESP_GATT_UUID_BATTERY_LEVEL;
-// HID Report Reference characteristic descriptor, mouse input
-static uint8_t hidReportRefMouseIn[HID_REPORT_REF_LEN] =
-             { HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT };
-// HID Report Reference characteristic descriptor, key input
-static uint8_t hidReportRefKeyIn[HID_REPORT_REF_LEN] =
-             { HID_RPT_ID_KEY_IN, HID_REPORT_TYPE_INPUT };
-// HID Report Reference characteristic descriptor, LED output
-static uint8_t hidReportRefLedOut[HID_REPORT_REF_LEN] =
-             { HID_RPT_ID_LED_OUT, HID_REPORT_TYPE_OUTPUT };
-// HID Report Reference characteristic descriptor, Feature
-static uint8_t hidReportRefFeature[HID_REPORT_REF_LEN] =
-             { HID_RPT_ID_FEATURE, HID_REPORT_TYPE_FEATURE };
-// HID Report Reference characteristic descriptor, consumer control input
-static uint8_t hidReportRefCCIn[HID_REPORT_REF_LEN] =
-             { HID_RPT_ID_CC_IN, HID_REPORT_TYPE_INPUT };
-/// hid Service uuid
-static uint16_t hid_le_svc = ATT_SVC_HID;
-uint16_t            hid_count = 0;
-esp_gatts_incl_svc_desc_t incl_svc = {0};
-///the uuid definition
-static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
-static const uint16_t include_service_uuid = ESP_GATT_UUID_INCLUDE_SERVICE;
-static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
-static const uint16_t character_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
-static const uint16_t hid_info_char_uuid = ESP_GATT_UUID_HID_INFORMATION;
-static const uint16_t hid_report_map_uuid    = ESP_GATT_UUID_HID_REPORT_MAP;
-static const uint16_t hid_control_point_uuid = ESP_GATT_UUID_HID_CONTROL_POINT;
-static const uint16_t hid_report_uuid = ESP_GATT_UUID_HID_REPORT;
-static const uint16_t hid_proto_mode_uuid = ESP_GATT_UUID_HID_PROTO_MODE;
-static const uint16_t hid_kb_input_uuid = ESP_GATT_UUID_HID_BT_KB_INPUT;
-static const uint16_t hid_kb_output_uuid = ESP_GATT_UUID_HID_BT_KB_OUTPUT;
-static const uint16_t hid_mouse_input_uuid = ESP_GATT_UUID_HID_BT_MOUSE_INPUT;
-static const uint16_t hid_repot_map_ext_desc_uuid = ESP_GATT_UUID_EXT_RPT_REF_DESCR;
-static const uint16_t hid_report_ref_descr_uuid = ESP_GATT_UUID_RPT_REF_DESCR;
-///the propoty definition
-//static const uint8_t char_prop_notify = ESP_GATT_CHAR_PROP_BIT_NOTIFY;
-static const uint8_t char_prop_read = ESP_GATT_CHAR_PROP_BIT_READ;
-static const uint8_t char_prop_write_nr = ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
-static const uint8_t char_prop_read_write = ESP_GATT_CHAR_PROP_BIT_WRITE|ESP_GATT_CHAR_PROP_BIT_READ;
-static const uint8_t char_prop_read_notify = ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_NOTIFY;
-//static const uint8_t char_prop_read_write_notify = ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_WRITE|ESP_GATT_CHAR_PROP_BIT_NOTIFY;
-static const uint8_t char_prop_read_write_write_nr = ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_WRITE|ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
-/// battary Service
-static const uint16_t battary_svc = ESP_GATT_UUID_BATTERY_SERVICE_SVC;
-static const uint16_t bat_lev_uuid = ESP_GATT_UUID_BATTERY_LEVEL;
-static const uint8_t   bat_lev_ccc[2] ={ 0x00, 0x00};
-static const uint16_t char_format_uuid = ESP_GATT_UUID_CHAR_PRESENT_FORMAT;
-static uint8_t battary_lev = 50;
-/// Full HRS Database Description - Used to add attributes into the database
-static const esp_gatts_attr_db_t bas_att_db[BAS_IDX_NB] = {
-    // Battary Service Declaration
-    [BAS_IDX_SVC]               =  {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&primary_service_uuid, ESP_GATT_PERM_READ,
-                                            sizeof(uint16_t), sizeof(battary_svc), (uint8_t *)&battary_svc}},
-
-    // Battary level Characteristic Declaration
-    [BAS_IDX_BATT_LVL_CHAR]    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
-                                                   CHAR_DECLARATION_SIZE,CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_notify}},
-
-    // Battary level Characteristic Value
-    [BAS_IDX_BATT_LVL_VAL]             	= {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&bat_lev_uuid, ESP_GATT_PERM_READ,
-                                                                sizeof(uint8_t),sizeof(uint8_t), &battary_lev}},
-
-    // Battary level Characteristic - Client Characteristic Configuration Descriptor
-    [BAS_IDX_BATT_LVL_NTF_CFG]     	=  {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-                                                          sizeof(uint16_t),sizeof(bat_lev_ccc), (uint8_t *)bat_lev_ccc}},
-
-    // Battary level report Characteristic Declaration
-    [BAS_IDX_BATT_LVL_PRES_FMT]  = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&char_format_uuid, ESP_GATT_PERM_READ,
-                                                        sizeof(struct prf_char_pres_fmt), 0, NULL}},
-};
-/// Full Hid device Database Description - Used to add attributes into the database
-static esp_gatts_attr_db_t hidd_le_gatt_db[HIDD_LE_IDX_NB] = {
-            // HID Service Declaration
-    [HIDD_LE_IDX_SVC]                       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&primary_service_uuid,
-                                                             ESP_GATT_PERM_READ_ENCRYPTED, sizeof(uint16_t), sizeof(hid_le_svc),
-                                                            (uint8_t *)&hid_le_svc}},
-
-    // HID Service Declaration
-    [HIDD_LE_IDX_INCL_SVC]               = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&include_service_uuid,
-                                                            ESP_GATT_PERM_READ,
-                                                            sizeof(esp_gatts_incl_svc_desc_t), sizeof(esp_gatts_incl_svc_desc_t),
-                                                            (uint8_t *)&incl_svc}},
-
-    // HID Information Characteristic Declaration
-    [HIDD_LE_IDX_HID_INFO_CHAR]     = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                            ESP_GATT_PERM_READ,
-                                                            CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                            (uint8_t *)&char_prop_read}},
-    // HID Information Characteristic Value
-    [HIDD_LE_IDX_HID_INFO_VAL]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_info_char_uuid,
-                                                            ESP_GATT_PERM_READ,
-                                                            sizeof(hids_hid_info_t), sizeof(hidInfo),
-                                                            (uint8_t *)&hidInfo}},
-
-    // HID Control Point Characteristic Declaration
-    [HIDD_LE_IDX_HID_CTNL_PT_CHAR]  = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                              ESP_GATT_PERM_READ,
-                                                              CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                              (uint8_t *)&char_prop_write_nr}},
-    // HID Control Point Characteristic Value
-    [HIDD_LE_IDX_HID_CTNL_PT_VAL]    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_control_point_uuid,
-                                                             ESP_GATT_PERM_WRITE,
-                                                             sizeof(uint8_t), 0,
-                                                             NULL}},
-
-    // Report Map Characteristic Declaration
-    [HIDD_LE_IDX_REPORT_MAP_CHAR]   = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                              ESP_GATT_PERM_READ,
-                                                              CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                              (uint8_t *)&char_prop_read}},
-    // Report Map Characteristic Value
-    [HIDD_LE_IDX_REPORT_MAP_VAL]     = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_map_uuid,
-                                                              ESP_GATT_PERM_READ,
-                                                              HIDD_LE_REPORT_MAP_MAX_LEN, sizeof(hidReportMap),
-                                                              (uint8_t *)&hidReportMap}},
-
-    // Report Map Characteristic - External Report Reference Descriptor
-    [HIDD_LE_IDX_REPORT_MAP_EXT_REP_REF]  = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_repot_map_ext_desc_uuid,
-                                                                        ESP_GATT_PERM_READ,
-                                                                        sizeof(uint16_t), sizeof(uint16_t),
-                                                                        (uint8_t *)&hidExtReportRefDesc}},
-
-    // Protocol Mode Characteristic Declaration
-    [HIDD_LE_IDX_PROTO_MODE_CHAR]            = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                        ESP_GATT_PERM_READ,
-                                                                        CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                        (uint8_t *)&char_prop_read_write}},
-    // Protocol Mode Characteristic Value
-    [HIDD_LE_IDX_PROTO_MODE_VAL]               = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_proto_mode_uuid,
-                                                                        (ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE),
-                                                                        sizeof(uint8_t), sizeof(hidProtocolMode),
-                                                                        (uint8_t *)&hidProtocolMode}},
-
-    [HIDD_LE_IDX_REPORT_MOUSE_IN_CHAR]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                         ESP_GATT_PERM_READ,
-                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                         (uint8_t *)&char_prop_read_notify}},
-
-    [HIDD_LE_IDX_REPORT_MOUSE_IN_VAL]        = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
-                                                                       NULL}},
-
-    [HIDD_LE_IDX_REPORT_MOUSE_IN_CCC]        = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
-                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
-                                                                      sizeof(uint16_t), 0,
-                                                                      NULL}},
-
-    [HIDD_LE_IDX_REPORT_MOUSE_REP_REF]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       sizeof(hidReportRefMouseIn), sizeof(hidReportRefMouseIn),
-                                                                       hidReportRefMouseIn}},
-    // Report Characteristic Declaration
-    [HIDD_LE_IDX_REPORT_KEY_IN_CHAR]         = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                         ESP_GATT_PERM_READ,
-                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                         (uint8_t *)&char_prop_read_notify}},
-    // Report Characteristic Value
-    [HIDD_LE_IDX_REPORT_KEY_IN_VAL]            = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
-                                                                       NULL}},
-    // Report KEY INPUT Characteristic - Client Characteristic Configuration Descriptor
-    [HIDD_LE_IDX_REPORT_KEY_IN_CCC]              = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
-                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
-                                                                      sizeof(uint16_t), 0,
-                                                                      NULL}},
-     // Report Characteristic - Report Reference Descriptor
-    [HIDD_LE_IDX_REPORT_KEY_IN_REP_REF]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       sizeof(hidReportRefKeyIn), sizeof(hidReportRefKeyIn),
-                                                                       hidReportRefKeyIn}},
-     // Report Characteristic Declaration
-    [HIDD_LE_IDX_REPORT_LED_OUT_CHAR]         = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                         ESP_GATT_PERM_READ,
-                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                         (uint8_t *)&char_prop_read_write_write_nr}},
-    [HIDD_LE_IDX_REPORT_LED_OUT_VAL]            = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
-                                                                       ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
-                                                                       NULL}},
-    [HIDD_LE_IDX_REPORT_LED_OUT_REP_REF]      =  {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       sizeof(hidReportRefLedOut), sizeof(hidReportRefLedOut),
-                                                                       hidReportRefLedOut}},
-    // Report Characteristic Declaration
-    [HIDD_LE_IDX_REPORT_CC_IN_CHAR]         = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                         ESP_GATT_PERM_READ,
-                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                         (uint8_t *)&char_prop_read_notify}},
-    // Report Characteristic Value
-    [HIDD_LE_IDX_REPORT_CC_IN_VAL]            = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
-                                                                       NULL}},
-    // Report KEY INPUT Characteristic - Client Characteristic Configuration Descriptor
-    [HIDD_LE_IDX_REPORT_CC_IN_CCC]              = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
-                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE_ENCRYPTED),
-                                                                      sizeof(uint16_t), 0,
-                                                                      NULL}},
-     // Report Characteristic - Report Reference Descriptor
-    [HIDD_LE_IDX_REPORT_CC_IN_REP_REF]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       sizeof(hidReportRefCCIn), sizeof(hidReportRefCCIn),
-                                                                       hidReportRefCCIn}},
-    // Boot Keyboard Input Report Characteristic Declaration
-    [HIDD_LE_IDX_BOOT_KB_IN_REPORT_CHAR] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                        ESP_GATT_PERM_READ,
-                                                                        CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                        (uint8_t *)&char_prop_read_notify}},
-    // Boot Keyboard Input Report Characteristic Value
-    [HIDD_LE_IDX_BOOT_KB_IN_REPORT_VAL]   = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_kb_input_uuid,
-                                                                        ESP_GATT_PERM_READ,
-                                                                        HIDD_LE_BOOT_REPORT_MAX_LEN, 0,
-                                                                        NULL}},
-    // Boot Keyboard Input Report Characteristic - Client Characteristic Configuration Descriptor
-    [HIDD_LE_IDX_BOOT_KB_IN_REPORT_NTF_CFG]  = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
-                                                                              (ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE),
-                                                                              sizeof(uint16_t), 0,
-                                                                              NULL}},
-    // Boot Keyboard Output Report Characteristic Declaration
-    [HIDD_LE_IDX_BOOT_KB_OUT_REPORT_CHAR]    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                              ESP_GATT_PERM_READ,
-                                                                              CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                              (uint8_t *)&char_prop_read_write}},
-    // Boot Keyboard Output Report Characteristic Value
-    [HIDD_LE_IDX_BOOT_KB_OUT_REPORT_VAL]      = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_kb_output_uuid,
-                                                                              (ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE),
-                                                                              HIDD_LE_BOOT_REPORT_MAX_LEN, 0,
-                                                                              NULL}},
-    // Boot Mouse Input Report Characteristic Declaration
-    [HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_CHAR] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                              ESP_GATT_PERM_READ,
-                                                                              CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                              (uint8_t *)&char_prop_read_notify}},
-    // Boot Mouse Input Report Characteristic Value
-    [HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_VAL]   = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_mouse_input_uuid,
-                                                                              ESP_GATT_PERM_READ,
-                                                                              HIDD_LE_BOOT_REPORT_MAX_LEN, 0,
-                                                                              NULL}},
-    // Boot Mouse Input Report Characteristic - Client Characteristic Configuration Descriptor
-    [HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_NTF_CFG]    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
-                                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
-                                                                                      sizeof(uint16_t), 0,
-                                                                                      NULL}},
-
-    // Report Characteristic Declaration
-    [HIDD_LE_IDX_REPORT_CHAR]                    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
-                                                                         ESP_GATT_PERM_READ,
-                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
-                                                                         (uint8_t *)&char_prop_read_write}},
-    // Report Characteristic Value
-    [HIDD_LE_IDX_REPORT_VAL]                      = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
-                                                                       NULL}},
-    // Report Characteristic - Report Reference Descriptor
-    [HIDD_LE_IDX_REPORT_REP_REF]               = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
-                                                                       ESP_GATT_PERM_READ,
-                                                                       sizeof(hidReportRefFeature), sizeof(hidReportRefFeature),
-                                                                       hidReportRefFeature}},
-};
-
-/***************************hidd****************************/
-static uint8_t hidd_service_uuid128[] = {
-    /* LSB <--------------------------------------------------------------------------------> MSB */
-    //first uuid, 16bit, [12],[13] is the value
-    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x12, 0x18, 0x00, 0x00,
-};
-static esp_ble_adv_data_t hidd_adv_data = {
-    .set_scan_rsp = false,
-    .include_name = true,
-    .include_txpower = true,
-    .min_interval = 0x0006, //slave connection min interval, Time = min_interval * 1.25 msec
-    .max_interval = 0x0010, //slave connection max interval, Time = max_interval * 1.25 msec
-    .appearance = 0x03c0,       //HID Generic,
-    .manufacturer_len = 0,
-    .p_manufacturer_data =  NULL,
-    .service_data_len = 0,
-    .p_service_data = NULL,
-    .service_uuid_len = sizeof(hidd_service_uuid128),
-    .p_service_uuid = hidd_service_uuid128,
-    .flag = 0x6,
-};
-static esp_ble_adv_params_t hidd_adv_params = {
-    .adv_int_min        = 0x20,
-    .adv_int_max        = 0x30,
-    .adv_type           = ADV_TYPE_IND,
-    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
-    //.peer_addr            =
-    //.peer_addr_type       =
-    .channel_map        = ADV_CHNL_ALL,
-    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-};
-static uint16_t hid_conn_id = 0;
-static bool sec_conn = false;
-ble_status_t status = BLE_OFF;
-
-/*==================[external data definition]===============================*/
-/********************esp_hidd_prf_api**********************/
-
-
-/*************************hid_dev**************************/
-
-
-/*************************hidd_le**************************/
-
-/***************************hidd****************************/
+const uint16_t ble_hid_report_map_len = sizeof(ble_hid_report_map);
 
 /*==================[internal functions definition]==========================*/
-/********************esp_hidd_prf_api**********************/
-/**
- * @brief 
- */
-esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks){
-    esp_err_t hidd_status;
-    if(callbacks != NULL) {
-   	    hidd_le_env.hidd_cb = callbacks;
-    } else {
-        return ESP_FAIL;
+static int32_t clamp(int32_t value, int32_t limit) {
+    if(value > limit){
+        return limit;
     }
-    if((hidd_status = hidd_register_cb()) != ESP_OK) {
-        return hidd_status;
+    if(value < -limit){
+        return -limit;
     }
-    esp_ble_gatts_app_register(BATTRAY_APP_ID);
-    if((hidd_status = esp_ble_gatts_app_register(HIDD_APP_ID)) != ESP_OK) {
-        return hidd_status;
-    }
-    return hidd_status;
+    return value;
 }
-/**
- * @brief 
- */
-esp_err_t esp_hidd_profile_init(void){
-     if (hidd_le_env.enabled) {
-        ESP_LOGE(TAG, "HID device profile already initialized");
-        return ESP_FAIL;
+
+/* Buttons field of the mouse report (bit 0: left, 1: right, 2: middle) */
+static uint8_t button_mask(mouse_cmd_t mouse_button) {
+    switch(mouse_button){
+        case HID_MOUSE_LEFT:
+            return 0x01;
+        case HID_MOUSE_RIGHT:
+            return 0x02;
+        case HID_MOUSE_MIDDLE:
+            return 0x04;
+        default:
+            return 0x00;
     }
-    // Reset the hid device target environment
-    memset(&hidd_le_env, 0, sizeof(hidd_le_env_t));
-    hidd_le_env.enabled = true;
-    return ESP_OK;
 }
-/**
- * @brief 
- */
-esp_err_t esp_hidd_profile_deinit(void){
-    uint16_t hidd_svc_hdl = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_SVC];
-    if (!hidd_le_env.enabled) {
-        ESP_LOGE(TAG, "HID device profile already initialized");
-        return ESP_OK;
+
+static void count_report(void) {
+    int64_t now_us = esp_timer_get_time();
+    rate_reports++;
+    if(now_us - rate_start_us >= HID_RATE_WINDOW_US){
+        report_rate = (uint16_t)((int64_t)rate_reports * 1000000 / (now_us - rate_start_us));
+        rate_reports = 0;
+        rate_start_us = now_us;
     }
-    if(hidd_svc_hdl != 0) {
-	esp_ble_gatts_stop_service(hidd_svc_hdl);
-	esp_ble_gatts_delete_service(hidd_svc_hdl);
-    } else {
-	return ESP_FAIL;
-   }
-    /* register the HID device profile to the BTA_GATTS module*/
-    esp_ble_gatts_app_unregister(hidd_le_env.gatt_if);
-    return ESP_OK;
-}
-/**
- * @brief 
- */
-uint16_t esp_hidd_get_version(void){
-	return HIDD_VERSION;
 }
 
-/*************************hid_dev**************************/
-static hid_report_map_t *hid_dev_rpt_by_id(uint8_t id, uint8_t type){
-    hid_report_map_t *rpt = hid_dev_rpt_tbl;
+static bool mouse_pending(void) {
+    return (button_head != button_tail) || (acc_x != 0) || (acc_y != 0) || (acc_wheel != 0);
+}
 
-    for (uint8_t i = hid_dev_rpt_tbl_Len; i > 0; i--, rpt++) {
-        if (rpt->id == id && rpt->type == type && rpt->mode == hidProtocolMode) {
-            return rpt;
+/* Sends the pending mouse motion and button changes, returns true if anything was sent */
+static bool send_mouse(void) {
+    uint8_t buffer[HID_MOUSE_IN_RPT_LEN] = {0};
+    int32_t dx, dy, wheel;
+    bool button_change, sent = false;
+    for(uint8_t i = 0; i < HID_MOUSE_BURST; i++){
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        if(!mouse_pending()){
+            xSemaphoreGive(report_mutex);
+            break;
         }
+        button_change = (button_head != button_tail);
+        buffer[0] = button_change ? button_queue[button_tail & (HID_BUTTON_QUEUE - 1)] : buttons;
+        dx = clamp(acc_x, HID_DELTA_MAX);
+        dy = clamp(acc_y, HID_DELTA_MAX);
+        wheel = clamp(acc_wheel, HID_DELTA_MAX);
+        xSemaphoreGive(report_mutex);
+        buffer[1] = (int8_t)dx;
+        buffer[2] = (int8_t)dy;
+        buffer[3] = (int8_t)wheel;
+        if(!BleHidPortSendInput(HID_RPT_ID_MOUSE_IN, buffer, HID_MOUSE_IN_RPT_LEN)){
+            /* stack buffers full: everything stays accumulated for the next interval */
+            break;
+        }
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        acc_x -= dx;
+        acc_y -= dy;
+        acc_wheel -= wheel;
+        if(button_change){
+            buttons = buffer[0];
+            button_tail++;
+        }
+        xSemaphoreGive(report_mutex);
+        count_report();
+        sent = true;
     }
-    return NULL;
+    return sent;
 }
-void hid_dev_register_reports(uint8_t num_reports, hid_report_map_t *p_report){
-    hid_dev_rpt_tbl = p_report;
-    hid_dev_rpt_tbl_Len = num_reports;
-    return;
+
+static bool keys_pending(void) {
+    return (key_head != key_tail) || (keys_down_qty > 0);
 }
-void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
-                                    uint8_t id, uint8_t type, uint8_t length, uint8_t *data){
-    hid_report_map_t *p_rpt;
-    // get att handle for report
-    if ((p_rpt = hid_dev_rpt_by_id(id, type)) != NULL) {
-        // if notifications are enabled
-        ESP_LOGD(TAG, "%s(), send the report, handle = %d", __func__, p_rpt->handle);
-        esp_ble_gatts_send_indicate(gatts_if, conn_id, p_rpt->handle, length, data, false);
+
+static bool key_in(uint8_t key, const uint8_t *keys, uint8_t qty) {
+    for(uint8_t i = 0; i < qty; i++){
+        if(keys[i] == key){
+            return true;
+        }
     }
-    return;
+    return false;
 }
 
-/*************************hidd_le**************************/
-void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-									esp_ble_gatts_cb_param_t *param){
-    switch(event) {
-        case ESP_GATTS_REG_EVT: {
-            esp_ble_gap_config_local_icon (ESP_BLE_APPEARANCE_GENERIC_HID);
-            esp_hidd_cb_param_t hidd_param;
-            hidd_param.init_finish.state = param->reg.status;
-            if(param->reg.app_id == HIDD_APP_ID) {
-                hidd_le_env.gatt_if = gatts_if;
-                if(hidd_le_env.hidd_cb != NULL) {
-                    (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_REG_FINISH, &hidd_param);
-                    hidd_le_create_service(hidd_le_env.gatt_if);
-                }
-            }
-            if(param->reg.app_id == BATTRAY_APP_ID) {
-                hidd_param.init_finish.gatts_if = gatts_if;
-                 if(hidd_le_env.hidd_cb != NULL) {
-                    (hidd_le_env.hidd_cb)(ESP_BAT_EVENT_REG, &hidd_param);
-                }
-
-            }
-
+/* Sends the queued keystrokes, packed in reports of up to typing_keys keys with the
+ * same modifiers. A key still pressed in the previous report needs a release report
+ * first, and so does the end of the text. Returns true if anything was sent. */
+static bool send_keys(void) {
+    uint8_t buffer[HID_KEYBOARD_IN_RPT_LEN];
+    hid_keystroke_t stroke;
+    uint8_t qty;
+    size_t taken;
+    bool sent = false;
+    for(uint8_t i = 0; i < HID_KEY_BURST; i++){
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        if(!keys_pending()){
+            xSemaphoreGive(report_mutex);
             break;
         }
-        case ESP_GATTS_CONF_EVT: {
-            break;
-        }
-        case ESP_GATTS_CREATE_EVT:
-            break;
-        case ESP_GATTS_CONNECT_EVT: {
-            esp_hidd_cb_param_t cb_param = {0};
-			ESP_LOGI(TAG, "HID connection establish, conn_id = %x",param->connect.conn_id);
-			memcpy(cb_param.connect.remote_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
-            cb_param.connect.conn_id = param->connect.conn_id;
-            hidd_clcb_alloc(param->connect.conn_id, param->connect.remote_bda);
-            esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM);
-            if(hidd_le_env.hidd_cb != NULL) {
-                (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_CONNECT, &cb_param);
+        memset(buffer, 0, sizeof(buffer));
+        qty = 0;
+        for(taken = 0; (key_tail + taken != key_head) && (qty < typing_keys); taken++){
+            stroke = key_queue[(key_tail + taken) & (HID_KEY_QUEUE - 1)];
+            if(((qty > 0) && (stroke.mods != buffer[0])) || key_in(stroke.key, &buffer[2], qty) ||
+                key_in(stroke.key, keys_down, keys_down_qty)){
+                break;
             }
-            break;
+            buffer[0] = stroke.mods;
+            buffer[2 + qty++] = stroke.key;
         }
-        case ESP_GATTS_DISCONNECT_EVT: {
-			 if(hidd_le_env.hidd_cb != NULL) {
-                    (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_DISCONNECT, NULL);
-             }
-            hidd_clcb_dealloc(param->disconnect.conn_id);
+        xSemaphoreGive(report_mutex);
+        if(!BleHidPortSendInput(HID_RPT_ID_KEY_IN, buffer, HID_KEYBOARD_IN_RPT_LEN)){
+            /* stack buffers full: the same keys are packed again in the next interval */
             break;
         }
-        case ESP_GATTS_CLOSE_EVT:
-            break;
-        case ESP_GATTS_WRITE_EVT: {
-            esp_hidd_cb_param_t cb_param = {0};
-            if (param->write.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_LED_OUT_VAL]) {
-                cb_param.led_write.conn_id = param->write.conn_id;
-                cb_param.led_write.report_id = HID_RPT_ID_LED_OUT;
-                cb_param.led_write.length = param->write.len;
-                cb_param.led_write.data = param->write.value;
-                (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT, &cb_param);
-            }
-            break;
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        key_tail += taken;
+        memcpy(keys_down, &buffer[2], qty);
+        keys_down_qty = qty;
+        xSemaphoreGive(report_mutex);
+        if(taken > 0){
+            xSemaphoreGive(key_space);
         }
-        case ESP_GATTS_CREAT_ATTR_TAB_EVT: {
-            if (param->add_attr_tab.num_handle == BAS_IDX_NB &&
-                param->add_attr_tab.svc_uuid.uuid.uuid16 == ESP_GATT_UUID_BATTERY_SERVICE_SVC &&
-                param->add_attr_tab.status == ESP_GATT_OK) {
-                incl_svc.start_hdl = param->add_attr_tab.handles[BAS_IDX_SVC];
-                incl_svc.end_hdl = incl_svc.start_hdl + BAS_IDX_NB -1;
-                ESP_LOGI(TAG, "%s(), start added the hid service to the stack database. incl_handle = %d",
-                           __func__, incl_svc.start_hdl);
-                esp_ble_gatts_create_attr_tab(hidd_le_gatt_db, gatts_if, HIDD_LE_IDX_NB, 0);
-            }
-            if (param->add_attr_tab.num_handle == HIDD_LE_IDX_NB &&
-                param->add_attr_tab.status == ESP_GATT_OK) {
-                memcpy(hidd_le_env.hidd_inst.att_tbl, param->add_attr_tab.handles,
-                            HIDD_LE_IDX_NB*sizeof(uint16_t));
-                ESP_LOGI(TAG, "hid svc handle = %x",hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_SVC]);
-                hid_add_id_tbl();
-		        esp_ble_gatts_start_service(hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_SVC]);
-            } else {
-                esp_ble_gatts_start_service(param->add_attr_tab.handles[0]);
-            }
-            break;
-         }
-        default:
-            break;
+        count_report();
+        sent = true;
     }
+    return sent;
 }
-void hidd_le_create_service(esp_gatt_if_t gatts_if){
-    /* Here should added the battery service first, because the hid service should include the battery service.
-       After finish to added the battery service then can added the hid service. */
-    esp_ble_gatts_create_attr_tab(bas_att_db, gatts_if, BAS_IDX_NB, 0);
 
-}
-void hidd_le_init(void){
-    // Reset the hid device target environment
-    memset(&hidd_le_env, 0, sizeof(hidd_le_env_t));
-}
-void hidd_clcb_alloc (uint16_t conn_id, esp_bd_addr_t bda){
-    uint8_t                   i_clcb = 0;
-    hidd_clcb_t      *p_clcb = NULL;
-    for (i_clcb = 0, p_clcb= hidd_le_env.hidd_clcb; i_clcb < HID_MAX_APPS; i_clcb++, p_clcb++) {
-        if (!p_clcb->in_use) {
-            p_clcb->in_use      = true;
-            p_clcb->conn_id     = conn_id;
-            p_clcb->connected   = true;
-            memcpy (p_clcb->remote_bda, bda, ESP_BD_ADDR_LEN);
-            break;
+/* Looks up the next character of text in the layout, returns the bytes it takes */
+static uint8_t decode_char(const char *text, const hid_layout_table_t *layout, hid_keystroke_t *stroke) {
+    const uint8_t *utf8 = (const uint8_t *)text;
+    uint16_t code;
+    stroke->key = 0;
+    if(utf8[0] < 0x80){
+        *stroke = layout->ascii[utf8[0]];
+        return 1;
+    }
+    /* 2 bytes UTF-8 sequences cover the Latin-1 characters of the national keys */
+    if(((utf8[0] & 0xE0) == 0xC0) && ((utf8[1] & 0xC0) == 0x80)){
+        code = ((utf8[0] & 0x1F) << 6) | (utf8[1] & 0x3F);
+        for(uint8_t i = 0; i < layout->extra_qty; i++){
+            if(layout->extra[i].code == code){
+                *stroke = layout->extra[i].stroke;
+                break;
+            }
         }
+        return 2;
     }
-    return;
+    /* other sequences are skipped whole */
+    for(code = 1; (utf8[code] & 0xC0) == 0x80; code++);
+    return code;
 }
-bool hidd_clcb_dealloc (uint16_t conn_id){
-    uint8_t              i_clcb = 0;
-    hidd_clcb_t      *p_clcb = NULL;
-    for (i_clcb = 0, p_clcb= hidd_le_env.hidd_clcb; i_clcb < HID_MAX_APPS; i_clcb++, p_clcb++) {
-            memset(p_clcb, 0, sizeof(hidd_clcb_t));
-            return true;
-    }
-    return false;
+
+static void report_timer_cb(void * arg) {
+    xTaskNotifyGive(report_task_handle);
 }
-static struct gatts_profile_inst heart_rate_profile_tab[PROFILE_NUM] = {
-    [PROFILE_APP_IDX] = {
-        .gatts_cb = esp_hidd_prf_cb_hdl,
-        .gatts_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
-    },
-};
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param){
-    /* If event is register event, store the gatts_if for each profile */
-    if (event == ESP_GATTS_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            heart_rate_profile_tab[PROFILE_APP_IDX].gatts_if = gatts_if;
-        } else {
-            ESP_LOGI(TAG, "Reg app failed, app_id %04x, status %d\n",
-                    param->reg.app_id,
-                    param->reg.status);
-            return;
+
+/* Sends at most one burst per connection interval. The timer only runs while there
+ * is traffic: after an idle interval it stops, and the next input is sent at once. */
+static void report_task(void * arg) {
+    bool sent, pending;
+    while(1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sent = false;
+        if(status == BLE_CONNECTED){
+            sent = send_mouse();
+            sent |= send_keys();
         }
-    }
-    do {
-        int idx;
-        for (idx = 0; idx < PROFILE_NUM; idx++) {
-            if (gatts_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
-                    gatts_if == heart_rate_profile_tab[idx].gatts_if) {
-                if (heart_rate_profile_tab[idx].gatts_cb) {
-                    heart_rate_profile_tab[idx].gatts_cb(event, gatts_if, param);
-                }
-            }
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        pending = mouse_pending() || keys_pending();
+        if((sent || pending) && !pacing){
+            /* also when the stack was busy: retry in the next interval */
+            pacing = true;
+            esp_timer_start_periodic(report_timer, conn_interval * 1250);
+        }else if(!sent && !pending && pacing){
+            pacing = false;
+            esp_timer_stop(report_timer);
         }
-    } while (0);
-}
-esp_err_t hidd_register_cb(void){
-	esp_err_t status;
-	status = esp_ble_gatts_register_callback(gatts_event_handler);
-	return status;
-}
-void hidd_set_attr_value(uint16_t handle, uint16_t val_len, const uint8_t *value){
-    hidd_inst_t *hidd_inst = &hidd_le_env.hidd_inst;
-    if(hidd_inst->att_tbl[HIDD_LE_IDX_HID_INFO_VAL] <= handle &&
-        hidd_inst->att_tbl[HIDD_LE_IDX_REPORT_REP_REF] >= handle) {
-        esp_ble_gatts_set_attr_value(handle, val_len, value);
-    } else {
-        ESP_LOGE(TAG, "%s error:Invalid handle value.",__func__);
+        xSemaphoreGive(report_mutex);
     }
-    return;
 }
-void hidd_get_attr_value(uint16_t handle, uint16_t *length, uint8_t **value){
-    hidd_inst_t *hidd_inst = &hidd_le_env.hidd_inst;
-    if(hidd_inst->att_tbl[HIDD_LE_IDX_HID_INFO_VAL] <= handle &&
-        hidd_inst->att_tbl[HIDD_LE_IDX_REPORT_REP_REF] >= handle){
-        esp_ble_gatts_get_attr_value(handle, length, (const uint8_t **)value);
-    } else {
-        ESP_LOGE(TAG, "%s error:Invalid handle value.", __func__);
+
+/* Wakes the report task now, unless it's paced by the timer */
+static void request_report(void) {
+    if(!pacing){
+        xTaskNotifyGive(report_task_handle);
     }
-    return;
 }
-static void hid_add_id_tbl(void){
-    // Mouse input report
-    hid_rpt_map[0].id = hidReportRefMouseIn[0];
-    hid_rpt_map[0].type = hidReportRefMouseIn[1];
-    hid_rpt_map[0].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_MOUSE_IN_VAL];
-    hid_rpt_map[0].cccdHandle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_MOUSE_IN_VAL];
-    hid_rpt_map[0].mode = HID_PROTOCOL_MODE_REPORT;
-    // Key input report
-    hid_rpt_map[1].id = hidReportRefKeyIn[0];
-    hid_rpt_map[1].type = hidReportRefKeyIn[1];
-    hid_rpt_map[1].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_KEY_IN_VAL];
-    hid_rpt_map[1].cccdHandle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_KEY_IN_CCC];
-    hid_rpt_map[1].mode = HID_PROTOCOL_MODE_REPORT;
-    // Consumer Control input report
-    hid_rpt_map[2].id = hidReportRefCCIn[0];
-    hid_rpt_map[2].type = hidReportRefCCIn[1];
-    hid_rpt_map[2].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_CC_IN_VAL];
-    hid_rpt_map[2].cccdHandle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_CC_IN_CCC];
-    hid_rpt_map[2].mode = HID_PROTOCOL_MODE_REPORT;
-    // LED output report
-    hid_rpt_map[3].id = hidReportRefLedOut[0];
-    hid_rpt_map[3].type = hidReportRefLedOut[1];
-    hid_rpt_map[3].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_LED_OUT_VAL];
-    hid_rpt_map[3].cccdHandle = 0;
-    hid_rpt_map[3].mode = HID_PROTOCOL_MODE_REPORT;
-    // Boot keyboard input report
-    // Use same ID and type as key input report
-    hid_rpt_map[4].id = hidReportRefKeyIn[0];
-    hid_rpt_map[4].type = hidReportRefKeyIn[1];
-    hid_rpt_map[4].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_BOOT_KB_IN_REPORT_VAL];
-    hid_rpt_map[4].cccdHandle = 0;
-    hid_rpt_map[4].mode = HID_PROTOCOL_MODE_BOOT;
-    // Boot keyboard output report
-    // Use same ID and type as LED output report
-    hid_rpt_map[5].id = hidReportRefLedOut[0];
-    hid_rpt_map[5].type = hidReportRefLedOut[1];
-    hid_rpt_map[5].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_BOOT_KB_OUT_REPORT_VAL];
-    hid_rpt_map[5].cccdHandle = 0;
-    hid_rpt_map[5].mode = HID_PROTOCOL_MODE_BOOT;
-    // Boot mouse input report
-    // Use same ID and type as mouse input report
-    hid_rpt_map[6].id = hidReportRefMouseIn[0];
-    hid_rpt_map[6].type = hidReportRefMouseIn[1];
-    hid_rpt_map[6].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_BOOT_MOUSE_IN_REPORT_VAL];
-    hid_rpt_map[6].cccdHandle = 0;
-    hid_rpt_map[6].mode = HID_PROTOCOL_MODE_BOOT;
-    // Feature report
-    hid_rpt_map[7].id = hidReportRefFeature[0];
-    hid_rpt_map[7].type = hidReportRefFeature[1];
-    hid_rpt_map[7].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_VAL];
-    hid_rpt_map[7].cccdHandle = 0;
-    hid_rpt_map[7].mode = HID_PROTOCOL_MODE_REPORT;
-    // Setup report ID map
-    hid_dev_register_reports(HID_NUM_REPORTS, hid_rpt_map);
+
+/*==================[stack events]===========================================*/
+void BleHidOnAdvertising(void){
+    if(status == BLE_OFF){
+        ESP_LOGI(TAG, "Advertising %lld us after BleHidInit", (long long)(esp_timer_get_time() - init_start_us));
+    }
+    status = BLE_DISCONNECTED;
 }
 
-/***************************hidd****************************/
-static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param){
-    switch(event) {
-        case ESP_HIDD_EVENT_REG_FINISH: {
-            if (param->init_finish.state == ESP_HIDD_INIT_OK) {
-                //esp_bd_addr_t rand_addr = {0x04,0x11,0x11,0x11,0x11,0x05};
-                esp_ble_gap_set_device_name(device_name);
-                esp_ble_gap_config_adv_data(&hidd_adv_data);
+void BleHidOnSecured(void){
+    status = BLE_CONNECTED;
+}
 
-            }
-            break;
-        }
-        case ESP_BAT_EVENT_REG: {
-            break;
-        }
-        case ESP_HIDD_EVENT_DEINIT_FINISH:
-	     break;
-		case ESP_HIDD_EVENT_BLE_CONNECT: {
-            ESP_LOGI(TAG, "ESP_HIDD_EVENT_BLE_CONNECT");
-            hid_conn_id = param->connect.conn_id;
-            break;
-        }
-        case ESP_HIDD_EVENT_BLE_DISCONNECT: {
-            status = BLE_DISCONNECTED;
-            sec_conn = false;
-            ESP_LOGI(TAG, "ESP_HIDD_EVENT_BLE_DISCONNECT");
-            status = BLE_DISCONNECTED;
-            esp_ble_gap_start_advertising(&hidd_adv_params);
-            break;
-        }
-        case ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT: {
-            ESP_LOGI(TAG, "%s, ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT", __func__);
-            ESP_LOG_BUFFER_HEX(TAG, param->vendor_write.data, param->vendor_write.length);
-            break;
-        }
-        case ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT: {
-            ESP_LOGI(TAG, "ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT");
-            ESP_LOG_BUFFER_HEX(TAG, param->led_write.data, param->led_write.length);
-            break;
-        }
-        default:
-            break;
-    }
-    return;
+void BleHidOnDisconnect(void){
+    status = BLE_DISCONNECTED;
+    conn_interval = HID_DEFAULT_INTERVAL;
+    /* nothing pending is sent to the next host */
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+    acc_x = acc_y = acc_wheel = 0;
+    button_tail = button_head;
+    buttons = last_buttons = 0;
+    key_tail = key_head;
+    keys_down_qty = 0;
+    xSemaphoreGive(report_mutex);
+    /* a BleHidTypeString waiting for space sees the link is down */
+    xSemaphoreGive(key_space);
 }
 
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param){
-    switch (event) {
-    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-        status = BLE_DISCONNECTED;
-        esp_ble_gap_start_advertising(&hidd_adv_params);
-        break;
-     case ESP_GAP_BLE_SEC_REQ_EVT:
-        for(int i = 0; i < ESP_BD_ADDR_LEN; i++) {
-             ESP_LOGD(TAG, "%x:",param->ble_security.ble_req.bd_addr[i]);
-        }
-        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
-	 break;
-     case ESP_GAP_BLE_AUTH_CMPL_EVT:
-        status = BLE_CONNECTED;
-        sec_conn = true;
-        esp_bd_addr_t bd_addr;
-        memcpy(bd_addr, param->ble_security.auth_cmpl.bd_addr, sizeof(esp_bd_addr_t));
-        ESP_LOGI(TAG, "remote BD_ADDR: %08x%04x",\
-                (bd_addr[0] << 24) + (bd_addr[1] << 16) + (bd_addr[2] << 8) + bd_addr[3],
-                (bd_addr[4] << 8) + bd_addr[5]);
-        ESP_LOGI(TAG, "address type = %d", param->ble_security.auth_cmpl.addr_type);
-        ESP_LOGI(TAG, "pair status = %s",param->ble_security.auth_cmpl.success ? "success" : "fail");
-        if(!param->ble_security.auth_cmpl.success) {
-            ESP_LOGE(TAG, "fail reason = 0x%x",param->ble_security.auth_cmpl.fail_reason);
-        }
-        break;
-    default:
-        break;
+void BleHidOnConnInterval(uint16_t interval){
+    conn_interval = interval;
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+    if(pacing){
+        esp_timer_stop(report_timer);
+        esp_timer_start_periodic(report_timer, conn_interval * 1250);
     }
+    xSemaphoreGive(report_mutex);
 }
 
 /*==================[external functions definition]==========================*/
 void BleHidInit(char * hid_dev_name){
     esp_err_t ret;
-    device_name = hid_dev_name;
+    size_t free_heap;
+    init_start_us = esp_timer_get_time();
     // Initialize NVS.
     ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -1373,45 +559,25 @@ void BleHidInit(char * hid_dev_name){
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK( ret );
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "%s initialize controller failed\n", __func__);
-        return;
-    }
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(TAG, "%s enable controller failed\n", __func__);
-        return;
-    }
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(TAG, "%s init bluedroid failed\n", __func__);
-        return;
-    }
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(TAG, "%s init bluedroid failed\n", __func__);
+    report_mutex = xSemaphoreCreateMutex();
+    configASSERT(report_mutex);
+    type_mutex = xSemaphoreCreateMutex();
+    configASSERT(type_mutex);
+    key_space = xSemaphoreCreateBinary();
+    configASSERT(key_space);
+    const esp_timer_create_args_t report_timer_args = {
+        .callback = &report_timer_cb,
+        .name = "hid_report"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&report_timer_args, &report_timer));
+    xTaskCreate(report_task, "hid_report", 1024*3, NULL, 10, &report_task_handle);
+    /* controller + host cost, see documentación/bluetooth.md */
+    free_heap = esp_get_free_heap_size();
+    if(!BleHidPortInit(hid_dev_name)){
         return;
     }
-    if((ret = esp_hidd_profile_init()) != ESP_OK) {
-        ESP_LOGE(TAG, "%s init bluedroid failed\n", __func__);
-    }
-    ///register the callback function to the gap module
-    esp_ble_gap_register_callback(gap_event_handler);
-    esp_hidd_register_callbacks(hidd_event_callback);
-    /* set the security iocap & auth_req & key size & init key response key parameters to the stack*/
-    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_BOND;     //bonding with peer device after authentication
-    esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;           //set the IO capability to No output No input
-    uint8_t key_size = 16;      //the key size should be 7~16 bytes
-    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
-    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
-    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
-    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
-    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+    ESP_LOGI(TAG, "Host started in %lld us, %d bytes of heap", (long long)(esp_timer_get_time() - init_start_us),
+        (int)(free_heap - esp_get_free_heap_size()));
 }
 
 ble_status_t BleHidStatus(void){
@@ -1429,29 +595,100 @@ void BleHidSendKeyboard(key_mask_t special_key_mask, keyboard_cmd_t *keyboard_cm
         for (int i = 0; i < num_key; i++) {
             buffer[i+2] = keyboard_cmd[i];
         }
-        hid_dev_send_report(hidd_le_env.gatt_if, hid_conn_id,
-                            HID_RPT_ID_KEY_IN, HID_REPORT_TYPE_INPUT, HID_KEYBOARD_IN_RPT_LEN, buffer);
+        BleHidPortSendInput(HID_RPT_ID_KEY_IN, buffer, HID_KEYBOARD_IN_RPT_LEN);
         for (int i = 0; i < num_key; i++) {
             buffer[i+2] = 0;
         }
-        hid_dev_send_report(hidd_le_env.gatt_if, hid_conn_id,
-                            HID_RPT_ID_KEY_IN, HID_REPORT_TYPE_INPUT, HID_KEYBOARD_IN_RPT_LEN, buffer);
+        BleHidPortSendInput(HID_RPT_ID_KEY_IN, buffer, HID_KEYBOARD_IN_RPT_LEN);
     }
     return;
 }
 
 void BleHidSendMouse(mouse_cmd_t mouse_button, int8_t delta_x, int8_t delta_y){
-    uint8_t buffer[HID_MOUSE_IN_RPT_LEN];
-    buffer[0] = mouse_button;       // Buttons
-    buffer[1] = delta_x;            // X
-    buffer[2] = delta_y;            // Y
-    buffer[3] = 0;                  // Wheel
-    buffer[4] = 0;                  // AC Pan
-    if(status == BLE_CONNECTED){
-        hid_dev_send_report(hidd_le_env.gatt_if, hid_conn_id,
-                            HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT, HID_MOUSE_IN_RPT_LEN, buffer);
+    BleHidMouseButton(mouse_button);
+    BleHidMouseMove(delta_x, delta_y, 0);
+}
+
+void BleHidMouseMove(int16_t delta_x, int16_t delta_y, int8_t wheel){
+    if((status != BLE_CONNECTED) || ((delta_x == 0) && (delta_y == 0) && (wheel == 0))){
+        return;
     }
-    return;
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+    acc_x = clamp(acc_x + delta_x, HID_ACC_MAX);
+    acc_y = clamp(acc_y + delta_y, HID_ACC_MAX);
+    acc_wheel = clamp(acc_wheel + wheel, HID_ACC_MAX);
+    request_report();
+    xSemaphoreGive(report_mutex);
+}
+
+void BleHidMouseButton(mouse_cmd_t mouse_button){
+    uint8_t mask = button_mask(mouse_button);
+    if((status != BLE_CONNECTED) || (mask == last_buttons)){
+        return;
+    }
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+    /* every change gets its own report, so a fast click isn't merged away */
+    if((uint8_t)(button_head - button_tail) < HID_BUTTON_QUEUE){
+        button_queue[button_head & (HID_BUTTON_QUEUE - 1)] = mask;
+        button_head++;
+        last_buttons = mask;
+    }
+    request_report();
+    xSemaphoreGive(report_mutex);
+}
+
+uint16_t BleHidGetReportRate(void){
+    /* no reports for a whole window: the rate dropped to 0 */
+    if(esp_timer_get_time() - rate_start_us >= 2 * HID_RATE_WINDOW_US){
+        return 0;
+    }
+    return report_rate;
 }
 
-/*==================[end of file]============================================*/
\ No newline at end of file
+size_t BleHidTypeString(const char *text, ble_hid_layout_t layout){
+    const hid_layout_table_t *table;
+    hid_keystroke_t stroke;
+    size_t queued = 0;
+    uint8_t strokes;
+    if((text == NULL) || (layout >= sizeof(layouts) / sizeof(layouts[0]))){
+        return 0;
+    }
+    table = &layouts[layout];
+    xSemaphoreTake(type_mutex, portMAX_DELAY);
+    while((*text != '\0') && (status == BLE_CONNECTED)){
+        text += decode_char(text, table, &stroke);
+        if(stroke.key == 0){
+            continue;
+        }
+        strokes = (stroke.mods & HID_DEAD_KEY) ? 2 : 1;
+        while((HID_KEY_QUEUE - (key_head - key_tail) < strokes) && (status == BLE_CONNECTED)){
+            xSemaphoreTake(key_space, pdMS_TO_TICKS(HID_KEY_WAIT_MS));
+        }
+        xSemaphoreTake(report_mutex, portMAX_DELAY);
+        if(status == BLE_CONNECTED){
+            key_queue[key_head++ & (HID_KEY_QUEUE - 1)] = (hid_keystroke_t){stroke.key, stroke.mods & ~HID_DEAD_KEY};
+            if(strokes == 2){
+                key_queue[key_head++ & (HID_KEY_QUEUE - 1)] = (hid_keystroke_t)KEY(HID_KEY_SPACEBAR);
+            }
+            queued++;
+            request_report();
+        }
+        xSemaphoreGive(report_mutex);
+    }
+    xSemaphoreGive(type_mutex);
+    return queued;
+}
+
+void BleHidSetTypingKeys(uint8_t keys){
+    if((keys == 0) || (keys > HID_KEY_SLOTS)){
+        return;
+    }
+    xSemaphoreTake(report_mutex, portMAX_DELAY);
+    typing_keys = keys;
+    xSemaphoreGive(report_mutex);
+}
+
+size_t BleHidTypePending(void){
+    return key_head - key_tail;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,388 @@
+/**
+ * @file ble_hid_mcu_nimble.c
+ * @brief NimBLE HID over GATT service of the BLE HID driver (see ble_hid_mcu_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_hid_mcu_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_hid"
+#define UUID_HID_SERVICE			0x1812
+#define UUID_HID_INFORMATION		0x2A4A
+#define UUID_HID_REPORT_MAP			0x2A4B
+#define UUID_HID_CONTROL_POINT		0x2A4C
+#define UUID_HID_REPORT				0x2A4D
+#define UUID_HID_PROTO_MODE			0x2A4E
+#define UUID_RPT_REF_DESCR			0x2908
+#define UUID_BATTERY_SERVICE		0x180F
+#define UUID_BATTERY_LEVEL			0x2A19
+#define HID_APPEARANCE				0x03C0		/* Generic HID */
+#define HID_PROTOCOL_MODE_REPORT	0x01
+#define HID_REPORT_TYPE_INPUT		1
+#define HID_REPORT_TYPE_OUTPUT		2
+#define HID_REPORT_REF_LEN			2
+#define HID_FLAGS_REMOTE_WAKE		0x01
+/*==================[typedef]================================================*/
+
+/*==================[internal data declaration]==============================*/
+static const char * device_name;						/* Device name */
+static uint8_t own_addr_type;
+static uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE;	/* Connection with the host */
+static uint16_t mouse_in_handle;						/* Value handles, filled by ble_gatts_add_svcs */
+static uint16_t key_in_handle;
+static uint16_t cc_in_handle;
+static uint8_t protocol_mode = HID_PROTOCOL_MODE_REPORT;
+static uint8_t battery_level = 50;
+
+/*==================[internal functions declaration]=========================*/
+static int hid_access_cb(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+void ble_store_config_init(void);
+/*==================[internal data definition]===============================*/
+// HID Information characteristic value
+static const uint8_t hid_info[] = {
+	0x11, 0x01,				// bcdHID (USB HID version 1.11)
+	0x00,					// bCountryCode
+	HID_FLAGS_REMOTE_WAKE	// Flags
+};
+// HID Report Reference descriptors: report ID and type
+static const uint8_t report_ref_mouse_in[HID_REPORT_REF_LEN] = {HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT};
+static const uint8_t report_ref_key_in[HID_REPORT_REF_LEN] = {HID_RPT_ID_KEY_IN, HID_REPORT_TYPE_INPUT};
+static const uint8_t report_ref_led_out[HID_REPORT_REF_LEN] = {HID_RPT_ID_LED_OUT, HID_REPORT_TYPE_OUTPUT};
+static const uint8_t report_ref_cc_in[HID_REPORT_REF_LEN] = {HID_RPT_ID_CC_IN, HID_REPORT_TYPE_INPUT};
+static const ble_uuid16_t adv_uuids[] = {BLE_UUID16_INIT(UUID_HID_SERVICE)};
+/* GATT database: same reports than the Bluedroid service, without the boot protocol ones */
+static const struct ble_gatt_svc_def gatt_svcs[] = {
+	{
+		.type = BLE_GATT_SVC_TYPE_PRIMARY,
+		.uuid = BLE_UUID16_DECLARE(UUID_BATTERY_SERVICE),
+		.characteristics = (struct ble_gatt_chr_def[]) {
+			{
+				.uuid = BLE_UUID16_DECLARE(UUID_BATTERY_LEVEL),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+			}, {
+				0,		/* No more characteristics */
+			}
+		},
+	}, {
+		.type = BLE_GATT_SVC_TYPE_PRIMARY,
+		.uuid = BLE_UUID16_DECLARE(UUID_HID_SERVICE),
+		.characteristics = (struct ble_gatt_chr_def[]) {
+			{
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_INFORMATION),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ,
+			}, {
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_REPORT_MAP),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC,
+			}, {
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_CONTROL_POINT),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_WRITE_NO_RSP,
+			}, {
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_PROTO_MODE),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE_NO_RSP,
+			}, {
+				/* mouse input report */
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_REPORT),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC | BLE_GATT_CHR_F_NOTIFY,
+				.val_handle = &mouse_in_handle,
+				.descriptors = (struct ble_gatt_dsc_def[]) {
+					{
+						.uuid = BLE_UUID16_DECLARE(UUID_RPT_REF_DESCR),
+						.att_flags = BLE_ATT_F_READ,
+						.access_cb = hid_access_cb,
+						.arg = (void *)report_ref_mouse_in,
+					}, {
+						0,
+					}
+				},
+			}, {
+				/* keyboard input report */
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_REPORT),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC | BLE_GATT_CHR_F_NOTIFY,
+				.val_handle = &key_in_handle,
+				.descriptors = (struct ble_gatt_dsc_def[]) {
+					{
+						.uuid = BLE_UUID16_DECLARE(UUID_RPT_REF_DESCR),
+						.att_flags = BLE_ATT_F_READ,
+						.access_cb = hid_access_cb,
+						.arg = (void *)report_ref_key_in,
+					}, {
+						0,
+					}
+				},
+			}, {
+				/* keyboard LEDs output report */
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_REPORT),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_WRITE_ENC,
+				.descriptors = (struct ble_gatt_dsc_def[]) {
+					{
+						.uuid = BLE_UUID16_DECLARE(UUID_RPT_REF_DESCR),
+						.att_flags = BLE_ATT_F_READ,
+						.access_cb = hid_access_cb,
+						.arg = (void *)report_ref_led_out,
+					}, {
+						0,
+					}
+				},
+			}, {
+				/* consumer control input report */
+				.uuid = BLE_UUID16_DECLARE(UUID_HID_REPORT),
+				.access_cb = hid_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC | BLE_GATT_CHR_F_NOTIFY,
+				.val_handle = &cc_in_handle,
+				.descriptors = (struct ble_gatt_dsc_def[]) {
+					{
+						.uuid = BLE_UUID16_DECLARE(UUID_RPT_REF_DESCR),
+						.att_flags = BLE_ATT_F_READ,
+						.access_cb = hid_access_cb,
+						.arg = (void *)report_ref_cc_in,
+					}, {
+						0,
+					}
+				},
+			}, {
+				0,		/* No more characteristics */
+			}
+		},
+	}, {
+		0,				/* No more services */
+	},
+};
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static int hid_access_cb(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+	int rc = 0;
+	switch(ctxt->op){
+		case BLE_GATT_ACCESS_OP_READ_DSC:
+			/* report reference descriptors carry their value in arg */
+			rc = os_mbuf_append(ctxt->om, arg, HID_REPORT_REF_LEN);
+			break;
+		case BLE_GATT_ACCESS_OP_READ_CHR:
+			switch(ble_uuid_u16(ctxt->chr->uuid)){
+				case UUID_HID_INFORMATION:
+					rc = os_mbuf_append(ctxt->om, hid_info, sizeof(hid_info));
+					break;
+				case UUID_HID_REPORT_MAP:
+					rc = os_mbuf_append(ctxt->om, ble_hid_report_map, ble_hid_report_map_len);
+					break;
+				case UUID_HID_PROTO_MODE:
+					rc = os_mbuf_append(ctxt->om, &protocol_mode, sizeof(protocol_mode));
+					break;
+				case UUID_BATTERY_LEVEL:
+					rc = os_mbuf_append(ctxt->om, &battery_level, sizeof(battery_level));
+					break;
+				default:
+					/* reports are notified, reads get an empty value */
+					break;
+			}
+			break;
+		case BLE_GATT_ACCESS_OP_WRITE_CHR:
+			switch(ble_uuid_u16(ctxt->chr->uuid)){
+				case UUID_HID_PROTO_MODE:
+					ble_hs_mbuf_to_flat(ctxt->om, &protocol_mode, sizeof(protocol_mode), NULL);
+					break;
+				case UUID_HID_REPORT:
+					ESP_LOGI(TAG, "LED report write");
+					break;
+				default:
+					/* control point: suspend / exit suspend, nothing to do */
+					break;
+			}
+			break;
+		default:
+			return BLE_ATT_ERR_UNLIKELY;
+	}
+	return (rc == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static void advertise(void) {
+	struct ble_hs_adv_fields fields;
+	struct ble_gap_adv_params adv_params;
+	int rc;
+
+	memset(&fields, 0, sizeof(fields));
+	fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+	fields.tx_pwr_lvl_is_present = 1;
+	fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+	fields.appearance = HID_APPEARANCE;
+	fields.appearance_is_present = 1;
+	fields.uuids16 = adv_uuids;
+	fields.num_uuids16 = 1;
+	fields.uuids16_is_complete = 1;
+	rc = ble_gap_adv_set_fields(&fields);
+	if(rc != 0){
+		ESP_LOGE(TAG, "config adv data failed, error code = %d", rc);
+		return;
+	}
+	memset(&fields, 0, sizeof(fields));
+	fields.name = (const uint8_t *)device_name;
+	fields.name_len = strlen(device_name);
+	fields.name_is_complete = 1;
+	rc = ble_gap_adv_rsp_set_fields(&fields);
+	if(rc != 0){
+		ESP_LOGE(TAG, "config scan response failed, error code = %d", rc);
+		return;
+	}
+	memset(&adv_params, 0, sizeof(adv_params));
+	adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+	adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+	adv_params.itvl_min = 0x20;
+	adv_params.itvl_max = 0x30;
+	rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, gap_event_handler, NULL);
+	if(rc != 0){
+		ESP_LOGE(TAG, "advertising start failed, error code = %d", rc);
+	}
+}
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg) {
+	struct ble_gap_conn_desc desc;
+	switch(event->type){
+		case BLE_GAP_EVENT_CONNECT:
+			if(event->connect.status != 0){
+				advertise();
+				break;
+			}
+			ESP_LOGI(TAG, "HID connection establish, conn_handle = %x", event->connect.conn_handle);
+			conn_handle = event->connect.conn_handle;
+			if(ble_gap_conn_find(conn_handle, &desc) == 0){
+				BleHidOnConnInterval(desc.conn_itvl);
+			}
+			ble_gap_security_initiate(conn_handle);
+			break;
+		case BLE_GAP_EVENT_DISCONNECT:
+			ESP_LOGI(TAG, "HID disconnected");
+			conn_handle = BLE_HS_CONN_HANDLE_NONE;
+			BleHidOnDisconnect();
+			advertise();
+			break;
+		case BLE_GAP_EVENT_ADV_COMPLETE:
+			advertise();
+			break;
+		case BLE_GAP_EVENT_ENC_CHANGE:
+			ESP_LOGI(TAG, "pair status = %s", (event->enc_change.status == 0) ? "success" : "fail");
+			if(event->enc_change.status == 0){
+				BleHidOnSecured();
+			}
+			break;
+		case BLE_GAP_EVENT_CONN_UPDATE:
+			if((event->conn_update.status == 0) && (ble_gap_conn_find(event->conn_update.conn_handle, &desc) == 0)){
+				ESP_LOGI(TAG, "connection interval = %d x 1.25 ms", desc.conn_itvl);
+				BleHidOnConnInterval(desc.conn_itvl);
+			}
+			break;
+		case BLE_GAP_EVENT_REPEAT_PAIRING:
+			/* the host lost its keys: forget the old bond and pair again */
+			if(ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0){
+				ble_store_util_delete_peer(&desc.peer_id_addr);
+			}
+			return BLE_GAP_REPEAT_PAIRING_RETRY;
+		default:
+			break;
+	}
+	return 0;
+}
+
+static void on_reset(int reason) {
+	ESP_LOGE(TAG, "Host reset, reason = %d", reason);
+}
+
+static void on_sync(void) {
+	ble_hs_util_ensure_addr(0);
+	ble_hs_id_infer_auto(0, &own_addr_type);
+	advertise();
+	BleHidOnAdvertising();
+}
+
+static void host_task(void *param) {
+	/* returns only when the host is stopped */
+	nimble_port_run();
+	nimble_port_freertos_deinit();
+}
+
+/*==================[external functions definition]==========================*/
+bool BleHidPortInit(const char * hid_dev_name){
+	esp_err_t ret;
+	int rc;
+	device_name = hid_dev_name;
+	/* initializes the controller too */
+	ret = nimble_port_init();
+	if (ret) {
+		ESP_LOGE(TAG, "%s init nimble failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ble_hs_cfg.reset_cb = on_reset;
+	ble_hs_cfg.sync_cb = on_sync;
+	ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+	/* same security than the Bluedroid service: bonding, no IO */
+	ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO;
+	ble_hs_cfg.sm_bonding = 1;
+	ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+	ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+
+	ble_svc_gap_init();
+	ble_svc_gatt_init();
+	rc = ble_gatts_count_cfg(gatt_svcs);
+	if(rc == 0){
+		rc = ble_gatts_add_svcs(gatt_svcs);
+	}
+	if(rc != 0){
+		ESP_LOGE(TAG, "gatts register error, error code = %d", rc);
+		return false;
+	}
+	ble_svc_gap_device_name_set(hid_dev_name);
+	ble_svc_gap_device_appearance_set(HID_APPEARANCE);
+	/* bonding keys in NVS */
+	ble_store_config_init();
+	nimble_port_freertos_init(host_task);
+	return true;
+}
+
+bool BleHidPortSendInput(uint8_t report_id, const uint8_t *data, uint8_t length){
+	struct os_mbuf *om;
+	uint16_t handle;
+	switch(report_id){
+		case HID_RPT_ID_MOUSE_IN:
+			handle = mouse_in_handle;
+			break;
+		case HID_RPT_ID_KEY_IN:
+			handle = key_in_handle;
+			break;
+		case HID_RPT_ID_CC_IN:
+			handle = cc_in_handle;
+			break;
+		default:
+			return false;
+	}
+	om = ble_hs_mbuf_from_flat(data, length);
+	if(om == NULL){
+		return false;
+	}
+	/* the stack frees om, also on error */
+	return ble_gatts_notify_custom(conn_handle, handle, om) == 0;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,55 @@
+#ifndef BLE_HID_MCU_PORT_H
+#define BLE_HID_MCU_PORT_H
+/**
+ * @file ble_hid_mcu_port.h
+ * @brief Internal interface between the ble_hid_mcu core and the Bluetooth host stack.
+ *
+ * ble_hid_mcu.c (report map, report building and public API) doesn't depend on the
+ * host stack. The HID over GATT service lives in ble_hid_mcu_bluedroid.c or in
+ * ble_hid_mcu_nimble.c, only one of them is compiled.
+ *
+ * Not part of the driver API, applications must use ble_hid_mcu.h.
+ *
+ * @version 0.1
+ * @date 19/10/2026
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_hid_mcu.h"
+#include <stdint.h>
+#include <stdbool.h>
+/*==================[macros]=================================================*/
+/* Report IDs, as declared in the report map */
+#define HID_RPT_ID_MOUSE_IN      			1   // Mouse input report ID
+#define HID_RPT_ID_KEY_IN        			2   // Keyboard input report ID
+#define HID_RPT_ID_CC_IN         			3   //Consumer Control input report ID
+#define HID_RPT_ID_VENDOR_OUT    			4   // Vendor output report ID
+#define HID_RPT_ID_LED_OUT       			2  // LED output report ID
+#define HID_RPT_ID_FEATURE       			0  // Feature report ID
+// HID keyboard input report length
+#define HID_KEYBOARD_IN_RPT_LEN     		8
+// HID LED output report length
+#define HID_LED_OUT_RPT_LEN         		1
+// HID mouse input report length
+#define HID_MOUSE_IN_RPT_LEN        		5
+// HID consumer control input report length
+#define HID_CC_IN_RPT_LEN           		2
+/*==================[external data declaration]==============================*/
+extern const uint8_t ble_hid_report_map[];		/* HID report descriptor, served by both hosts */
+extern const uint16_t ble_hid_report_map_len;
+/*==================[external functions declaration]=========================*/
+/* Implemented by the backend */
+bool BleHidPortInit(const char *device_name);
+bool BleHidPortSendInput(uint8_t report_id, const uint8_t *data, uint8_t length);
+
+/* Implemented by the core, called from the stack context */
+void BleHidOnAdvertising(void);
+void BleHidOnSecured(void);
+void BleHidOnDisconnect(void);
+void BleHidOnConnInterval(uint16_t interval);	/* x 1.25 ms, on connection and on every update */
+
+#endif /* BLE_HID_MCU_PORT_H */
+/*==================[end of file]============================================*/
@@ -11,556 +11,661 @@
 
 /*==================[inclusions]=============================================*/
 #include "ble_mcu.h"
+#include "ble_mcu_port.h"
 #include <stdint.h>
 #include <string.h>
 
 #include "nvs_flash.h"
 
 #include "esp_log.h"
-
-#include "esp_bt.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_bt_defs.h"
-#include "esp_bt_main.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 /*==================[macros and definitions]=================================*/
 #define TAG "ble_mcu"
-#define MTU_MAX_BYTES		20	 /* GATT Maximum Transmission Unit */
-#define PAYLOAD_SIZE        128  /* Maximun number of bytes transmitted in one transaction */
-#define SPP_PROFILE_NUM     1       
-#define SPP_PROFILE_APP_IDX 0
-#define ESP_SPP_APP_ID      0x56
-#define SPP_SVC_INST_ID     0
-#define SPP_DATA_MAX_LEN    (128) /* Maximun number of bytes transmitted in one transaction */
-/* List of attributes to be added to the service database */
-enum{
-    SPP_IDX_SVC,
-    SPP_IDX_SPP_DATA_RECV_NOTIFY_CHAR,
-    SPP_IDX_SPP_DATA_NOTIFY_VAL,
-    SPP_IDX_SPP_DATA_NOTIFY_CFG,
-    SPP_IDX_SPP_DATA_RECV_VAL,
-    SPP_IDX_SPP_DATA_RECV_CFG,
-    SPP_IDX_NB,
-};
-/* Characteristics UUID */
-#define ESP_GATT_UUID_SPP_SERVICE               0xFFE0  /* Service ID */
-#define ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY   0xFFE1  /* Characteristic ID */
-
-#define ADV_CONFIG_FLAG			                (1 << 0)
-#define SCAN_RSP_CONFIG_FLAG	                (1 << 1)
+#define BLE_CONGEST_WAIT_MS	100	 /* Maximum wait for an uncongest event before checking the link again */
+#define BLE_SEND_RETRIES	3	 /* Notification attempts before a segment is dropped */
+#define RX_RING_SIZE		2048 /* Bytes of received writes waiting for the read task (power of 2) */
+#define TX_RING_MASK		(BLE_TX_BUFFER_SIZE - 1)
+#define TX_MARKS_QTY		32	 /* Time stamps of pending writes kept for latency and deadlines (power of 2) */
+#define STREAM_RING_SIZE	2048 /* Bytes of stream packets waiting for transmission (power of 2) */
+#define STREAM_RING_MASK	(STREAM_RING_SIZE - 1)
+#define STREAM_LEN_SIZE		2	 /* Each packet is stored in the ring preceded by its length */
 /*==================[typedef]================================================*/
-/* Commands for handling Bluetooth events */
-typedef enum {
-    CMD_BLUETOOTH_CONNECT,       /* bt connection */
-    CMD_BLUETOOTH_AUTH,          /* device authentification */
-    CMD_BLUETOOTH_DATA,          /* data reception */
-    CMD_BLUETOOTH_DISCONNECT,    /* device disconnection */
-    CMD_SEND_DATA,               /* data transmission */
-} comd_bt_ev_t;
-/* Struct used to handle Bluetooth events */
+/** @brief State of one connection */
 typedef struct {
-	uint16_t spp_conn_id;
-	esp_gatt_if_t spp_gatts_if;
-	uint16_t command;
-	size_t length;
-	uint8_t payload[PAYLOAD_SIZE];
-	TaskHandle_t taskHandle;
-} CMD_t;
+	bool link_up;								/* A central is connected (maybe not secured yet) */
+	bool secured;
+	volatile bool congested;					/* Stack TX buffers full, stop sending to it until uncongest */
+	bool subscribed[2];							/* CCCD of each ble_port_char_t */
+	uint16_t mtu;								/* ATT MTU negotiated with the central */
+	ble_conn_params_t params;					/* Connection parameters in use */
+} ble_conn_t;
 /*==================[internal data declaration]==============================*/
-char * device_name; /* Device name */
-void (*ble_read_isr_p)(uint8_t * data, uint8_t length);  /* Pointer to callback function for reading data */
-ble_status_t status = BLE_OFF;
-static uint16_t spp_handle_table[SPP_IDX_NB];   /* Service database table */
-/* GATT profile struct */
-struct gatts_profile_inst {
-	esp_gatts_cb_t gatts_cb;
-	uint16_t gatts_if;
-	uint16_t app_id;
-	uint16_t conn_id;
-	uint16_t service_handle;
-	esp_gatt_srvc_id_t service_id;
-	uint16_t char_handle;
-	esp_bt_uuid_t char_uuid;
-	esp_gatt_perm_t perm;
-	esp_gatt_char_prop_t property;
-	uint16_t descr_handle;
-	esp_bt_uuid_t descr_uuid;
+static char * device_name; /* Device name */
+static read_func ble_read_isr_p = BLE_NO_INT;	/* Pointer to callback function for reading data */
+static read_long_func ble_read_long_p = NULL;	/* Callback for reading data of any length */
+static ble_status_t status = BLE_OFF;
+static ble_conn_t conns[BLE_MAX_CONN];
+static uint8_t links_qty = 0;					/* Connections up, secured or not */
+static uint16_t ble_mtu = BLE_MTU_DEFAULT;		/* Smallest ATT MTU of the secured connections, sizes the segments */
+static ble_stats_t ble_stats;					/* Counters since the first connection */
+static int64_t conn_start_us;					/* Connection time stamp, for the throughput */
+static int64_t init_start_us;					/* BleInit time stamp, for the start up time */
+static TaskHandle_t send_task_handle = NULL;
+static ble_conn_req_t conn_req;					/* Connection parameters requested by the application */
+static bool conn_req_set = false;				/* Parameters to request on every new connection */
+static conn_func conn_func_p = NULL;			/* Callback for connection parameters changes */
+/* TX ring buffer: producers copy once into it, the send task notifies straight from it.
+ * Indexes are free running, (head - tail) is the number of pending bytes. */
+static uint8_t tx_ring[BLE_TX_BUFFER_SIZE];
+static volatile size_t tx_head = 0;				/* Written by producers (under tx_mutex) */
+static volatile size_t tx_tail = 0;				/* Written by the send task only */
+static SemaphoreHandle_t tx_mutex = NULL;		/* Keeps messages from different tasks contiguous */
+static SemaphoreHandle_t tx_space = NULL;		/* Given by the send task every time it frees space */
+static uint8_t tx_bounce[BLE_MTU_REQUEST - BLE_ATT_HDR_SIZE];	/* Segments that wrap around the ring end */
+/* Time stamp of each BleSendBuffer call, to know how long the oldest pending byte has waited */
+static struct {
+	size_t pos;									/* Ring index of the first byte of the write */
+	int64_t time_us;							/* Time of the write */
+} tx_marks[TX_MARKS_QTY];
+static volatile uint8_t mark_head = 0;			/* Written by producers (under tx_mutex) */
+static volatile uint8_t mark_tail = 0;			/* Written by the send task only */
+static uint32_t coalesce_us = 0;				/* Coalescing deadline, 0: send as soon as possible */
+static esp_timer_handle_t flush_timer = NULL;	/* Wakes the send task when the deadline expires */
+static uint64_t latency_sum_us;					/* Accumulators for the average stats */
+static uint32_t latency_qty;
+static uint64_t capacity_sum;
+/* Stream packets ring: [length (2 bytes)][header][samples], one record per notification */
+static uint8_t stream_ring[STREAM_RING_SIZE];
+static volatile size_t stream_head = 0;			/* Written by producers (under stream_mutex) */
+static volatile size_t stream_tail = 0;			/* Written by the send task only */
+static SemaphoreHandle_t stream_mutex = NULL;
+static uint8_t stream_bounce[BLE_MTU_REQUEST - BLE_ATT_HDR_SIZE];
+static const uint8_t stream_sample_size[] = {
+	[BLE_STREAM_INT8] = 1, [BLE_STREAM_UINT8] = 1, [BLE_STREAM_INT16] = 2,
+	[BLE_STREAM_UINT16] = 2, [BLE_STREAM_INT32] = 4, [BLE_STREAM_FLOAT] = 4,
 };
-QueueHandle_t xQueueEvents = NULL;  /* Queue for handling Bluettoth events */
-QueueHandle_t xQueueRead = NULL;    /* Queue for handling received data */
+/* RX ring: [length (2 bytes)][data], one record per write (or executed long write) */
+static uint8_t rx_ring[RX_RING_SIZE];
+static volatile size_t rx_head = 0;				/* Written by the Bluetooth stack task only */
+static volatile size_t rx_tail = 0;				/* Written by the read task only */
+static TaskHandle_t read_task_handle = NULL;
+static uint8_t rx_buf[BLE_RX_MAX_LEN];			/* Records that wrap around the ring end */
 
 /*==================[internal functions declaration]=========================*/
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-										esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+
 /*==================[internal data definition]===============================*/
-static const uint16_t spp_service_uuid = ESP_GATT_UUID_SPP_SERVICE; /* Service ID */
-/* Advertising data */
-static const uint8_t spp_adv_data[23] = {
-	/* Flags */
-	0x02,0x01,0x06,
-	/* Complete List of 16-bit Service Class UUIDs */
-	0x03,0x03,0xF0,0xAB,
-	/* Complete Local Name in advertising */
-	0x0F,0x09, 'E', 'S', 'P', '_', 'E', 'D', 'U', '_', 'S', 'E', 'R','V', 'E', 'R'
-};
-/* Advertising parameters */
-static esp_ble_adv_params_t spp_adv_params = {
-	.adv_int_min		= 0x20,
-	.adv_int_max		= 0x40,
-	.adv_type			= ADV_TYPE_IND,
-	.own_addr_type		= BLE_ADDR_TYPE_PUBLIC,
-	.channel_map		= ADV_CHNL_ALL,
-	.adv_filter_policy	= ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-};
-/* Service UUID */
-static uint8_t sec_service_uuid[16] = {
-	/* LSB <--------------------------------------------------------------------------------> MSB */
-	//first uuid, 16bit, [12],[13] is the value
-	0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0xE0, 0xFF, 0x00, 0x00,
-};
-/* Config advertising data */
-static esp_ble_adv_data_t spp_adv_config = {
-	.set_scan_rsp = false,
-	.include_txpower = true,
-	.min_interval = 0x0006, //slave connection min interval, Time = min_interval * 1.25 msec
-	.max_interval = 0x0010, //slave connection max interval, Time = max_interval * 1.25 msec
-	.appearance = 0x00,
-	.manufacturer_len = 0, 
-	.p_manufacturer_data =	NULL,
-	.service_data_len = 0,
-	.p_service_data = NULL,
-	.service_uuid_len = sizeof(sec_service_uuid),
-	.p_service_uuid = sec_service_uuid,
-	.flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
-};
-/* config scan response data */
-static esp_ble_adv_data_t spp_scan_rsp_config = {
-	.set_scan_rsp = true,
-	.include_name = true,
-	.manufacturer_len = 0,
-	.p_manufacturer_data = NULL,
-};
-/* One gatt-based profile one app_id and one gatts_if, this array will store the gatts_if returned by ESP_GATTS_REG_EVT */
-static struct gatts_profile_inst spp_profile_tab[SPP_PROFILE_NUM] = {
-	[SPP_PROFILE_APP_IDX] = {
-		.gatts_cb = gatts_profile_event_handler,
-		.gatts_if = ESP_GATT_IF_NONE,		/* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
-	},
-};
-/* Service and characteristics id and values */
-static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
-static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
-static const uint16_t character_description_uuid = ESP_GATT_UUID_CHAR_DESCRIPTION;
-static const uint16_t character_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
-static const uint8_t char_prop_read_write = ESP_GATT_CHAR_PROP_BIT_WRITE_NR|ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_NOTIFY;;
-static const uint16_t spp_data_receive_uuid = ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY;
-static const uint8_t  spp_data_receive_val[20] = {0x00};
-static const uint16_t spp_data_notify_uuid = ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY;
-static const uint8_t  spp_data_notify_val[20] = {0x00};
-static const uint8_t  spp_data_notify_ccc[2] = {0x00, 0x00};
-/* Full HRS Database Description - Used to add attributes into the database */
-static const esp_gatts_attr_db_t spp_gatt_db[SPP_IDX_NB] = {
-	/* SPP -  Service Declaration */
-	[SPP_IDX_SVC]						=
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&primary_service_uuid, ESP_GATT_PERM_READ,
-	sizeof(spp_service_uuid), sizeof(spp_service_uuid), (uint8_t *)&spp_service_uuid}},
-
-	/* SPP -  data receive and notify characteristic Declaration */
-	[SPP_IDX_SPP_DATA_RECV_NOTIFY_CHAR]			=
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-	(sizeof(uint8_t)),(sizeof(uint8_t)), (uint8_t *)&char_prop_read_write}},
-
-	/* SPP -  data notify characteristic Value */
-	[SPP_IDX_SPP_DATA_NOTIFY_VAL]	=
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&spp_data_notify_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-	SPP_DATA_MAX_LEN, sizeof(spp_data_notify_val), (uint8_t *)spp_data_notify_val}},
-
-	/* SPP -  data notify characteristic - Client Characteristic Configuration Descriptor */
-	[SPP_IDX_SPP_DATA_NOTIFY_CFG]		  =
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-	sizeof(uint16_t),sizeof(spp_data_notify_ccc), (uint8_t *)spp_data_notify_ccc}},
-
-	/* SPP -  data receive characteristic Value */
-	[SPP_IDX_SPP_DATA_RECV_VAL]					=
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&spp_data_receive_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-	SPP_DATA_MAX_LEN,sizeof(spp_data_receive_val), (uint8_t *)spp_data_receive_val}},
-	
-	/* SPP -  data notify characteristic - Client Characteristic Configuration Descriptor */
-	[SPP_IDX_SPP_DATA_RECV_CFG]		  =
-	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_description_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
-	sizeof(uint16_t),sizeof(spp_data_notify_ccc), (uint8_t *)spp_data_notify_ccc}},
+/* Connection parameters of each profile (interval in 1.25 ms units, timeout in 10 ms units) */
+static const ble_conn_req_t conn_profiles[] = {
+	[BLE_CONN_LOW_LATENCY]	= {.min_int = 6,   .max_int = 6,   .latency = 0, .timeout = 400},	/* 7.5 ms */
+	[BLE_CONN_BALANCED]		= {.min_int = 24,  .max_int = 40,  .latency = 0, .timeout = 400},	/* 30 - 50 ms */
+	[BLE_CONN_LOW_POWER]	= {.min_int = 160, .max_int = 320, .latency = 4, .timeout = 600},	/* 200 - 400 ms, 4 skipped events */
 };
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
-	CMD_t cmdBuf;
-	static uint8_t adv_config_done = 0;
-	switch (event) {
-		case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-			adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
-			if (adv_config_done == 0){
-				esp_ble_gap_start_advertising(&spp_adv_params);
-				status = BLE_DISCONNECTED;
-			}
-			break;
-		case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-			adv_config_done &= (~ADV_CONFIG_FLAG);
-			if (adv_config_done == 0){
-				esp_ble_gap_start_advertising(&spp_adv_params);
-				status = BLE_DISCONNECTED;
+/* Copy into / out of a power of 2 sized ring, handling the wrap around */
+static void ring_write(uint8_t *ring, size_t size, size_t pos, const uint8_t *src, size_t len) {
+	size_t idx = pos & (size - 1);
+	size_t first = size - idx;
+	if(first > len){
+		first = len;
+	}
+	memcpy(&ring[idx], src, first);
+	memcpy(ring, &src[first], len - first);
+}
+
+static void ring_read(const uint8_t *ring, size_t size, size_t pos, uint8_t *dst, size_t len) {
+	size_t idx = pos & (size - 1);
+	size_t first = size - idx;
+	if(first > len){
+		first = len;
+	}
+	memcpy(dst, &ring[idx], first);
+	memcpy(&dst[first], ring, len - first);
+}
+
+static void read_task(void* pvParameters) {
+	uint16_t length;
+	size_t idx;
+	uint8_t *data;
+	while(1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while(rx_head != rx_tail){
+			ring_read(rx_ring, RX_RING_SIZE, rx_tail, (uint8_t *)&length, sizeof(length));
+			/* the callback gets a pointer into the ring, unless the record wraps around */
+			idx = (rx_tail + sizeof(length)) & (RX_RING_SIZE - 1);
+			if(idx + length > RX_RING_SIZE){
+				ring_read(rx_ring, RX_RING_SIZE, rx_tail + sizeof(length), rx_buf, length);
+				data = rx_buf;
+			}else{
+				data = &rx_ring[idx];
 			}
-			break;
-		case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-			//advertising start complete event to indicate advertising start successfully or failed
-			if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-				ESP_LOGE(__FUNCTION__, "advertising start failed, error status = %x", param->adv_start_cmpl.status);
-				break;
+			if(ble_read_long_p != NULL){
+				ble_read_long_p(data, length);
+			}else if(ble_read_isr_p != BLE_NO_INT){
+				ble_read_isr_p(data, (length > UINT8_MAX) ? UINT8_MAX : length);
 			}
-			ESP_LOGI(TAG, "Advertising start");
-			break;
-		case ESP_GAP_BLE_PASSKEY_REQ_EVT:							/* passkey request event */
-			
-            break;
-		case ESP_GAP_BLE_OOB_REQ_EVT: {
-			uint8_t tk[16] = {1};   //If you paired with OOB, both devices need to use the same tk
-			esp_ble_oob_req_reply(param->ble_security.ble_req.bd_addr, tk, sizeof(tk));
-			break;
+			rx_tail += sizeof(length) + length;
 		}
-		case ESP_GAP_BLE_LOCAL_IR_EVT:								 /* BLE local IR event */
-			
-			break;
-		case ESP_GAP_BLE_LOCAL_ER_EVT:								 /* BLE local ER event */
-
-			break;
-		case ESP_GAP_BLE_NC_REQ_EVT:
-			/* The app will receive this evt when the IO has DisplayYesNO capability and the peer device IO also has DisplayYesNo capability.
-			show the passkey number to the user to confirm it with the number displayed by peer device. */
-			esp_ble_confirm_reply(param->ble_security.ble_req.bd_addr, true);
-			//ESP_LOGI(__FUNCTION__, "ESP_GAP_BLE_NC_REQ_EVT, the passkey Notify number:%"PRIu32, param->ble_security.key_notif.passkey);
-			break;
-		case ESP_GAP_BLE_SEC_REQ_EVT:
-			/* send the positive(true) security response to the peer device to accept the security request.
-			If not accept the security request, should send the security response with negative(false) accept value*/
-			esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
-			break;
-		case ESP_GAP_BLE_PASSKEY_NOTIF_EVT:  
-
-			break;
-		case ESP_GAP_BLE_KEY_EVT:
-
-			break;
-		case ESP_GAP_BLE_AUTH_CMPL_EVT: {
-			cmdBuf.command = CMD_BLUETOOTH_AUTH;
-			xQueueSend(xQueueEvents, &cmdBuf, 0);
-			break;
-	}
-	case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT: {
-		ESP_LOGD(__FUNCTION__, "ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT status = %d", param->remove_bond_dev_cmpl.status);
-		ESP_LOGI(__FUNCTION__, "ESP_GAP_BLE_REMOVE_BOND_DEV");
-		ESP_LOGI(__FUNCTION__, "-----ESP_GAP_BLE_REMOVE_BOND_DEV----");
-		esp_log_buffer_hex(__FUNCTION__, (void *)param->remove_bond_dev_cmpl.bd_addr, sizeof(esp_bd_addr_t));
-		ESP_LOGI(__FUNCTION__, "------------------------------------");
-		break;
-	}
-	case ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT:
-		if (param->local_privacy_cmpl.status != ESP_BT_STATUS_SUCCESS){
-			ESP_LOGE(__FUNCTION__, "config local privacy failed, error status = %x", param->local_privacy_cmpl.status);
-			break;
+	}
+}
+
+/* Sends one notification to one central, waiting while the stack reports congestion */
+static bool send_notification(uint8_t conn, ble_port_char_t characteristic, const uint8_t *data, uint16_t length) {
+	uint8_t retries = 0;
+	while(conns[conn].secured && (retries < BLE_SEND_RETRIES)){
+		if(conns[conn].congested){
+			ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_CONGEST_WAIT_MS));
+			continue;
 		}
-		esp_err_t ret = esp_ble_gap_config_adv_data(&spp_adv_config);
-		if (ret){
-			ESP_LOGE(__FUNCTION__, "config adv data failed, error code = %x", ret);
-		}else{
-			adv_config_done |= ADV_CONFIG_FLAG;
+		switch(BlePortNotify(conn, characteristic, data, length)){
+			case BLE_PORT_OK:
+				ble_stats.notifications++;
+				ble_stats.bytes_sent += length;
+				return true;
+			case BLE_PORT_BUSY:
+				/* out of stack buffers, not an error: wait until one is released */
+				ble_stats.congestions++;
+				break;
+			default:
+				ble_stats.send_errors++;
+				retries++;
+				break;
 		}
-		ret = esp_ble_gap_config_adv_data(&spp_scan_rsp_config);
-		if (ret){
-			ESP_LOGE(__FUNCTION__, "config adv data failed, error code = %x", ret);
-		}else{
-			adv_config_done |= SCAN_RSP_CONFIG_FLAG;
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_CONGEST_WAIT_MS));
+	}
+	return false;
+}
+
+static bool subscribed(uint8_t conn, ble_port_char_t characteristic) {
+	return conns[conn].secured && conns[conn].subscribed[characteristic];
+}
+
+/* Number of secured centrals subscribed to the characteristic */
+static uint8_t subscribers(ble_port_char_t characteristic) {
+	uint8_t qty = 0;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		qty += subscribed(conn, characteristic);
+	}
+	return qty;
+}
+
+/* Notifies the same buffer to every subscribed central (the stack copies it), 
+ * returns the number of centrals that got it */
+static uint8_t notify_all(ble_port_char_t characteristic, const uint8_t *data, uint16_t length) {
+	uint8_t delivered = 0;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(!subscribed(conn, characteristic)){
+			continue;
 		}
-		break;
-	default:
-		break;
-	}
-}
-
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-										esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
-    esp_ble_gatts_cb_param_t *p_data = (esp_ble_gatts_cb_param_t *) param;
-	CMD_t cmdBuf;
-
-	switch (event) {
-		case ESP_GATTS_REG_EVT:
-			esp_ble_gap_set_device_name(device_name);
-			//generate a resolvable random address
-			esp_ble_gap_config_local_privacy(true);
-			esp_ble_gap_config_adv_data_raw((uint8_t *)spp_adv_data, sizeof(spp_adv_data));
-			esp_ble_gatts_create_attr_tab(spp_gatt_db, gatts_if, SPP_IDX_NB, SPP_SVC_INST_ID);
-			break;
-		case ESP_GATTS_READ_EVT:
-			break;
-		case ESP_GATTS_WRITE_EVT:
-			cmdBuf.command = CMD_BLUETOOTH_DATA;
-			memcpy(cmdBuf.payload, param->write.value, param->write.len);
-			cmdBuf.length = param->write.len;
-			xQueueSend(xQueueRead, &cmdBuf, 0);
-			break;
-		case ESP_GATTS_EXEC_WRITE_EVT:
-			break;
-		case ESP_GATTS_MTU_EVT:
-			break;
-		case ESP_GATTS_CONF_EVT:
-			break;
-		case ESP_GATTS_UNREG_EVT:
-			break;
-		case ESP_GATTS_DELETE_EVT:
-			break;
-		case ESP_GATTS_START_EVT:
-			break;
-		case ESP_GATTS_STOP_EVT:
-			break;
-		case ESP_GATTS_CONNECT_EVT:
-			/* start security connect with peer device when receive the connect event sent by the master */
-			esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_MITM);
-			cmdBuf.command = CMD_BLUETOOTH_CONNECT;
-			cmdBuf.spp_conn_id = p_data->connect.conn_id;
-			cmdBuf.spp_gatts_if = gatts_if;
-			xQueueSend(xQueueEvents, &cmdBuf, portMAX_DELAY);
-			break;
-		case ESP_GATTS_DISCONNECT_EVT:
-			cmdBuf.command = CMD_BLUETOOTH_DISCONNECT;
-			status = BLE_DISCONNECTED;
-			xQueueSend(xQueueEvents, &cmdBuf, portMAX_DELAY);
-			/* start advertising again when missing the connect */
-			esp_ble_gap_start_advertising(&spp_adv_params);
-			break;
-		case ESP_GATTS_OPEN_EVT:
-			break;
-		case ESP_GATTS_CANCEL_OPEN_EVT:
-			break;
-		case ESP_GATTS_CLOSE_EVT:
-			break;
-		case ESP_GATTS_LISTEN_EVT:
-			break;
-		case ESP_GATTS_CONGEST_EVT:
-			break;
-		case ESP_GATTS_CREAT_ATTR_TAB_EVT: {
-			if (param->create.status == ESP_GATT_OK){
-				if(param->add_attr_tab.num_handle == SPP_IDX_NB) {
-					memcpy(spp_handle_table, param->add_attr_tab.handles,
-					sizeof(spp_handle_table));
-					esp_ble_gatts_start_service(spp_handle_table[SPP_IDX_SVC]);
-				}else{
-					ESP_LOGE(__FUNCTION__, "Create attribute table abnormally, num_handle (%d) doesn't equal to SPP_IDX_NB(%d)",
-						param->add_attr_tab.num_handle, SPP_IDX_NB);
-				}
-			}else{
-				ESP_LOGE(__FUNCTION__, " Create attribute table failed, error code = %x", param->create.status);
-			}
-		break;
+		/* stream packets queued before a central with a smaller MTU subscribed */
+		if((length > conns[conn].mtu - BLE_ATT_HDR_SIZE) || !send_notification(conn, characteristic, data, length)){
+			ble_stats.dropped += length;
+			continue;
+		}
+		delivered++;
 	}
-		default:
-		   break;
+	return delivered;
+}
+
+/* Segments are sized for the smallest MTU, so every central can take them */
+static void update_mtu(void) {
+	uint16_t mtu = 0;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conns[conn].secured && ((mtu == 0) || (conns[conn].mtu < mtu))){
+			mtu = conns[conn].mtu;
+		}
 	}
+	ble_mtu = (mtu == 0) ? BLE_MTU_DEFAULT : mtu;
 }
 
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-								esp_ble_gatts_cb_param_t *param) {
-	/* If event is register event, store the gatts_if for each profile */
-	if (event == ESP_GATTS_REG_EVT) {
-		if (param->reg.status == ESP_GATT_OK) {
-			spp_profile_tab[SPP_PROFILE_APP_IDX].gatts_if = gatts_if;
-		} else {
-			return;
+static void update_status(void) {
+	status = BLE_DISCONNECTED;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conns[conn].secured){
+			status = BLE_CONNECTED;
 		}
 	}
-	do {
-		int idx;
-		for (idx = 0; idx < SPP_PROFILE_NUM; idx++) {
-			if (gatts_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
-					gatts_if == spp_profile_tab[idx].gatts_if) {
-				if (spp_profile_tab[idx].gatts_cb) {
-					spp_profile_tab[idx].gatts_cb(event, gatts_if, param);
-				}
+	update_mtu();
+}
+
+/* Time of the write the byte at tx_tail belongs to */
+static int64_t oldest_pending_time(void) {
+	while(((uint8_t)(mark_head - mark_tail) > 1) && 
+			((int32_t)(tx_tail - tx_marks[(mark_tail + 1) & (TX_MARKS_QTY - 1)].pos) >= 0)){
+		mark_tail++;
+	}
+	return tx_marks[mark_tail & (TX_MARKS_QTY - 1)].time_us;
+}
+
+static void flush_timer_cb(void * arg) {
+	xTaskNotifyGive(send_task_handle);
+}
+
+/* Sends the next stream packet, returns false if there is none */
+static bool send_stream_packet(void) {
+	uint16_t length;
+	if(stream_head == stream_tail){
+		return false;
+	}
+	ring_read(stream_ring, STREAM_RING_SIZE, stream_tail, (uint8_t *)&length, STREAM_LEN_SIZE);
+	ring_read(stream_ring, STREAM_RING_SIZE, stream_tail + STREAM_LEN_SIZE, stream_bounce, length);
+	if(subscribers(BLE_PORT_STREAM) == 0){
+		ble_stats.unsubscribed_dropped += length;
+	}else if(notify_all(BLE_PORT_STREAM, stream_bounce, length) > 0){
+		ble_stats.stream_packets++;
+	}
+	stream_tail += STREAM_LEN_SIZE + length;
+	xSemaphoreGive(tx_space);
+	return true;
+}
+
+/* Sends the next segment of the TX ring, returns false if there is nothing to send yet */
+static bool send_segment(void) {
+	size_t pending, chunk, idx;
+	uint8_t *segment;
+	uint8_t delivered;
+	int64_t age_us, latency_us;
+
+	pending = tx_head - tx_tail;
+	if(pending == 0){
+		return false;
+	}
+	if(subscribers(BLE_PORT_DATA) == 0){
+		/* nobody to deliver it to */
+		ble_stats.unsubscribed_dropped += pending;
+		tx_tail += pending;
+		mark_tail = mark_head;
+		xSemaphoreGive(tx_space);
+		return true;
+	}
+	chunk = ble_mtu - BLE_ATT_HDR_SIZE;
+	age_us = esp_timer_get_time() - oldest_pending_time();
+	if(pending < chunk){
+		if(coalesce_us > 0){
+			/* keep packing until the segment is full or the oldest byte reaches the deadline */
+			if(age_us < coalesce_us){
+				esp_timer_stop(flush_timer);
+				esp_timer_start_once(flush_timer, coalesce_us - age_us);
+				return false;
 			}
+			ble_stats.deadline_flushes++;
 		}
-	} while (0);
+		chunk = pending;
+	}
+	/* segments that wrap around the ring end are gathered in a bounce buffer */
+	idx = tx_tail & TX_RING_MASK;
+	if(chunk > BLE_TX_BUFFER_SIZE - idx){
+		ring_read(tx_ring, BLE_TX_BUFFER_SIZE, tx_tail, tx_bounce, chunk);
+		segment = tx_bounce;
+	}else{
+		segment = &tx_ring[idx];
+	}
+	delivered = notify_all(BLE_PORT_DATA, segment, chunk);
+	if(delivered > 0){
+		latency_us = esp_timer_get_time() - oldest_pending_time();
+		latency_sum_us += latency_us;
+		latency_qty++;
+		capacity_sum += (uint64_t)(ble_mtu - BLE_ATT_HDR_SIZE) * delivered;
+		if(latency_us > ble_stats.max_latency_us){
+			ble_stats.max_latency_us = latency_us;
+		}
+	}
+	tx_tail += chunk;
+	xSemaphoreGive(tx_space);
+	return true;
 }
 
-static void read_task(void* pvParameters) {
-	CMD_t cmdBuf;
-	while(1) {
-		xQueueReceive(xQueueRead, &cmdBuf, portMAX_DELAY);
-		if(ble_read_isr_p != BLE_NO_INT){
-            ble_read_isr_p(cmdBuf.payload, cmdBuf.length);
-        }
+static void send_task(void * arg) {
+	while(1){
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		/* stream packets go first, they are time stamped and already full */
+		while(send_stream_packet() || send_segment()){
+		}
 	} 
 }
 
-void bluetooth_events_task(void * arg) {
-	CMD_t cmdBuf;
-	uint16_t spp_conn_id = 0xffff;
-	esp_gatt_if_t spp_gatts_if = 0xff;
-	int data_sent, i;
+/* Requests conn_req now to every connected central, and on every following connection */
+static bool request_conn_params(void) {
+	bool ok = true;
+	conn_req_set = true;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conns[conn].link_up){
+			ok &= BlePortUpdateConnParams(conn, &conn_req);
+		}
+	}
+	return ok;
+}
+
+/* First connection up, the one BleGetConnParams reports */
+static int8_t first_conn(void) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conns[conn].link_up){
+			return conn;
+		}
+	}
+	return -1;
+}
 
-	while(1){
-		vTaskDelay(50 / portTICK_PERIOD_MS);
-		xQueueReceive(xQueueEvents, &cmdBuf, portMAX_DELAY);
-        switch(cmdBuf.command){
-            case CMD_BLUETOOTH_CONNECT:
-                spp_conn_id = cmdBuf.spp_conn_id;
-                spp_gatts_if = cmdBuf.spp_gatts_if;
-            break;
-            case CMD_BLUETOOTH_AUTH:
-                ESP_LOGI(TAG, "Device connected");
-				status = BLE_CONNECTED;
-            break;
-            case CMD_BLUETOOTH_DISCONNECT:
-                ESP_LOGI(TAG, "Device disconnected");
-				status = BLE_DISCONNECTED;
-            break;
-            case CMD_SEND_DATA:
-                if (status == BLE_CONNECTED) {
-					data_sent = 0;
-					i = 0;
-					while(data_sent < cmdBuf.length){
-						if((cmdBuf.length - data_sent) > MTU_MAX_BYTES){
-							esp_ble_gatts_send_indicate(spp_gatts_if, spp_conn_id, spp_handle_table[SPP_IDX_SPP_DATA_NOTIFY_VAL], MTU_MAX_BYTES, &cmdBuf.payload[i*MTU_MAX_BYTES], false);
-							data_sent += MTU_MAX_BYTES;
-							i++;
-						}else{
-							esp_ble_gatts_send_indicate(spp_gatts_if, spp_conn_id, spp_handle_table[SPP_IDX_SPP_DATA_NOTIFY_VAL], cmdBuf.length - data_sent, &cmdBuf.payload[i*MTU_MAX_BYTES], false);
-							data_sent += MTU_MAX_BYTES;
-						}
-					}
-                }
-            break;
-            case CMD_BLUETOOTH_DATA:
-                xQueueSend(xQueueRead, &cmdBuf, portMAX_DELAY);
-            break;
-        }
-	} 
+/*==================[stack events]===========================================*/
+void BleOnAdvertising(void){
+	if(status == BLE_OFF){
+		ESP_LOGI(TAG, "Advertising %lld us after BleInit", (long long)(esp_timer_get_time() - init_start_us));
+	}
+	/* with free connections the device advertises while connected too */
+	update_status();
+}
+
+void BleOnConnect(uint8_t conn, const ble_conn_params_t *params){
+	if(links_qty == 0){
+		/* counters cover the time with at least one central */
+		memset(&ble_stats, 0, sizeof(ble_stats));
+		latency_sum_us = 0;
+		latency_qty = 0;
+		capacity_sum = 0;
+		conn_start_us = esp_timer_get_time();
+	}
+	memset(&conns[conn], 0, sizeof(ble_conn_t));
+	conns[conn].params = *params;
+	conns[conn].mtu = BLE_MTU_DEFAULT;
+	conns[conn].link_up = true;
+	links_qty++;
+	if(conn_req_set){
+		BlePortUpdateConnParams(conn, &conn_req);
+	}
+}
+
+void BleOnSecured(uint8_t conn){
+	ESP_LOGI(TAG, "Device %d connected (%d of %d)", conn, links_qty, BLE_MAX_CONN);
+	conns[conn].secured = true;
+	update_status();
+}
+
+void BleOnDisconnect(uint8_t conn){
+	ESP_LOGI(TAG, "Device %d disconnected", conn);
+	if(conns[conn].link_up){
+		links_qty--;
+	}
+	memset(&conns[conn], 0, sizeof(ble_conn_t));
+	update_status();
+	/* release the send task if it was waiting on a congested link */
+	xTaskNotifyGive(send_task_handle);
+}
+
+void BleOnMtu(uint8_t conn, uint16_t mtu){
+	/* segments are sized to the bounce buffers */
+	conns[conn].mtu = (mtu > BLE_MTU_REQUEST) ? BLE_MTU_REQUEST : mtu;
+	ESP_LOGI(TAG, "Device %d MTU: %d bytes", conn, conns[conn].mtu);
+	update_mtu();
+}
+
+void BleOnCongest(uint8_t conn, bool state){
+	conns[conn].congested = state;
+	if(state){
+		ble_stats.congestions++;
+	}else{
+		xTaskNotifyGive(send_task_handle);
+	}
+}
+
+/* Queues a received write for the read task, it's dropped if there is no room */
+void BleOnWrite(const uint8_t *data, uint16_t length){
+	size_t room = RX_RING_SIZE - (rx_head - rx_tail);
+	if(room < sizeof(length) + length){
+		ble_stats.rx_dropped += length;
+		return;
+	}
+	ring_write(rx_ring, RX_RING_SIZE, rx_head, (uint8_t *)&length, sizeof(length));
+	ring_write(rx_ring, RX_RING_SIZE, rx_head + sizeof(length), data, length);
+	rx_head += sizeof(length) + length;
+	ble_stats.bytes_received += length;
+	xTaskNotifyGive(read_task_handle);
+}
+
+void BleOnSubscribe(uint8_t conn, ble_port_char_t characteristic, bool enabled){
+	conns[conn].subscribed[characteristic] = enabled;
+}
+
+void BleOnConnParams(uint8_t conn, const ble_conn_params_t *params){
+	conns[conn].params = *params;
+	ESP_LOGI(TAG, "Device %d: connection interval %d x 1.25 ms, latency %d, timeout %d x 10 ms", 
+		conn, params->interval, params->latency, params->timeout);
+	if(conn_func_p != NULL){
+		conn_func_p(params);
+	}
 }
 
 /*==================[external functions definition]==========================*/
 void BleInit(ble_config_t * ble_device){
-esp_err_t ret;
-    device_name = ble_device->device_name;
-    ble_read_isr_p = ble_device->func_p;
-	/* Initialize NVS. */
+	esp_err_t ret;
+	size_t free_heap;
+	device_name = ble_device->device_name;
+	ble_read_isr_p = ble_device->func_p;
+	ble_read_long_p = ble_device->long_func_p;
+	init_start_us = esp_timer_get_time();
+	/* Initialize NVS, both hosts keep the bonding keys there */
 	ret = nvs_flash_init();
 	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
 		ESP_ERROR_CHECK(nvs_flash_erase());
 		ret = nvs_flash_init();
 	}
 	ESP_ERROR_CHECK(ret);
-	ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
-	esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-	ret = esp_bt_controller_init(&bt_cfg);
-	if (ret) {
-		ESP_LOGE(TAG, "%s init controller failed: %s", __func__, esp_err_to_name(ret));
+	
+    /* Create Queue */
+	tx_mutex = xSemaphoreCreateMutex();
+	configASSERT(tx_mutex);
+	tx_space = xSemaphoreCreateBinary();
+	configASSERT(tx_space);
+	stream_mutex = xSemaphoreCreateMutex();
+	configASSERT(stream_mutex);
+
+	/* Start tasks, before the host: it calls back as soon as it's enabled */
+	const esp_timer_create_args_t flush_timer_args = {
+		.callback = &flush_timer_cb,
+		.name = "ble_flush"
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&flush_timer_args, &flush_timer));
+
+	xTaskCreate(read_task, "read", 1024*4, NULL, 2, &read_task_handle);
+	xTaskCreate(send_task, "ble_send", 1024*4, NULL, 10, &send_task_handle);
+
+	/* controller + host cost, see documentación/bluetooth.md */
+	free_heap = esp_get_free_heap_size();
+	if(!BlePortInit(device_name, BLE_MTU_REQUEST)){
 		return;
 	}
-	ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-	if (ret) {
-		ESP_LOGE(TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
-		return;
+	ESP_LOGI(TAG, "Host started in %lld us, %d bytes of heap", (long long)(esp_timer_get_time() - init_start_us),
+		(int)(free_heap - esp_get_free_heap_size()));
+}
+
+ble_status_t BleStatus(void){
+	return status;
+}
+
+uint16_t BleGetMtu(void){
+	return ble_mtu;
+}
+
+void BleSetCoalescing(uint16_t deadline_ms){
+	coalesce_us = (uint32_t)deadline_ms * 1000;
+	if(send_task_handle != NULL){
+		/* pending data is re-evaluated against the new deadline */
+		xTaskNotifyGive(send_task_handle);
 	}
-	ret = esp_bluedroid_init();
-	if (ret) {
-		ESP_LOGE(TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
-		return;
+}
+
+bool BleSetConnProfile(ble_conn_profile_t profile){
+	conn_req = conn_profiles[profile];
+	return request_conn_params();
+}
+
+bool BleSetConnInterval(uint16_t min_int, uint16_t max_int){
+	if(!conn_req_set){
+		conn_req = conn_profiles[BLE_CONN_BALANCED];
 	}
-	ret = esp_bluedroid_enable();
-	if (ret) {
-		ESP_LOGE(TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
-		return;
+	conn_req.min_int = min_int;
+	conn_req.max_int = max_int;
+	return request_conn_params();
+}
+
+bool BleSetConnLatency(uint16_t latency){
+	if(!conn_req_set){
+		conn_req = conn_profiles[BLE_CONN_BALANCED];
 	}
-	ret = esp_ble_gatts_register_callback(gatts_event_handler);
-	if (ret){
-		ESP_LOGE(TAG, "gatts register error, error code = %x", ret);
-		return;
+	conn_req.latency = latency;
+	return request_conn_params();
+}
+
+bool BleSetConnTimeout(uint16_t timeout){
+	if(!conn_req_set){
+		conn_req = conn_profiles[BLE_CONN_BALANCED];
 	}
-	ret = esp_ble_gap_register_callback(gap_event_handler);
-	if (ret){
-		ESP_LOGE(TAG, "gap register error, error code = %x", ret);
+	conn_req.timeout = timeout;
+	return request_conn_params();
+}
+
+void BleGetConnParams(ble_conn_params_t *params){
+	int8_t conn = first_conn();
+	if(conn < 0){
+		memset(params, 0, sizeof(ble_conn_params_t));
 		return;
 	}
-	ret = esp_ble_gatts_app_register(ESP_SPP_APP_ID);
-	if (ret){
-		ESP_LOGE(TAG, "gatts app register error, error code = %x", ret);
-		return;
+	*params = conns[conn].params;
+}
+
+uint8_t BleConnCount(void){
+	uint8_t qty = 0;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		qty += conns[conn].secured;
 	}
-	/* set the security iocap & auth_req & key size & init key response key parameters to the stack*/
-	esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;		//bonding with peer device after authentication
-	esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;			//set the IO capability to No output No input
-	uint8_t key_size = 16;		//the key size should be 7~16 bytes
-	uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-	uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-	//set static passkey
-	uint32_t passkey = 123456;
-	uint8_t auth_option = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_DISABLE;
-	uint8_t oob_support = ESP_BLE_OOB_DISABLE;
-	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey, sizeof(uint32_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, &auth_option, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_OOB_SUPPORT, &oob_support, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
-	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
-	
-    /* Create Queue */
-	xQueueEvents = xQueueCreate(10, sizeof(CMD_t));
-	configASSERT(xQueueEvents);
-	xQueueRead = xQueueCreate( 10, sizeof(CMD_t) );
-	configASSERT(xQueueRead);
+	return qty;
+}
 
-	/* Start tasks */
-	xTaskCreate(read_task, "read", 1024*4, NULL, 2, NULL);
-	xTaskCreate(bluetooth_events_task, "bluetooth_events", 1024*4, NULL, 10, NULL);
+bool BleGetConnInfo(uint8_t conn, ble_conn_info_t *info){
+	if((conn >= BLE_MAX_CONN) || !conns[conn].secured){
+		return false;
+	}
+	info->mtu = conns[conn].mtu;
+	info->params = conns[conn].params;
+	info->data_subscribed = conns[conn].subscribed[BLE_PORT_DATA];
+	info->stream_subscribed = conns[conn].subscribed[BLE_PORT_STREAM];
+	return true;
 }
 
-ble_status_t BleStatus(void){
-	return status;
+void BleSetConnCallback(conn_func func_p){
+	conn_func_p = func_p;
 }
 
-void BleSendByte(const char *data){
-	CMD_t cmdBuf;
+size_t BleSendFree(void){
+	return BLE_TX_BUFFER_SIZE - (tx_head - tx_tail);
+}
+
+void BleGetStats(ble_stats_t *stats){
+	int64_t elapsed_us;
+	*stats = ble_stats;
+	stats->throughput = 0;
+	stats->avg_latency_us = 0;
+	stats->efficiency = 0;
+	if(latency_qty > 0){
+		stats->avg_latency_us = latency_sum_us / latency_qty;
+		stats->efficiency = (uint8_t)((uint64_t)ble_stats.bytes_sent * 100 / capacity_sum);
+	}
 	if(status == BLE_CONNECTED){
-		cmdBuf.command = CMD_SEND_DATA;
-		cmdBuf.length = 1;
-		memcpy(cmdBuf.payload, data, cmdBuf.length);
-		xQueueSend(xQueueEvents, &cmdBuf, portMAX_DELAY);
+		elapsed_us = esp_timer_get_time() - conn_start_us;
+		if(elapsed_us > 0){
+			stats->throughput = (uint32_t)((int64_t)ble_stats.bytes_sent * 1000000 / elapsed_us);
+		}
 	}
 }
 
+void BleSendByte(const char *data){
+	BleSendBuffer(data, 1);
+}
+
 void BleSendString(const char *msg){
-	CMD_t cmdBuf;
-	if(status == BLE_CONNECTED){
-		cmdBuf.command = CMD_SEND_DATA;
-		cmdBuf.length = 0;
-		while(msg[cmdBuf.length] != '\0'){
-			cmdBuf.length++;
+	BleSendBuffer(msg, strlen(msg));
+}
+
+size_t BleSendBuffer(const char *data, size_t nbytes){
+	size_t sent = 0, chunk;
+	if((status != BLE_CONNECTED) || (tx_mutex == NULL)){
+		return 0;
+	}
+	xSemaphoreTake(tx_mutex, portMAX_DELAY);
+	while((sent < nbytes) && (status == BLE_CONNECTED)){
+		chunk = BLE_TX_BUFFER_SIZE - (tx_head - tx_tail);
+		if(chunk == 0){
+			/* backpressure: the link is slower than the application */
+			ble_stats.tx_waits++;
+			xSemaphoreTake(tx_space, pdMS_TO_TICKS(BLE_CONGEST_WAIT_MS));
+			continue;
+		}
+		if(chunk > nbytes - sent){
+			chunk = nbytes - sent;
+		}
+		if((uint8_t)(mark_head - mark_tail) < TX_MARKS_QTY){
+			tx_marks[mark_head & (TX_MARKS_QTY - 1)].pos = tx_head;
+			tx_marks[mark_head & (TX_MARKS_QTY - 1)].time_us = esp_timer_get_time();
+			mark_head++;
 		}
-		memcpy(cmdBuf.payload, msg, cmdBuf.length);
-		xQueueSend(xQueueEvents, &cmdBuf, portMAX_DELAY);
+		ring_write(tx_ring, BLE_TX_BUFFER_SIZE, tx_head, (const uint8_t *)&data[sent], chunk);
+		tx_head += chunk;
+		sent += chunk;
+		xTaskNotifyGive(send_task_handle);
 	}
+	xSemaphoreGive(tx_mutex);
+	return sent;
 }
 
-void BleSendBuffer(const char *data, uint8_t nbytes){
-	CMD_t cmdBuf;
-	if(status == BLE_CONNECTED){
-		cmdBuf.command = CMD_SEND_DATA;
-		cmdBuf.length = nbytes;
-		memcpy(cmdBuf.payload, data, cmdBuf.length);
-		xQueueSend(xQueueEvents, &cmdBuf, portMAX_DELAY);
+size_t BleStreamSend(ble_stream_t *stream, const void *samples, size_t count, int64_t timestamp_us){
+	const uint8_t *data = samples;
+	uint8_t header[BLE_STREAM_HDR_SIZE];
+	uint8_t sample_size = stream_sample_size[stream->format];
+	size_t sent = 0, qty, per_packet;
+	uint16_t length;
+	uint32_t time_stamp;
+	if((status != BLE_CONNECTED) || (subscribers(BLE_PORT_STREAM) == 0) || (stream_mutex == NULL)){
+		return 0;
+	}
+	per_packet = (ble_mtu - BLE_ATT_HDR_SIZE - BLE_STREAM_HDR_SIZE) / sample_size;
+	xSemaphoreTake(stream_mutex, portMAX_DELAY);
+	while((sent < count) && (status == BLE_CONNECTED)){
+		qty = count - sent;
+		if(qty > per_packet){
+			qty = per_packet;
+		}
+		length = BLE_STREAM_HDR_SIZE + qty * sample_size;
+		if(STREAM_RING_SIZE - (stream_head - stream_tail) < (size_t)(STREAM_LEN_SIZE + length)){
+			ble_stats.tx_waits++;
+			xSemaphoreTake(tx_space, pdMS_TO_TICKS(BLE_CONGEST_WAIT_MS));
+			continue;
+		}
+		/* little endian header, see BLE_STREAM_HDR_SIZE */
+		time_stamp = (uint32_t)(timestamp_us + (int64_t)sent * stream->period_us);
+		header[0] = stream->id;
+		header[1] = (BLE_STREAM_VERSION << 4) | stream->format;
+		header[2] = stream->seq & 0xFF;
+		header[3] = stream->seq >> 8;
+		header[4] = time_stamp & 0xFF;
+		header[5] = (time_stamp >> 8) & 0xFF;
+		header[6] = (time_stamp >> 16) & 0xFF;
+		header[7] = time_stamp >> 24;
+		ring_write(stream_ring, STREAM_RING_SIZE, stream_head, (uint8_t *)&length, STREAM_LEN_SIZE);
+		ring_write(stream_ring, STREAM_RING_SIZE, stream_head + STREAM_LEN_SIZE, header, BLE_STREAM_HDR_SIZE);
+		ring_write(stream_ring, STREAM_RING_SIZE, stream_head + STREAM_LEN_SIZE + BLE_STREAM_HDR_SIZE, 
+			&data[sent * sample_size], qty * sample_size);
+		stream_head += STREAM_LEN_SIZE + length;
+		stream->seq++;
+		sent += qty;
+		xTaskNotifyGive(send_task_handle);
 	}
+	xSemaphoreGive(stream_mutex);
+	return sent;
 }
 /*==================[end of file]============================================*/
\ No newline at end of file
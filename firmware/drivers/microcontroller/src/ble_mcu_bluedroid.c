@@ -0,0 +1,758 @@
+/**
+ * @file ble_mcu_bluedroid.c
+ * @brief Bluedroid host glue of the BLE driver (see ble_mcu_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_mcu_port.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "esp_bt.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include "esp_bt_defs.h"
+#include "esp_bt_main.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_mcu"
+#define SPP_PROFILE_NUM     1       
+#define SPP_PROFILE_APP_IDX 0
+#define ESP_SPP_APP_ID      0x56
+#define SPP_SVC_INST_ID     0
+#define SPP_DATA_MAX_LEN    BLE_RX_MAX_LEN /* Maximun number of bytes written in one transaction (long writes included) */
+#define CCCD_NVS_NAMESPACE	"ble_cccd"		/* Subscriptions of bonded centrals, one key per address */
+#define CCCD_KEY_LEN		(2 * sizeof(esp_bd_addr_t) + 1)
+/* List of attributes to be added to the service database */
+enum{
+    SPP_IDX_SVC,
+    SPP_IDX_SPP_DATA_RECV_NOTIFY_CHAR,
+    SPP_IDX_SPP_DATA_NOTIFY_VAL,
+    SPP_IDX_SPP_DATA_NOTIFY_CFG,
+    SPP_IDX_SPP_DATA_RECV_VAL,
+    SPP_IDX_SPP_DATA_RECV_CFG,
+    SPP_IDX_STREAM_CHAR,
+    SPP_IDX_STREAM_VAL,
+    SPP_IDX_STREAM_CFG,
+    SPP_IDX_NB,
+};
+/* Characteristics UUID */
+#define ESP_GATT_UUID_SPP_SERVICE               0xFFE0  /* Service ID */
+#define ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY   0xFFE1  /* Characteristic ID */
+#define ESP_GATT_UUID_SENSOR_STREAM             0xFFE2  /* Binary sample stream characteristic ID */
+
+#define ADV_CONFIG_FLAG			                (1 << 0)
+#define SCAN_RSP_CONFIG_FLAG	                (1 << 1)
+/*==================[typedef]================================================*/
+
+/*==================[internal data declaration]==============================*/
+static const char * device_name; /* Device name */
+/* Connected centrals, by the index known to the core */
+static struct {
+	bool used;
+	uint16_t conn_id;							/* Connection id of the central */
+	esp_bd_addr_t bda;							/* Address of the central, for security and connection updates */
+	uint8_t cccd;								/* Subscriptions, bit n: ble_port_char_t n */
+	bool cccd_written;							/* The central wrote a CCCD in this connection */
+} conn_tab[BLE_MAX_CONN];
+static esp_gatt_if_t spp_gatts_if = 0xff;		/* GATT interface of the connections */
+static uint16_t spp_handle_table[SPP_IDX_NB];   /* Service database table */
+/* GATT profile struct */
+struct gatts_profile_inst {
+	esp_gatts_cb_t gatts_cb;
+	uint16_t gatts_if;
+	uint16_t app_id;
+	uint16_t conn_id;
+	uint16_t service_handle;
+	esp_gatt_srvc_id_t service_id;
+	uint16_t char_handle;
+	esp_bt_uuid_t char_uuid;
+	esp_gatt_perm_t perm;
+	esp_gatt_char_prop_t property;
+	uint16_t descr_handle;
+	esp_bt_uuid_t descr_uuid;
+};
+static uint8_t prep_buf[BLE_RX_MAX_LEN];		/* Long write being assembled */
+static uint16_t prep_len = 0;
+static int8_t prep_conn = -1;					/* Connection the long write comes from */
+
+/*==================[internal functions declaration]=========================*/
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
+										esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+/*==================[internal data definition]===============================*/
+static const uint16_t spp_service_uuid = ESP_GATT_UUID_SPP_SERVICE; /* Service ID */
+/* Advertising data */
+static const uint8_t spp_adv_data[23] = {
+	/* Flags */
+	0x02,0x01,0x06,
+	/* Complete List of 16-bit Service Class UUIDs */
+	0x03,0x03,0xF0,0xAB,
+	/* Complete Local Name in advertising */
+	0x0F,0x09, 'E', 'S', 'P', '_', 'E', 'D', 'U', '_', 'S', 'E', 'R','V', 'E', 'R'
+};
+/* Advertising parameters */
+static esp_ble_adv_params_t spp_adv_params = {
+	.adv_int_min		= 0x20,
+	.adv_int_max		= 0x40,
+	.adv_type			= ADV_TYPE_IND,
+	.own_addr_type		= BLE_ADDR_TYPE_PUBLIC,
+	.channel_map		= ADV_CHNL_ALL,
+	.adv_filter_policy	= ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+/* Service UUID */
+static uint8_t sec_service_uuid[16] = {
+	/* LSB <--------------------------------------------------------------------------------> MSB */
+	//first uuid, 16bit, [12],[13] is the value
+	0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0xE0, 0xFF, 0x00, 0x00,
+};
+/* Config advertising data */
+static esp_ble_adv_data_t spp_adv_config = {
+	.set_scan_rsp = false,
+	.include_txpower = true,
+	.min_interval = 0x0006, //slave connection min interval, Time = min_interval * 1.25 msec
+	.max_interval = 0x0010, //slave connection max interval, Time = max_interval * 1.25 msec
+	.appearance = 0x00,
+	.manufacturer_len = 0, 
+	.p_manufacturer_data =	NULL,
+	.service_data_len = 0,
+	.p_service_data = NULL,
+	.service_uuid_len = sizeof(sec_service_uuid),
+	.p_service_uuid = sec_service_uuid,
+	.flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+};
+/* config scan response data */
+static esp_ble_adv_data_t spp_scan_rsp_config = {
+	.set_scan_rsp = true,
+	.include_name = true,
+	.manufacturer_len = 0,
+	.p_manufacturer_data = NULL,
+};
+/* One gatt-based profile one app_id and one gatts_if, this array will store the gatts_if returned by ESP_GATTS_REG_EVT */
+static struct gatts_profile_inst spp_profile_tab[SPP_PROFILE_NUM] = {
+	[SPP_PROFILE_APP_IDX] = {
+		.gatts_cb = gatts_profile_event_handler,
+		.gatts_if = ESP_GATT_IF_NONE,		/* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
+	},
+};
+/* Service and characteristics id and values */
+static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
+static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
+static const uint16_t character_description_uuid = ESP_GATT_UUID_CHAR_DESCRIPTION;
+static const uint16_t character_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
+static const uint8_t char_prop_read_write = ESP_GATT_CHAR_PROP_BIT_WRITE_NR|ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_NOTIFY;;
+static const uint16_t spp_data_receive_uuid = ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY;
+static const uint8_t  spp_data_receive_val[20] = {0x00};
+static const uint16_t spp_data_notify_uuid = ESP_GATT_UUID_SPP_DATA_RECEIVE_NOTIFY;
+static const uint8_t  spp_data_notify_val[20] = {0x00};
+static const uint8_t  spp_data_notify_ccc[2] = {0x00, 0x00};
+static const uint8_t char_prop_read_notify = ESP_GATT_CHAR_PROP_BIT_READ|ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint16_t sensor_stream_uuid = ESP_GATT_UUID_SENSOR_STREAM;
+static const uint8_t  sensor_stream_val[BLE_STREAM_HDR_SIZE] = {0x00};
+/* Full HRS Database Description - Used to add attributes into the database */
+static const esp_gatts_attr_db_t spp_gatt_db[SPP_IDX_NB] = {
+	/* SPP -  Service Declaration */
+	[SPP_IDX_SVC]						=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&primary_service_uuid, ESP_GATT_PERM_READ,
+	sizeof(spp_service_uuid), sizeof(spp_service_uuid), (uint8_t *)&spp_service_uuid}},
+
+	/* SPP -  data receive and notify characteristic Declaration */
+	[SPP_IDX_SPP_DATA_RECV_NOTIFY_CHAR]			=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	(sizeof(uint8_t)),(sizeof(uint8_t)), (uint8_t *)&char_prop_read_write}},
+
+	/* SPP -  data notify characteristic Value */
+	[SPP_IDX_SPP_DATA_NOTIFY_VAL]	=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&spp_data_notify_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	SPP_DATA_MAX_LEN, sizeof(spp_data_notify_val), (uint8_t *)spp_data_notify_val}},
+
+	/* SPP -  data notify characteristic - Client Characteristic Configuration Descriptor */
+	[SPP_IDX_SPP_DATA_NOTIFY_CFG]		  =
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	sizeof(uint16_t),sizeof(spp_data_notify_ccc), (uint8_t *)spp_data_notify_ccc}},
+
+	/* SPP -  data receive characteristic Value */
+	[SPP_IDX_SPP_DATA_RECV_VAL]					=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&spp_data_receive_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	SPP_DATA_MAX_LEN,sizeof(spp_data_receive_val), (uint8_t *)spp_data_receive_val}},
+	
+	/* SPP -  data notify characteristic - Client Characteristic Configuration Descriptor */
+	[SPP_IDX_SPP_DATA_RECV_CFG]		  =
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_description_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	sizeof(uint16_t),sizeof(spp_data_notify_ccc), (uint8_t *)spp_data_notify_ccc}},
+
+	/* Sensor stream - binary samples characteristic Declaration */
+	[SPP_IDX_STREAM_CHAR]				=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+	sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_read_notify}},
+
+	/* Sensor stream - binary samples characteristic Value */
+	[SPP_IDX_STREAM_VAL]				=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&sensor_stream_uuid, ESP_GATT_PERM_READ,
+	BLE_MTU_REQUEST - BLE_ATT_HDR_SIZE, sizeof(sensor_stream_val), (uint8_t *)sensor_stream_val}},
+
+	/* Sensor stream - Client Characteristic Configuration Descriptor */
+	[SPP_IDX_STREAM_CFG]				=
+	{{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ|ESP_GATT_PERM_WRITE,
+	sizeof(uint16_t), sizeof(spp_data_notify_ccc), (uint8_t *)spp_data_notify_ccc}},
+};
+/*==================[external data definition]===============================*/
+/*==================[internal functions definition]==========================*/
+/* Index of a connection, -1 if unknown */
+static int8_t conn_by_id(uint16_t conn_id) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conn_tab[conn].used && (conn_tab[conn].conn_id == conn_id)){
+			return conn;
+		}
+	}
+	return -1;
+}
+
+static int8_t conn_by_bda(const esp_bd_addr_t bda) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conn_tab[conn].used && (memcmp(conn_tab[conn].bda, bda, sizeof(esp_bd_addr_t)) == 0)){
+			return conn;
+		}
+	}
+	return -1;
+}
+
+static int8_t conn_alloc(uint16_t conn_id, const esp_bd_addr_t bda) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(!conn_tab[conn].used){
+			conn_tab[conn].used = true;
+			conn_tab[conn].conn_id = conn_id;
+			memcpy(conn_tab[conn].bda, bda, sizeof(esp_bd_addr_t));
+			conn_tab[conn].cccd = 0;
+			conn_tab[conn].cccd_written = false;
+			return conn;
+		}
+	}
+	return -1;
+}
+
+/* The CCCDs are ESP_GATT_AUTO_RSP attributes, shared by every connection and forgotten
+ * on disconnection. Like any GATT server with bonding, the subscriptions of a bonded
+ * central are kept (in NVS, next to the bonding keys) and restored when it reconnects:
+ * many centrals don't write the CCCD again. */
+static void cccd_key(const esp_bd_addr_t bda, char *key) {
+	for(uint8_t i = 0; i < sizeof(esp_bd_addr_t); i++){
+		sprintf(&key[2 * i], "%02x", bda[i]);
+	}
+}
+
+static bool is_bonded(const esp_bd_addr_t bda) {
+	int qty = esp_ble_get_bond_device_num();
+	esp_ble_bond_dev_t *list;
+	bool bonded = false;
+	if(qty <= 0){
+		return false;
+	}
+	/* up to CONFIG_BT_SMP_MAX_BONDS entries, too large for the stack task */
+	list = malloc(qty * sizeof(esp_ble_bond_dev_t));
+	if(list == NULL){
+		return false;
+	}
+	if(esp_ble_get_bond_device_list(&qty, list) == ESP_OK){
+		for(int i = 0; i < qty; i++){
+			if(memcmp(list[i].bd_addr, bda, sizeof(esp_bd_addr_t)) == 0){
+				bonded = true;
+				break;
+			}
+		}
+	}
+	free(list);
+	return bonded;
+}
+
+static void cccd_save(int8_t conn) {
+	nvs_handle_t nvs;
+	char key[CCCD_KEY_LEN];
+	if(!is_bonded(conn_tab[conn].bda)){
+		return;
+	}
+	if(nvs_open(CCCD_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK){
+		ESP_LOGE(TAG, "Subscriptions not saved, NVS not available");
+		return;
+	}
+	cccd_key(conn_tab[conn].bda, key);
+	if((nvs_set_u8(nvs, key, conn_tab[conn].cccd) != ESP_OK) || (nvs_commit(nvs) != ESP_OK)){
+		ESP_LOGE(TAG, "Subscriptions not saved");
+	}
+	nvs_close(nvs);
+}
+
+static void cccd_restore(int8_t conn) {
+	nvs_handle_t nvs;
+	char key[CCCD_KEY_LEN];
+	uint8_t cccd;
+	esp_err_t ret;
+	if(nvs_open(CCCD_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK){
+		/* nothing saved yet */
+		return;
+	}
+	cccd_key(conn_tab[conn].bda, key);
+	ret = nvs_get_u8(nvs, key, &cccd);
+	nvs_close(nvs);
+	if(ret != ESP_OK){
+		return;
+	}
+	conn_tab[conn].cccd = cccd;
+	BleOnSubscribe(conn, BLE_PORT_DATA, (cccd & (1 << BLE_PORT_DATA)) != 0);
+	BleOnSubscribe(conn, BLE_PORT_STREAM, (cccd & (1 << BLE_PORT_STREAM)) != 0);
+}
+
+static void cccd_forget(const esp_bd_addr_t bda) {
+	nvs_handle_t nvs;
+	char key[CCCD_KEY_LEN];
+	if(nvs_open(CCCD_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK){
+		return;
+	}
+	cccd_key(bda, key);
+	if(nvs_erase_key(nvs, key) == ESP_OK){
+		nvs_commit(nvs);
+	}
+	nvs_close(nvs);
+}
+
+static void cccd_write(int8_t conn, ble_port_char_t characteristic, const esp_ble_gatts_cb_param_t *param) {
+	bool enabled = (param->write.len > 0) && (param->write.value[0] & 0x01);
+	if(enabled){
+		conn_tab[conn].cccd |= (1 << characteristic);
+	}else{
+		conn_tab[conn].cccd &= ~(1 << characteristic);
+	}
+	conn_tab[conn].cccd_written = true;
+	BleOnSubscribe(conn, characteristic, enabled);
+	/* a central that isn't bonded yet is saved when the bonding ends */
+	cccd_save(conn);
+}
+
+static bool conn_slot_free(void) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(!conn_tab[conn].used){
+			return true;
+		}
+	}
+	return false;
+}
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+	static uint8_t adv_config_done = 0;
+	ble_conn_params_t params;
+	int8_t conn;
+	switch (event) {
+		case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
+			adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
+			if (adv_config_done == 0){
+				esp_ble_gap_start_advertising(&spp_adv_params);
+				BleOnAdvertising();
+			}
+			break;
+		case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+			adv_config_done &= (~ADV_CONFIG_FLAG);
+			if (adv_config_done == 0){
+				esp_ble_gap_start_advertising(&spp_adv_params);
+				BleOnAdvertising();
+			}
+			break;
+		case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+			//advertising start complete event to indicate advertising start successfully or failed
+			if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+				ESP_LOGE(__FUNCTION__, "advertising start failed, error status = %x", param->adv_start_cmpl.status);
+				break;
+			}
+			ESP_LOGI(TAG, "Advertising start");
+			break;
+		case ESP_GAP_BLE_PASSKEY_REQ_EVT:							/* passkey request event */
+			
+            break;
+		case ESP_GAP_BLE_OOB_REQ_EVT: {
+			uint8_t tk[16] = {1};   //If you paired with OOB, both devices need to use the same tk
+			esp_ble_oob_req_reply(param->ble_security.ble_req.bd_addr, tk, sizeof(tk));
+			break;
+		}
+		case ESP_GAP_BLE_LOCAL_IR_EVT:								 /* BLE local IR event */
+			
+			break;
+		case ESP_GAP_BLE_LOCAL_ER_EVT:								 /* BLE local ER event */
+
+			break;
+		case ESP_GAP_BLE_NC_REQ_EVT:
+			/* The app will receive this evt when the IO has DisplayYesNO capability and the peer device IO also has DisplayYesNo capability.
+			show the passkey number to the user to confirm it with the number displayed by peer device. */
+			esp_ble_confirm_reply(param->ble_security.ble_req.bd_addr, true);
+			//ESP_LOGI(__FUNCTION__, "ESP_GAP_BLE_NC_REQ_EVT, the passkey Notify number:%"PRIu32, param->ble_security.key_notif.passkey);
+			break;
+		case ESP_GAP_BLE_SEC_REQ_EVT:
+			/* send the positive(true) security response to the peer device to accept the security request.
+			If not accept the security request, should send the security response with negative(false) accept value*/
+			esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+			break;
+		case ESP_GAP_BLE_PASSKEY_NOTIF_EVT:  
+
+			break;
+		case ESP_GAP_BLE_KEY_EVT:
+
+			break;
+		case ESP_GAP_BLE_AUTH_CMPL_EVT: {
+			conn = conn_by_bda(param->ble_security.auth_cmpl.bd_addr);
+			if(conn >= 0){
+				if(param->ble_security.auth_cmpl.success){
+					if(conn_tab[conn].cccd_written){
+						/* first bonding, the central subscribed before it ended */
+						cccd_save(conn);
+					}else{
+						cccd_restore(conn);
+					}
+				}
+				BleOnSecured(conn);
+			}
+			break;
+	}
+	case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+		if(param->update_conn_params.status != ESP_BT_STATUS_SUCCESS){
+			ESP_LOGW(TAG, "Connection update rejected, status = %x", param->update_conn_params.status);
+			break;
+		}
+		conn = conn_by_bda(param->update_conn_params.bda);
+		if(conn < 0){
+			break;
+		}
+		params.interval = param->update_conn_params.conn_int;
+		params.latency = param->update_conn_params.latency;
+		params.timeout = param->update_conn_params.timeout;
+		BleOnConnParams(conn, &params);
+		break;
+	case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+		ESP_LOGI(TAG, "Data length: rx %d bytes, tx %d bytes", param->pkt_data_length_cmpl.params.rx_len,
+			param->pkt_data_length_cmpl.params.tx_len);
+		break;
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+		ESP_LOGI(TAG, "PHY: tx %d, rx %d (1: 1M, 2: 2M, 3: coded)", param->phy_update.tx_phy, param->phy_update.rx_phy);
+		break;
+#endif
+	case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT: {
+		ESP_LOGD(__FUNCTION__, "ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT status = %d", param->remove_bond_dev_cmpl.status);
+		cccd_forget(param->remove_bond_dev_cmpl.bd_addr);
+		ESP_LOGI(__FUNCTION__, "ESP_GAP_BLE_REMOVE_BOND_DEV");
+		ESP_LOGI(__FUNCTION__, "-----ESP_GAP_BLE_REMOVE_BOND_DEV----");
+		esp_log_buffer_hex(__FUNCTION__, (void *)param->remove_bond_dev_cmpl.bd_addr, sizeof(esp_bd_addr_t));
+		ESP_LOGI(__FUNCTION__, "------------------------------------");
+		break;
+	}
+	case ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT:
+		if (param->local_privacy_cmpl.status != ESP_BT_STATUS_SUCCESS){
+			ESP_LOGE(__FUNCTION__, "config local privacy failed, error status = %x", param->local_privacy_cmpl.status);
+			break;
+		}
+		esp_err_t ret = esp_ble_gap_config_adv_data(&spp_adv_config);
+		if (ret){
+			ESP_LOGE(__FUNCTION__, "config adv data failed, error code = %x", ret);
+		}else{
+			adv_config_done |= ADV_CONFIG_FLAG;
+		}
+		ret = esp_ble_gap_config_adv_data(&spp_scan_rsp_config);
+		if (ret){
+			ESP_LOGE(__FUNCTION__, "config adv data failed, error code = %x", ret);
+		}else{
+			adv_config_done |= SCAN_RSP_CONFIG_FLAG;
+		}
+		break;
+	default:
+		break;
+	}
+}
+/* Assembles a prepared (long) write, delivered on ESP_GATTS_EXEC_WRITE_EVT */
+static void prepare_write(esp_gatt_if_t gatts_if, int8_t conn, esp_ble_gatts_cb_param_t *param) {
+	esp_gatt_status_t result = ESP_GATT_OK;
+	static esp_gatt_rsp_t rsp;		/* Too large for the stack task, only used from it */
+	if((prep_len > 0) && (prep_conn != conn)){
+		/* one long write at a time, the other central retries */
+		result = ESP_GATT_PREPARE_Q_FULL;
+	}else if(param->write.offset > BLE_RX_MAX_LEN){
+		result = ESP_GATT_INVALID_OFFSET;
+	}else if(param->write.offset + param->write.len > BLE_RX_MAX_LEN){
+		result = ESP_GATT_INVALID_ATTR_LEN;
+	}else{
+		memcpy(&prep_buf[param->write.offset], param->write.value, param->write.len);
+		prep_conn = conn;
+		if(param->write.offset + param->write.len > prep_len){
+			prep_len = param->write.offset + param->write.len;
+		}
+	}
+	if(param->write.need_rsp){
+		/* the prepare write response echoes the received value */
+		rsp.attr_value.handle = param->write.handle;
+		rsp.attr_value.offset = param->write.offset;
+		rsp.attr_value.len = param->write.len;
+		rsp.attr_value.auth_req = 0;
+		memcpy(rsp.attr_value.value, param->write.value, param->write.len);
+		esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, result, &rsp);
+	}
+}
+
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
+										esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+    esp_ble_gatts_cb_param_t *p_data = (esp_ble_gatts_cb_param_t *) param;
+	ble_conn_params_t params;
+	int8_t conn;
+
+	switch (event) {
+		case ESP_GATTS_REG_EVT:
+			esp_ble_gap_set_device_name(device_name);
+			//generate a resolvable random address
+			esp_ble_gap_config_local_privacy(true);
+			esp_ble_gap_config_adv_data_raw((uint8_t *)spp_adv_data, sizeof(spp_adv_data));
+			esp_ble_gatts_create_attr_tab(spp_gatt_db, gatts_if, SPP_IDX_NB, SPP_SVC_INST_ID);
+			break;
+		case ESP_GATTS_READ_EVT:
+			break;
+		case ESP_GATTS_WRITE_EVT:
+			conn = conn_by_id(param->write.conn_id);
+			if(conn < 0){
+				break;
+			}
+			if(param->write.handle == spp_handle_table[SPP_IDX_STREAM_CFG]){
+				cccd_write(conn, BLE_PORT_STREAM, param);
+				break;
+			}
+			if(param->write.handle == spp_handle_table[SPP_IDX_SPP_DATA_NOTIFY_CFG]){
+				cccd_write(conn, BLE_PORT_DATA, param);
+				break;
+			}
+			if((param->write.handle != spp_handle_table[SPP_IDX_SPP_DATA_NOTIFY_VAL]) &&
+					(param->write.handle != spp_handle_table[SPP_IDX_SPP_DATA_RECV_VAL])){
+				break;
+			}
+			if(param->write.is_prep){
+				prepare_write(gatts_if, conn, param);
+			}else{
+				BleOnWrite(param->write.value, param->write.len);
+			}
+			break;
+		case ESP_GATTS_EXEC_WRITE_EVT:
+			if((prep_len > 0) && (prep_conn != conn_by_id(param->exec_write.conn_id))){
+				/* not the central the long write belongs to */
+				esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id, param->exec_write.trans_id, ESP_GATT_OK, NULL);
+				break;
+			}
+			if((param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC) && (prep_len > 0)){
+				BleOnWrite(prep_buf, prep_len);
+			}
+			prep_len = 0;
+			esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id, param->exec_write.trans_id, ESP_GATT_OK, NULL);
+			break;
+		case ESP_GATTS_MTU_EVT:
+			conn = conn_by_id(param->mtu.conn_id);
+			if(conn >= 0){
+				BleOnMtu(conn, param->mtu.mtu);
+			}
+			break;
+		case ESP_GATTS_CONF_EVT:
+			break;
+		case ESP_GATTS_UNREG_EVT:
+			break;
+		case ESP_GATTS_DELETE_EVT:
+			break;
+		case ESP_GATTS_START_EVT:
+			break;
+		case ESP_GATTS_STOP_EVT:
+			break;
+		case ESP_GATTS_CONNECT_EVT:
+			conn = conn_alloc(p_data->connect.conn_id, param->connect.remote_bda);
+			if(conn < 0){
+				/* more centrals than BLE_MAX_CONN */
+				esp_ble_gatts_close(gatts_if, p_data->connect.conn_id);
+				break;
+			}
+			spp_gatts_if = gatts_if;
+			/* start security connect with peer device when receive the connect event sent by the master */
+			esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_MITM);
+			/* ask for the largest LL payload and the 2M PHY, the central may refuse both */
+			esp_ble_gap_set_pkt_data_len(param->connect.remote_bda, BLE_DLE_TX_OCTETS);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+			esp_ble_gap_set_preferred_phy(param->connect.remote_bda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+				ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+			params.interval = param->connect.conn_params.interval;
+			params.latency = param->connect.conn_params.latency;
+			params.timeout = param->connect.conn_params.timeout;
+			BleOnConnect(conn, &params);
+			/* advertising stops on every connection, keep it on while there are free slots */
+			if(conn_slot_free()){
+				esp_ble_gap_start_advertising(&spp_adv_params);
+			}
+			break;
+		case ESP_GATTS_DISCONNECT_EVT:
+			conn = conn_by_id(param->disconnect.conn_id);
+			if(conn < 0){
+				break;
+			}
+			conn_tab[conn].used = false;
+			if(prep_conn == conn){
+				prep_len = 0;
+			}
+			BleOnDisconnect(conn);
+			/* start advertising again when missing the connect */
+			esp_ble_gap_start_advertising(&spp_adv_params);
+			break;
+		case ESP_GATTS_OPEN_EVT:
+			break;
+		case ESP_GATTS_CANCEL_OPEN_EVT:
+			break;
+		case ESP_GATTS_CLOSE_EVT:
+			break;
+		case ESP_GATTS_LISTEN_EVT:
+			break;
+		case ESP_GATTS_CONGEST_EVT:
+			conn = conn_by_id(param->congest.conn_id);
+			if(conn >= 0){
+				BleOnCongest(conn, param->congest.congested);
+			}
+			break;
+		case ESP_GATTS_CREAT_ATTR_TAB_EVT: {
+			if (param->create.status == ESP_GATT_OK){
+				if(param->add_attr_tab.num_handle == SPP_IDX_NB) {
+					memcpy(spp_handle_table, param->add_attr_tab.handles,
+					sizeof(spp_handle_table));
+					esp_ble_gatts_start_service(spp_handle_table[SPP_IDX_SVC]);
+				}else{
+					ESP_LOGE(__FUNCTION__, "Create attribute table abnormally, num_handle (%d) doesn't equal to SPP_IDX_NB(%d)",
+						param->add_attr_tab.num_handle, SPP_IDX_NB);
+				}
+			}else{
+				ESP_LOGE(__FUNCTION__, " Create attribute table failed, error code = %x", param->create.status);
+			}
+		break;
+	}
+		default:
+		   break;
+	}
+}
+
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+								esp_ble_gatts_cb_param_t *param) {
+	/* If event is register event, store the gatts_if for each profile */
+	if (event == ESP_GATTS_REG_EVT) {
+		if (param->reg.status == ESP_GATT_OK) {
+			spp_profile_tab[SPP_PROFILE_APP_IDX].gatts_if = gatts_if;
+		} else {
+			return;
+		}
+	}
+	do {
+		int idx;
+		for (idx = 0; idx < SPP_PROFILE_NUM; idx++) {
+			if (gatts_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
+					gatts_if == spp_profile_tab[idx].gatts_if) {
+				if (spp_profile_tab[idx].gatts_cb) {
+					spp_profile_tab[idx].gatts_cb(event, gatts_if, param);
+				}
+			}
+		}
+	} while (0);
+}
+/*==================[external functions definition]==========================*/
+bool BlePortInit(const char *name, uint16_t mtu){
+	esp_err_t ret;
+	device_name = name;
+	ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+	esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+	ret = esp_bt_controller_init(&bt_cfg);
+	if (ret) {
+		ESP_LOGE(TAG, "%s init controller failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+	if (ret) {
+		ESP_LOGE(TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bluedroid_init();
+	if (ret) {
+		ESP_LOGE(TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_bluedroid_enable();
+	if (ret) {
+		ESP_LOGE(TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ret = esp_ble_gatts_register_callback(gatts_event_handler);
+	if (ret){
+		ESP_LOGE(TAG, "gatts register error, error code = %x", ret);
+		return false;
+	}
+	ret = esp_ble_gap_register_callback(gap_event_handler);
+	if (ret){
+		ESP_LOGE(TAG, "gap register error, error code = %x", ret);
+		return false;
+	}
+	ret = esp_ble_gatts_app_register(ESP_SPP_APP_ID);
+	if (ret){
+		ESP_LOGE(TAG, "gatts app register error, error code = %x", ret);
+		return false;
+	}
+	/* the central starts the MTU exchange, this sets the value offered in the response */
+	ret = esp_ble_gatt_set_local_mtu(mtu);
+	if (ret){
+		ESP_LOGE(TAG, "set local MTU failed, error code = %x", ret);
+	}
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	esp_ble_gap_set_preferred_default_phy(ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK);
+#endif
+	/* set the security iocap & auth_req & key size & init key response key parameters to the stack*/
+	esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;		//bonding with peer device after authentication
+	esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;			//set the IO capability to No output No input
+	uint8_t key_size = 16;		//the key size should be 7~16 bytes
+	uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+	uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+	//set static passkey
+	uint32_t passkey = 123456;
+	uint8_t auth_option = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_DISABLE;
+	uint8_t oob_support = ESP_BLE_OOB_DISABLE;
+	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey, sizeof(uint32_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, &auth_option, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_OOB_SUPPORT, &oob_support, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
+	esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+	return true;
+}
+
+ble_port_result_t BlePortNotify(uint8_t conn, ble_port_char_t characteristic, const uint8_t *data, uint16_t length){
+	uint16_t handle = spp_handle_table[(characteristic == BLE_PORT_STREAM) ? SPP_IDX_STREAM_VAL : SPP_IDX_SPP_DATA_NOTIFY_VAL];
+	if(!conn_tab[conn].used){
+		return BLE_PORT_ERROR;
+	}
+	/* Bluedroid copies the value, congestion is reported apart with ESP_GATTS_CONGEST_EVT */
+	if(esp_ble_gatts_send_indicate(spp_gatts_if, conn_tab[conn].conn_id, handle, length, (uint8_t *)data, false) != ESP_OK){
+		return BLE_PORT_ERROR;
+	}
+	return BLE_PORT_OK;
+}
+
+bool BlePortUpdateConnParams(uint8_t conn, const ble_conn_req_t *req){
+	esp_ble_conn_update_params_t params = {
+		.min_int = req->min_int,
+		.max_int = req->max_int,
+		.latency = req->latency,
+		.timeout = req->timeout,
+	};
+	memcpy(params.bda, conn_tab[conn].bda, sizeof(esp_bd_addr_t));
+	return esp_ble_gap_update_conn_params(&params) == ESP_OK;
+}
+/*==================[end of file]============================================*/
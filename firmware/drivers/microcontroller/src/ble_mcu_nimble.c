@@ -0,0 +1,379 @@
+/**
+ * @file ble_mcu_nimble.c
+ * @brief NimBLE host glue of the BLE driver (see ble_mcu_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_mcu_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+/*==================[macros and definitions]=================================*/
+#define TAG "ble_mcu"
+#define BLE_DLE_TX_TIME			2120	/* Air time of a 251 bytes LL PDU on the 1M PHY (us) */
+/* Same service and characteristics than the Bluedroid backend */
+#define UUID_SPP_SERVICE		0xFFE0	/* Service ID */
+#define UUID_SPP_DATA			0xFFE1	/* Characteristic ID */
+#define UUID_SENSOR_STREAM		0xFFE2	/* Binary sample stream characteristic ID */
+/*==================[typedef]================================================*/
+
+/*==================[internal data declaration]==============================*/
+static const char * device_name;						/* Device name */
+static uint8_t own_addr_type;
+static uint16_t conn_handles[BLE_MAX_CONN];				/* Connections, by the index known to the core */
+static uint16_t data_handle;							/* Value handles, filled by ble_gatts_add_svcs */
+static uint16_t stream_handle;
+static volatile bool tx_busy[BLE_MAX_CONN];				/* A notification found no free mbuf */
+static uint8_t rx_flat[BLE_RX_MAX_LEN];					/* Long writes, that arrive as an mbuf chain */
+
+/*==================[internal functions declaration]=========================*/
+static int gatt_access_cb(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+void ble_store_config_init(void);
+/*==================[internal data definition]===============================*/
+static const ble_uuid16_t adv_uuids[] = {BLE_UUID16_INIT(UUID_SPP_SERVICE)};
+/* GATT database */
+static const struct ble_gatt_svc_def gatt_svcs[] = {
+	{
+		.type = BLE_GATT_SVC_TYPE_PRIMARY,
+		.uuid = BLE_UUID16_DECLARE(UUID_SPP_SERVICE),
+		.characteristics = (struct ble_gatt_chr_def[]) {
+			{
+				/* serial data, written by the central and notified by the device */
+				.uuid = BLE_UUID16_DECLARE(UUID_SPP_DATA),
+				.access_cb = gatt_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_NOTIFY,
+				.val_handle = &data_handle,
+			}, {
+				/* binary sample stream */
+				.uuid = BLE_UUID16_DECLARE(UUID_SENSOR_STREAM),
+				.access_cb = gatt_access_cb,
+				.flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+				.val_handle = &stream_handle,
+			}, {
+				0,		/* No more characteristics */
+			}
+		},
+	}, {
+		0,				/* No more services */
+	},
+};
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+/* Index of a connection handle, -1 if unknown (BLE_HS_CONN_HANDLE_NONE finds a free slot) */
+static int8_t conn_index(uint16_t handle) {
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		if(conn_handles[conn] == handle){
+			return conn;
+		}
+	}
+	return -1;
+}
+
+static int gatt_access_cb(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+	struct os_mbuf *om = ctxt->om;
+	uint16_t length;
+	switch(ctxt->op){
+		case BLE_GATT_ACCESS_OP_READ_CHR:
+			/* values are only notified, reads get an empty value */
+			return 0;
+		case BLE_GATT_ACCESS_OP_WRITE_CHR:
+			if(attr_handle != data_handle){
+				return BLE_ATT_ERR_UNLIKELY;
+			}
+			length = OS_MBUF_PKTLEN(om);
+			if(length > BLE_RX_MAX_LEN){
+				return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+			}
+			if(om->om_len == length){
+				/* single buffer: straight from the stack to the RX ring */
+				BleOnWrite(om->om_data, length);
+			}else{
+				/* NimBLE reassembles long writes as an mbuf chain */
+				ble_hs_mbuf_to_flat(om, rx_flat, sizeof(rx_flat), &length);
+				BleOnWrite(rx_flat, length);
+			}
+			return 0;
+		default:
+			return BLE_ATT_ERR_UNLIKELY;
+	}
+}
+
+static void advertise(void) {
+	struct ble_hs_adv_fields fields;
+	struct ble_gap_adv_params adv_params;
+	int rc;
+
+	memset(&fields, 0, sizeof(fields));
+	fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+	fields.tx_pwr_lvl_is_present = 1;
+	fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+	fields.uuids16 = adv_uuids;
+	fields.num_uuids16 = 1;
+	fields.uuids16_is_complete = 1;
+	rc = ble_gap_adv_set_fields(&fields);
+	if(rc != 0){
+		ESP_LOGE(TAG, "config adv data failed, error code = %d", rc);
+		return;
+	}
+	/* the name goes in the scan response, as with Bluedroid */
+	memset(&fields, 0, sizeof(fields));
+	fields.name = (const uint8_t *)device_name;
+	fields.name_len = strlen(device_name);
+	fields.name_is_complete = 1;
+	rc = ble_gap_adv_rsp_set_fields(&fields);
+	if(rc != 0){
+		ESP_LOGE(TAG, "config scan response failed, error code = %d", rc);
+		return;
+	}
+	memset(&adv_params, 0, sizeof(adv_params));
+	adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+	adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+	adv_params.itvl_min = 0x20;
+	adv_params.itvl_max = 0x40;
+	rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, gap_event_handler, NULL);
+	if(rc != 0){
+		ESP_LOGE(TAG, "advertising start failed, error code = %d", rc);
+		return;
+	}
+	ESP_LOGI(TAG, "Advertising start");
+}
+
+/* Connection parameters in use, in Bluetooth units */
+static bool get_conn_params(uint16_t handle, ble_conn_params_t *params) {
+	struct ble_gap_conn_desc desc;
+	if(ble_gap_conn_find(handle, &desc) != 0){
+		return false;
+	}
+	params->interval = desc.conn_itvl;
+	params->latency = desc.conn_latency;
+	params->timeout = desc.supervision_timeout;
+	return true;
+}
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg) {
+	struct ble_gap_conn_desc desc;
+	ble_conn_params_t params;
+	uint16_t handle;
+	int8_t conn;
+	int rc;
+	switch(event->type){
+		case BLE_GAP_EVENT_CONNECT:
+			if(event->connect.status != 0){
+				advertise();
+				break;
+			}
+			handle = event->connect.conn_handle;
+			conn = conn_index(BLE_HS_CONN_HANDLE_NONE);
+			if(conn < 0){
+				/* more centrals than BLE_MAX_CONN: HCI Disconnect only takes the "remote
+				 * terminated" reasons, 0x14 is the one for lack of resources */
+				rc = ble_gap_terminate(handle, BLE_ERR_RD_CONN_TERM_RESRCS);
+				if(rc != 0){
+					ESP_LOGE(TAG, "Extra central not disconnected, error code = %d", rc);
+				}
+				break;
+			}
+			conn_handles[conn] = handle;
+			tx_busy[conn] = false;
+			/* start security, and ask for the largest LL payload and the 2M PHY: the central may refuse both */
+			ble_gap_security_initiate(handle);
+			ble_gap_set_data_len(handle, BLE_DLE_TX_OCTETS, BLE_DLE_TX_TIME);
+#if CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT
+			ble_gap_set_prefered_le_phy(handle, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK,
+				BLE_GAP_LE_PHY_CODED_ANY);
+#endif
+			get_conn_params(handle, &params);
+			BleOnConnect(conn, &params);
+			/* advertising stops on every connection, keep it on while there are free slots */
+			if(conn_index(BLE_HS_CONN_HANDLE_NONE) >= 0){
+				advertise();
+			}
+			break;
+		case BLE_GAP_EVENT_DISCONNECT:
+			conn = conn_index(event->disconnect.conn.conn_handle);
+			if(conn < 0){
+				break;
+			}
+			conn_handles[conn] = BLE_HS_CONN_HANDLE_NONE;
+			tx_busy[conn] = false;
+			BleOnDisconnect(conn);
+			/* start advertising again when missing the connect */
+			if(!ble_gap_adv_active()){
+				advertise();
+			}
+			break;
+		case BLE_GAP_EVENT_ADV_COMPLETE:
+			if(conn_index(BLE_HS_CONN_HANDLE_NONE) >= 0){
+				advertise();
+			}
+			break;
+		case BLE_GAP_EVENT_ENC_CHANGE:
+			if(event->enc_change.status != 0){
+				ESP_LOGW(TAG, "Encryption failed, status = %x", event->enc_change.status);
+				break;
+			}
+			conn = conn_index(event->enc_change.conn_handle);
+			if(conn >= 0){
+				BleOnSecured(conn);
+			}
+			break;
+		case BLE_GAP_EVENT_REPEAT_PAIRING:
+			/* the central lost its keys: forget the old bond and pair again */
+			if(ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0){
+				ble_store_util_delete_peer(&desc.peer_id_addr);
+			}
+			return BLE_GAP_REPEAT_PAIRING_RETRY;
+		case BLE_GAP_EVENT_CONN_UPDATE:
+			if(event->conn_update.status != 0){
+				ESP_LOGW(TAG, "Connection update rejected, status = %x", event->conn_update.status);
+				break;
+			}
+			conn = conn_index(event->conn_update.conn_handle);
+			if((conn >= 0) && get_conn_params(event->conn_update.conn_handle, &params)){
+				BleOnConnParams(conn, &params);
+			}
+			break;
+		case BLE_GAP_EVENT_MTU:
+			conn = conn_index(event->mtu.conn_handle);
+			if(conn >= 0){
+				BleOnMtu(conn, event->mtu.value);
+			}
+			break;
+		case BLE_GAP_EVENT_SUBSCRIBE:
+			conn = conn_index(event->subscribe.conn_handle);
+			if(conn < 0){
+				break;
+			}
+			if(event->subscribe.attr_handle == stream_handle){
+				BleOnSubscribe(conn, BLE_PORT_STREAM, event->subscribe.cur_notify);
+			}else if(event->subscribe.attr_handle == data_handle){
+				BleOnSubscribe(conn, BLE_PORT_DATA, event->subscribe.cur_notify);
+			}
+			break;
+		case BLE_GAP_EVENT_NOTIFY_TX:
+			/* an mbuf was released, the send task can try again */
+			conn = conn_index(event->notify_tx.conn_handle);
+			if((conn >= 0) && tx_busy[conn]){
+				tx_busy[conn] = false;
+				BleOnCongest(conn, false);
+			}
+			break;
+		default:
+			break;
+	}
+	return 0;
+}
+
+static void on_reset(int reason) {
+	ESP_LOGE(TAG, "Host reset, reason = %d", reason);
+}
+
+static void on_sync(void) {
+	ble_hs_util_ensure_addr(0);
+	ble_hs_id_infer_auto(0, &own_addr_type);
+#if CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT
+	ble_gap_set_prefered_default_le_phy(BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK);
+#endif
+	advertise();
+	BleOnAdvertising();
+}
+
+static void host_task(void *param) {
+	/* returns only when the host is stopped */
+	nimble_port_run();
+	nimble_port_freertos_deinit();
+}
+
+/*==================[external functions definition]==========================*/
+bool BlePortInit(const char *name, uint16_t mtu){
+	esp_err_t ret;
+	int rc;
+	device_name = name;
+	for(uint8_t conn = 0; conn < BLE_MAX_CONN; conn++){
+		conn_handles[conn] = BLE_HS_CONN_HANDLE_NONE;
+	}
+	/* initializes the controller too */
+	ret = nimble_port_init();
+	if (ret) {
+		ESP_LOGE(TAG, "%s init nimble failed: %s", __func__, esp_err_to_name(ret));
+		return false;
+	}
+	ble_hs_cfg.reset_cb = on_reset;
+	ble_hs_cfg.sync_cb = on_sync;
+	ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+	/* same security than the Bluedroid backend: secure connections and bonding, no IO */
+	ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO;
+	ble_hs_cfg.sm_bonding = 1;
+	ble_hs_cfg.sm_mitm = 1;
+	ble_hs_cfg.sm_sc = 1;
+	ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+	ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+
+	ble_svc_gap_init();
+	ble_svc_gatt_init();
+	rc = ble_gatts_count_cfg(gatt_svcs);
+	if(rc == 0){
+		rc = ble_gatts_add_svcs(gatt_svcs);
+	}
+	if(rc != 0){
+		ESP_LOGE(TAG, "gatts register error, error code = %d", rc);
+		return false;
+	}
+	ble_svc_gap_device_name_set(name);
+	/* the central starts the MTU exchange, this sets the value offered in the response */
+	rc = ble_att_set_preferred_mtu(mtu);
+	if(rc != 0){
+		ESP_LOGE(TAG, "set local MTU failed, error code = %d", rc);
+	}
+	/* bonding keys in NVS */
+	ble_store_config_init();
+	nimble_port_freertos_init(host_task);
+	return true;
+}
+
+ble_port_result_t BlePortNotify(uint8_t conn, ble_port_char_t characteristic, const uint8_t *data, uint16_t length){
+	struct os_mbuf *om;
+	int rc;
+	if(conn_handles[conn] == BLE_HS_CONN_HANDLE_NONE){
+		return BLE_PORT_ERROR;
+	}
+	/* NimBLE has no congestion event: running out of mbufs is the congestion */
+	om = ble_hs_mbuf_from_flat(data, length);
+	if(om == NULL){
+		tx_busy[conn] = true;
+		return BLE_PORT_BUSY;
+	}
+	/* the stack frees om, also on error */
+	rc = ble_gatts_notify_custom(conn_handles[conn], (characteristic == BLE_PORT_STREAM) ? stream_handle : data_handle, om);
+	if(rc == BLE_HS_ENOMEM){
+		tx_busy[conn] = true;
+		return BLE_PORT_BUSY;
+	}
+	return (rc == 0) ? BLE_PORT_OK : BLE_PORT_ERROR;
+}
+
+bool BlePortUpdateConnParams(uint8_t conn, const ble_conn_req_t *req){
+	struct ble_gap_upd_params params = {
+		.itvl_min = req->min_int,
+		.itvl_max = req->max_int,
+		.latency = req->latency,
+		.supervision_timeout = req->timeout,
+	};
+	return ble_gap_update_params(conn_handles[conn], &params) == 0;
+}
+/*==================[end of file]============================================*/
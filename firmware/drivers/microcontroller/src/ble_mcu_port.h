@@ -0,0 +1,75 @@
+#ifndef BLE_MCU_PORT_H
+#define BLE_MCU_PORT_H
+/**
+ * @file ble_mcu_port.h
+ * @brief Internal interface between the ble_mcu core and the Bluetooth host stack.
+ *
+ * ble_mcu.c (buffers, tasks and public API) doesn't depend on the host stack.
+ * The stack glue lives in ble_mcu_bluedroid.c or ble_mcu_nimble.c, only one of
+ * them is compiled, selected by CONFIG_BT_BLUEDROID_ENABLED / CONFIG_BT_NIMBLE_ENABLED.
+ *
+ * - BlePort* functions are implemented by the backend and called by the core.
+ * - BleOn* functions are implemented by the core and called by the backend from
+ *   the stack context, they must not block.
+ * - Up to BLE_MAX_CONN centrals can be connected at the same time, the backend
+ *   maps its own connection handles to indexes 0 to BLE_MAX_CONN - 1.
+ *
+ * Not part of the driver API, applications must use ble_mcu.h.
+ *
+ * @version 0.1
+ * @date 19/10/2026
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "ble_mcu.h"
+#include <stdint.h>
+#include <stdbool.h>
+/*==================[macros]=================================================*/
+#define BLE_MTU_DEFAULT		23	 /* ATT MTU before negotiation (BLE 4.0 minimum) */
+#define BLE_MTU_REQUEST		247	 /* ATT MTU requested: 247 + 4 bytes of L2CAP header fill one 251 bytes LL PDU */
+#define BLE_ATT_HDR_SIZE	3	 /* Opcode + handle prepended by ATT to every notification */
+#define BLE_DLE_TX_OCTETS	251	 /* LE Data Length Extension: maximum LL payload */
+/*==================[typedef]================================================*/
+/** @brief Notifying characteristics of the service */
+typedef enum {
+	BLE_PORT_DATA,		/*!< Serial data characteristic (0xFFE1) */
+	BLE_PORT_STREAM,	/*!< Sensor stream characteristic (0xFFE2) */
+} ble_port_char_t;
+
+/** @brief Result of a notification */
+typedef enum {
+	BLE_PORT_OK,		/*!< Handed to the stack */
+	BLE_PORT_BUSY,		/*!< No stack buffers available now, retry after BleOnCongest(false) */
+	BLE_PORT_ERROR,		/*!< Rejected by the stack */
+} ble_port_result_t;
+
+/** @brief Connection parameters requested to the central */
+typedef struct {
+	uint16_t min_int;	/*!< Minimum connection interval (1.25 ms units) */
+	uint16_t max_int;	/*!< Maximum connection interval (1.25 ms units) */
+	uint16_t latency;	/*!< Peripheral latency (connection events) */
+	uint16_t timeout;	/*!< Supervision timeout (10 ms units) */
+} ble_conn_req_t;
+/*==================[external functions declaration]=========================*/
+/* Implemented by the backend. conn is the index (0 to BLE_MAX_CONN - 1) the backend 
+ * gave to the connection in BleOnConnect */
+bool BlePortInit(const char *device_name, uint16_t mtu);
+ble_port_result_t BlePortNotify(uint8_t conn, ble_port_char_t characteristic, const uint8_t *data, uint16_t length);
+bool BlePortUpdateConnParams(uint8_t conn, const ble_conn_req_t *req);
+
+/* Implemented by the core */
+void BleOnAdvertising(void);
+void BleOnConnect(uint8_t conn, const ble_conn_params_t *params);
+void BleOnSecured(uint8_t conn);
+void BleOnDisconnect(uint8_t conn);
+void BleOnMtu(uint8_t conn, uint16_t mtu);
+void BleOnCongest(uint8_t conn, bool congested);
+void BleOnWrite(const uint8_t *data, uint16_t length);
+void BleOnSubscribe(uint8_t conn, ble_port_char_t characteristic, bool enabled);
+void BleOnConnParams(uint8_t conn, const ble_conn_params_t *params);
+
+#endif /* BLE_MCU_PORT_H */
+/*==================[end of file]============================================*/
@@ -17,10 +17,17 @@
 #include "driver/gpio.h"
 #include "driver/dedic_gpio.h"
 /*==================[macros and definitions]=================================*/
-
+struct gpio_fast_bundle_s{
+	dedic_gpio_bundle_handle_t handle;	/*!< Dedicated GPIO bundle */
+	uint32_t mask;						/*!< Mask of all bundle channels */
+	uint8_t data_qty;					/*!< Data lines (parallel bus only) */
+	uint32_t strobe_mask[GPIO_FAST_MAX_PINS];	/*!< Port mask of each strobe line (parallel bus only) */
+	uint8_t strobe_qty;					/*!< Strobe lines (parallel bus only) */
+	bool in_use;						/*!< Slot in use */
+};
 /*==================[internal data declaration]==============================*/
-dedic_gpio_bundle_handle_t bundleA = NULL;
-int bundleA_gpios[16];
+static struct gpio_fast_bundle_s fast_bundles[GPIO_FAST_BUNDLE_QTY];
+gpio_fast_bundle_t bundleA = NULL;
 /*==================[internal functions declaration]=========================*/
 
 /*==================[internal data definition]===============================*/
@@ -32,27 +39,118 @@ int bundleA_gpios[16];
 /*==================[external functions definition]==========================*/
 
 void GPIOFastInit(gpio_t *pin_list, uint8_t pin_qty){
-    memcpy(bundleA_gpios, pin_list, pin_qty);
+    bundleA = GPIOFastBundleNew(pin_list, pin_qty, GPIO_OUTPUT);
+}
+
+void GPIOFastWrite(uint16_t value){
+    if(bundleA == NULL){
+        return;
+    }
+    dedic_gpio_bundle_write(bundleA->handle, bundleA->mask, value);
+}
+
+gpio_fast_bundle_t GPIOFastBundleNew(gpio_t *pin_list, uint8_t pin_qty, io_t io){
+    int gpios[GPIO_FAST_MAX_PINS];
+    gpio_fast_bundle_t bundle = NULL;
+    if((pin_qty == 0) || (pin_qty > GPIO_FAST_MAX_PINS)){
+        return NULL;
+    }
+    for (int i = 0; i < GPIO_FAST_BUNDLE_QTY; i++) {
+        if(!fast_bundles[i].in_use){
+            bundle = &fast_bundles[i];
+            break;
+        }
+    }
+    if(bundle == NULL){
+        return NULL;
+    }
     gpio_config_t io_conf = {
-        .mode = GPIO_MODE_OUTPUT,
+        .mode = (io == GPIO_OUTPUT) ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT,
+        .pull_up_en = (io == GPIO_OUTPUT) ? GPIO_PULLUP_DISABLE : GPIO_PULLUP_ENABLE,
     };
     for (int i = 0; i < pin_qty; i++) {
-        io_conf.pin_bit_mask = 1ULL << bundleA_gpios[i];
+        gpios[i] = pin_list[i];
+        io_conf.pin_bit_mask = 1ULL << gpios[i];
         gpio_config(&io_conf);
     }
-    // Create bundleA, output only
-    dedic_gpio_bundle_config_t bundleA_config = {
-        .gpio_array = bundleA_gpios,
+    dedic_gpio_bundle_config_t bundle_config = {
+        .gpio_array = gpios,
         .array_size = pin_qty,
         .flags = {
-            .out_en = 1,
+            .in_en = (io == GPIO_INPUT),
+            .out_en = (io == GPIO_OUTPUT),
         },
     };
-    ESP_ERROR_CHECK(dedic_gpio_new_bundle(&bundleA_config, &bundleA));
+    if(dedic_gpio_new_bundle(&bundle_config, &bundle->handle) != ESP_OK){
+        return NULL;
+    }
+    bundle->mask = (1UL << pin_qty) - 1;
+    bundle->data_qty = 0;
+    bundle->strobe_qty = 0;
+    bundle->in_use = true;
+    return bundle;
 }
 
-void GPIOFastWrite(uint16_t value){
-    dedic_gpio_bundle_write(bundleA, 0xFF, value);
+void GPIOFastBundleDelete(gpio_fast_bundle_t bundle){
+    if(bundle == NULL){
+        return;
+    }
+    dedic_gpio_del_bundle(bundle->handle);
+    bundle->in_use = false;
+    if(bundle == bundleA){
+        bundleA = NULL;
+    }
+}
+
+void GPIOFastBundleWrite(gpio_fast_bundle_t bundle, uint32_t mask, uint32_t value){
+    if(bundle == NULL){
+        return;
+    }
+    dedic_gpio_bundle_write(bundle->handle, mask & bundle->mask, value);
+}
+
+uint32_t GPIOFastBundleRead(gpio_fast_bundle_t bundle){
+    if(bundle == NULL){
+        return 0;
+    }
+    return dedic_gpio_bundle_read_in(bundle->handle);
+}
+
+gpio_fast_bundle_t GPIOFastBusInit(gpio_t *data_pins, uint8_t data_qty, gpio_t *strobe_pins, uint8_t strobe_qty){
+    gpio_fast_bundle_t bus;
+    gpio_config_t io_conf = {
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    if((strobe_qty == 0) || (strobe_qty > GPIO_FAST_MAX_PINS)){
+        return NULL;
+    }
+    /* Only the data lines take dedicated channels, so a full byte fits. The strobes
+     * are single pin pulses, one set/clear register write each (GPIOWriteMask) */
+    bus = GPIOFastBundleNew(data_pins, data_qty, GPIO_OUTPUT);
+    if(bus == NULL){
+        return NULL;
+    }
+    bus->data_qty = data_qty;
+    bus->strobe_qty = strobe_qty;
+    for(uint8_t i = 0; i < strobe_qty; i++){
+        bus->strobe_mask[i] = GPIO_MASK(strobe_pins[i]);
+        io_conf.pin_bit_mask = 1ULL << strobe_pins[i];
+        gpio_config(&io_conf);
+        GPIOWriteMask(bus->strobe_mask[i], 0);
+    }
+    dedic_gpio_bundle_write(bus->handle, bus->mask, 0);
+    return bus;
+}
+
+void GPIOFastBusWrite(gpio_fast_bundle_t bus, uint8_t strobe, uint8_t word){
+    if((bus == NULL) || (strobe >= bus->strobe_qty)){
+        return;
+    }
+    /* Data first, then strobe high (data latched), then strobe low */
+    dedic_gpio_bundle_write(bus->handle, bus->mask, word);
+    GPIOWriteMask(bus->strobe_mask[strobe], bus->strobe_mask[strobe]);
+    GPIOWriteMask(bus->strobe_mask[strobe], 0);
 }
 
-/*==================[end of file]============================================*/
\ No newline at end of file
+/*==================[end of file]============================================*/
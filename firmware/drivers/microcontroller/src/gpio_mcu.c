@@ -14,54 +14,93 @@
 #include <stdint.h>
 #include "driver/gpio.h"
 #include "driver/gpio_filter.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 /*==================[macros and definitions]=================================*/
 #define GPIO_QTY 	24
 #define FILTER_QTY	8
+#define CAPTURE_INDEX_MASK	(GPIO_CAPTURE_BUF_SIZE - 1)
 typedef struct{
 	uint64_t pin;				/*!< GPIO pin */
 	gpio_mode_t mode;			/*!< Input/Output mode */
 	gpio_pull_mode_t pull;		/*!< GPIO pull-up/pull-down resistor */
-	bool state;					/*!< GPIO output state */
 } digital_io_t;
 /*==================[internal data declaration]==============================*/
 
 /*==================[internal functions declaration]=========================*/
+static void GPIOInstallIsrService(void);
+static void GPIOCaptureIsr(void *args);
 
 /*==================[internal data definition]===============================*/
 digital_io_t gpio_list[GPIO_QTY] = {
-	{GPIO_NUM_0, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO0*/
-	{GPIO_NUM_1, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO1*/
-	{GPIO_NUM_2, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO2*/
-	{GPIO_NUM_3, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO3*/
-	{GPIO_NUM_4, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO4*/
-	{GPIO_NUM_5, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO5*/
-	{GPIO_NUM_6, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO6*/
-	{GPIO_NUM_7, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO7*/
-	{GPIO_NUM_8, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO8*/
-	{GPIO_NUM_9, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO9*/
-	{GPIO_NUM_10, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO10*/
-	{GPIO_NUM_11, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO11*/
-	{GPIO_NUM_12, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO12*/
-	{GPIO_NUM_13, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO13*/
-	{GPIO_NUM_14, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO14*/
-	{GPIO_NUM_15, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO15*/
-	{GPIO_NUM_16, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO16*/
-	{GPIO_NUM_17, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO17*/
-	{GPIO_NUM_18, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO18*/
-	{GPIO_NUM_19, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO19*/
-	{GPIO_NUM_20, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO20*/
-	{GPIO_NUM_21, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO21*/
-	{GPIO_NUM_22, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO22*/
-	{GPIO_NUM_23, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY, false}, /* Configuration GPIO23*/
+	{GPIO_NUM_0, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO0*/
+	{GPIO_NUM_1, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO1*/
+	{GPIO_NUM_2, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO2*/
+	{GPIO_NUM_3, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO3*/
+	{GPIO_NUM_4, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO4*/
+	{GPIO_NUM_5, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO5*/
+	{GPIO_NUM_6, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO6*/
+	{GPIO_NUM_7, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO7*/
+	{GPIO_NUM_8, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO8*/
+	{GPIO_NUM_9, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO9*/
+	{GPIO_NUM_10, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO10*/
+	{GPIO_NUM_11, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO11*/
+	{GPIO_NUM_12, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO12*/
+	{GPIO_NUM_13, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO13*/
+	{GPIO_NUM_14, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO14*/
+	{GPIO_NUM_15, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO15*/
+	{GPIO_NUM_16, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO16*/
+	{GPIO_NUM_17, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO17*/
+	{GPIO_NUM_18, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO18*/
+	{GPIO_NUM_19, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO19*/
+	{GPIO_NUM_20, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO20*/
+	{GPIO_NUM_21, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO21*/
+	{GPIO_NUM_22, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO22*/
+	{GPIO_NUM_23, GPIO_MODE_DISABLE, GPIO_PULLUP_ONLY}, /* Configuration GPIO23*/
 };
 gpio_flex_glitch_filter_config_t filter_config = {
 	.clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
 	.window_width_ns = 700,
 	.window_thres_ns = 600,
 };
+/* Edge capture buffer: written only by GPIOCaptureIsr (head), read only by GPIOCaptureRead (tail) */
+static gpio_capture_event_t capture_buf[GPIO_CAPTURE_BUF_SIZE];
+static volatile uint16_t capture_head = 0;
+static volatile uint16_t capture_tail = 0;
+static volatile uint32_t capture_overflows = 0;
+static gpio_edge_t capture_edge[GPIO_QTY];
+static portMUX_TYPE gpio_out_lock = portMUX_INITIALIZER_UNLOCKED;	/* GPIOWriteMask read-modify-write of GPIO_OUT_REG */
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
+static void GPIOInstallIsrService(void){
+	static bool isr_service_installed = false;
+	if(!isr_service_installed){	
+		gpio_install_isr_service(0);
+		isr_service_installed = true;
+	}
+}
+
+static void IRAM_ATTR GPIOCaptureIsr(void *args){
+	int64_t now = esp_timer_get_time();
+	gpio_t pin = (gpio_t)(uintptr_t)args;
+	uint16_t head = capture_head;
+	if((uint16_t)(head - __atomic_load_n(&capture_tail, __ATOMIC_ACQUIRE)) >= GPIO_CAPTURE_BUF_SIZE){
+		capture_overflows++;
+		return;
+	}
+	capture_buf[head & CAPTURE_INDEX_MASK].timestamp = now;
+	capture_buf[head & CAPTURE_INDEX_MASK].pin = pin;
+	if(capture_edge[pin] == GPIO_EDGE_BOTH){
+		capture_buf[head & CAPTURE_INDEX_MASK].level = (REG_READ(GPIO_IN_REG) & GPIO_MASK(pin)) != 0;
+	} else {
+		capture_buf[head & CAPTURE_INDEX_MASK].level = (capture_edge[pin] == GPIO_EDGE_RISING);
+	}
+	__atomic_store_n(&capture_head, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+}
 
 /*==================[external functions definition]==========================*/
 void GPIOInit(gpio_t pin, io_t io){
@@ -79,52 +118,109 @@ void GPIOInit(gpio_t pin, io_t io){
 }
 
 void GPIOOn(gpio_t pin){
-	gpio_list[pin].state = true;
-	gpio_set_level(gpio_list[pin].pin, gpio_list[pin].state);
+	GPIOWriteMask(GPIO_MASK(pin), GPIO_MASK(pin));
 }
 
 void GPIOOff(gpio_t pin){
-	gpio_list[pin].state = false;
-	gpio_set_level(gpio_list[pin].pin, gpio_list[pin].state);
+	GPIOWriteMask(GPIO_MASK(pin), 0);
 }
 
 void GPIOState(gpio_t pin, bool state){
-	gpio_list[pin].state = state;
-	gpio_set_level(gpio_list[pin].pin, gpio_list[pin].state);
+	GPIOWriteMask(GPIO_MASK(pin), state ? GPIO_MASK(pin) : 0);
 }
 
 void GPIOToggle(gpio_t pin){
-	gpio_list[pin].state = !gpio_list[pin].state;
-	gpio_set_level(gpio_list[pin].pin, gpio_list[pin].state);
+	GPIOWriteMask(GPIO_MASK(pin), ~REG_READ(GPIO_OUT_REG));
 }
 
 bool GPIORead(gpio_t pin){
-	return gpio_get_level(gpio_list[pin].pin);
+	return (GPIOReadPort() & GPIO_MASK(pin)) != 0;
+}
+
+/* in IRAM: also used from interrupts, like the SPI pre-transfer callbacks */
+void IRAM_ATTR GPIOWriteMask(uint32_t mask, uint32_t values){
+	if((values & mask) == mask){
+		REG_WRITE(GPIO_OUT_W1TS_REG, mask);
+	} else if((values & mask) == 0){
+		REG_WRITE(GPIO_OUT_W1TC_REG, mask);
+	} else {
+		/* set and clear in one store, so the pins never show a mix of old and new
+		 * values. OUT is shared with the W1TS/W1TC users, the read-modify-write
+		 * must not be interrupted */
+		portENTER_CRITICAL_SAFE(&gpio_out_lock);
+		REG_WRITE(GPIO_OUT_REG, (REG_READ(GPIO_OUT_REG) & ~mask) | (values & mask));
+		portEXIT_CRITICAL_SAFE(&gpio_out_lock);
+	}
+}
+
+uint32_t GPIOReadPort(void){
+	return REG_READ(GPIO_IN_REG);
 }
 
 void GPIOActivInt(gpio_t pin, void *ptr_int_func, bool edge, void *args){
-	static bool isr_service_installed = false;
 	if(edge){
 		gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_POSEDGE);
 	} else{
 		gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_NEGEDGE);
 	}
-	if(!isr_service_installed){	
-		gpio_install_isr_service(0);
-		isr_service_installed = true;
-	}
+	GPIOInstallIsrService();
     gpio_isr_handler_add(gpio_list[pin].pin, ptr_int_func, (void *)args);	
 }
 
-void GPIOInputFilter(gpio_t pin){
+void GPIOCaptureEnable(gpio_t pin, gpio_edge_t edge){
+	capture_edge[pin] = edge;
+	switch(edge){
+		case GPIO_EDGE_RISING:
+			gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_POSEDGE);
+			break;
+		case GPIO_EDGE_FALLING:
+			gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_NEGEDGE);
+			break;
+		case GPIO_EDGE_BOTH:
+			gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_ANYEDGE);
+			break;
+	}
+	GPIOInstallIsrService();
+	gpio_isr_handler_add(gpio_list[pin].pin, GPIOCaptureIsr, (void *)(uintptr_t)pin);
+}
+
+void GPIOCaptureDisable(gpio_t pin){
+	gpio_isr_handler_remove(gpio_list[pin].pin);
+	gpio_set_intr_type(gpio_list[pin].pin, GPIO_INTR_DISABLE);
+}
+
+uint16_t GPIOCaptureAvailable(void){
+	return (uint16_t)(__atomic_load_n(&capture_head, __ATOMIC_ACQUIRE) - capture_tail);
+}
+
+uint16_t GPIOCaptureRead(gpio_capture_event_t *events, uint16_t max){
+	uint16_t tail = capture_tail;
+	uint16_t count = (uint16_t)(__atomic_load_n(&capture_head, __ATOMIC_ACQUIRE) - tail);
+	if(count > max){
+		count = max;
+	}
+	for(uint16_t i=0; i<count; i++){
+		events[i] = capture_buf[(uint16_t)(tail + i) & CAPTURE_INDEX_MASK];
+	}
+	__atomic_store_n(&capture_tail, (uint16_t)(tail + count), __ATOMIC_RELEASE);
+	return count;
+}
+
+uint32_t GPIOCaptureOverflows(void){
+	return capture_overflows;
+}
+
+bool GPIOInputFilter(gpio_t pin){
 	static uint8_t filter_count = 0;
 	gpio_glitch_filter_handle_t filter;
-	if(filter_count < FILTER_QTY){
-		filter_count++;
-		filter_config.gpio_num = pin;
-		gpio_new_flex_glitch_filter(&filter_config, &filter);
-		gpio_glitch_filter_enable(filter);
+	if(filter_count >= FILTER_QTY){
+		return false;
 	}
+	filter_count++;
+	filter_config.gpio_num = pin;
+	gpio_new_flex_glitch_filter(&filter_config, &filter);
+	gpio_glitch_filter_enable(filter);
+	return true;
 }
 
 void GPIODeinit(void){
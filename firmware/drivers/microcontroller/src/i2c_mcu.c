@@ -14,6 +14,10 @@
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <string.h>
 //#include "sdkconfig.h"
 
 #include "i2c_mcu.h"
@@ -23,9 +27,169 @@
 #undef ESP_ERROR_CHECK
 #define ESP_ERROR_CHECK(x)   do { esp_err_t rc = (x); if (rc != ESP_OK) { ESP_LOGE("err", "esp_err_t = %d", rc); /*assert(0 && #x);*/} } while(0);
 
+#define I2C_SHADOW_REG_QTY	256
+#define I2C_SHADOW_BIT_SET(map, reg)	((map)[(reg) >> 3] |= (1 << ((reg) & 0x07)))
+#define I2C_SHADOW_BIT_CLR(map, reg)	((map)[(reg) >> 3] &= ~(1 << ((reg) & 0x07)))
+#define I2C_SHADOW_BIT_GET(map, reg)	((map)[(reg) >> 3] & (1 << ((reg) & 0x07)))
+#define I2C_QUEUE_TASK_STACK	2048
+#define I2C_QUEUE_TASK_PRIORITY	(configMAX_PRIORITIES - 2)
+
 /*==================[internal data definition]===============================*/
+typedef struct{
+	bool enabled;									/*!< Slot in use */
+	uint8_t dev_addr;								/*!< I2C slave device address */
+	uint8_t valid[I2C_SHADOW_REG_QTY / 8];			/*!< Bitmap of cached registers */
+	uint8_t volatile_regs[I2C_SHADOW_REG_QTY / 8];	/*!< Bitmap of registers never cached */
+	uint8_t regs[I2C_SHADOW_REG_QTY];				/*!< Cached register values */
+} i2c_shadow_t;
+
+static i2c_shadow_t shadow[I2C_SHADOW_DEV_QTY];
+
+typedef struct{
+	i2c_transaction_t trans;	/*!< User descriptor */
+	int64_t submit_time;		/*!< Submission time in us */
+} i2c_queue_item_t;
+
+static QueueHandle_t i2c_queue = NULL;
+static i2c_queue_stats_t i2c_stats;
+static portMUX_TYPE i2c_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+/* Taken around every bus transaction and shadow cache access, by the blocking helpers
+ * and by the bus worker. Recursive, so a read-modify-write keeps it between both transfers. */
+static SemaphoreHandle_t i2c_bus_lock = NULL;
 
 /*==================[internal functions declaration]=========================*/
+static i2c_shadow_t * I2C_ShadowFind(uint8_t devAddr);
+static bool I2C_ShadowLoad(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
+static void I2C_ShadowStore(uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint8_t *data, bool ok);
+static esp_err_t I2C_QueueExecute(const i2c_transaction_t *trans);
+static void I2C_QueueTask(void *param);
+static void I2C_BusLock(void);
+static void I2C_BusUnlock(void);
+
+/*==================[internal functions definition]==========================*/
+static void I2C_BusLock(void){
+	if(i2c_bus_lock != NULL){
+		xSemaphoreTakeRecursive(i2c_bus_lock, portMAX_DELAY);
+	}
+}
+
+static void I2C_BusUnlock(void){
+	if(i2c_bus_lock != NULL){
+		xSemaphoreGiveRecursive(i2c_bus_lock);
+	}
+}
+
+static i2c_shadow_t * I2C_ShadowFind(uint8_t devAddr){
+	for(uint8_t i=0; i<I2C_SHADOW_DEV_QTY; i++){
+		if(shadow[i].enabled && shadow[i].dev_addr == devAddr){
+			return &shadow[i];
+		}
+	}
+	return NULL;
+}
+
+/** Copy cached values into data, only if every register of the range is cached.
+ */
+static bool I2C_ShadowLoad(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data){
+	i2c_shadow_t *dev = I2C_ShadowFind(devAddr);
+	if(dev == NULL){
+		return false;
+	}
+	for(uint8_t i=0; i<length; i++){
+		uint8_t reg = regAddr + i;
+		if(!I2C_SHADOW_BIT_GET(dev->valid, reg) || I2C_SHADOW_BIT_GET(dev->volatile_regs, reg)){
+			return false;
+		}
+	}
+	for(uint8_t i=0; i<length; i++){
+		data[i] = dev->regs[(uint8_t)(regAddr + i)];
+	}
+	return true;
+}
+
+/** Update the cache after a bus transfer. A failed transfer invalidates the range,
+ * since the device content is unknown.
+ */
+static void I2C_ShadowStore(uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint8_t *data, bool ok){
+	i2c_shadow_t *dev = I2C_ShadowFind(devAddr);
+	if(dev == NULL){
+		return;
+	}
+	for(uint8_t i=0; i<length; i++){
+		uint8_t reg = regAddr + i;
+		if(ok && !I2C_SHADOW_BIT_GET(dev->volatile_regs, reg)){
+			dev->regs[reg] = data[i];
+			I2C_SHADOW_BIT_SET(dev->valid, reg);
+		} else {
+			I2C_SHADOW_BIT_CLR(dev->valid, reg);
+		}
+	}
+}
+
+/** Run one asynchronous transaction, called with the bus lock taken. Reads use a
+ * repeated start, like I2C_readBytes.
+ */
+static esp_err_t I2C_QueueExecute(const i2c_transaction_t *trans){
+	esp_err_t err;
+	i2c_cmd_handle_t cmd;
+	TickType_t ticks = (trans->timeout_ms ? trans->timeout_ms : I2C_MASTER_TIMEOUT_MS) / portTICK_PERIOD_MS;
+
+	if(trans->length == 0){
+		return ESP_ERR_INVALID_ARG;
+	}
+	if(trans->dir == I2C_TRANS_READ){
+		if(I2C_ShadowLoad(trans->dev_addr, trans->reg_addr, trans->length, trans->data)){
+			return ESP_OK;
+		}
+		err = i2c_master_write_read_device(I2C_NUM, trans->dev_addr, &trans->reg_addr, 1, trans->data, trans->length, ticks);
+	} else {
+		cmd = i2c_cmd_link_create();
+		i2c_master_start(cmd);
+		i2c_master_write_byte(cmd, (trans->dev_addr << 1) | I2C_MASTER_WRITE, 1);
+		i2c_master_write_byte(cmd, trans->reg_addr, 1);
+		i2c_master_write(cmd, trans->data, trans->length, 1);
+		i2c_master_stop(cmd);
+		err = i2c_master_cmd_begin(I2C_NUM, cmd, ticks);
+		i2c_cmd_link_delete(cmd);
+	}
+	I2C_ShadowStore(trans->dev_addr, trans->reg_addr, trans->length, trans->data, err == ESP_OK);
+	return err;
+}
+
+/** Bus worker: blocks until a transaction arrives and then drains the queue.
+ */
+static void I2C_QueueTask(void *param){
+	i2c_queue_item_t item;
+	esp_err_t err;
+	uint32_t latency;
+
+	while(true){
+		xQueueReceive(i2c_queue, &item, portMAX_DELAY);
+		do{
+			I2C_BusLock();
+			err = I2C_QueueExecute(&item.trans);
+			I2C_BusUnlock();
+			latency = (uint32_t)(esp_timer_get_time() - item.submit_time);
+			portENTER_CRITICAL(&i2c_stats_lock);
+			i2c_stats.completed++;
+			if(err != ESP_OK){
+				i2c_stats.errors++;
+			}
+			i2c_stats.last_latency_us = latency;
+			if(latency > i2c_stats.max_latency_us){
+				i2c_stats.max_latency_us = latency;
+			}
+			i2c_stats.total_latency_us += latency;
+			portEXIT_CRITICAL(&i2c_stats_lock);
+			if(item.trans.func_p != NULL){
+				item.trans.func_p(item.trans.param_p, err, latency);
+			}
+			if(item.trans.notify_task != NULL){
+				xTaskNotifyGive(item.trans.notify_task);
+			}
+		} while(xQueueReceive(i2c_queue, &item, 0) == pdTRUE);
+	}
+}
 
 /*==================[external functions definition]==========================*/
 
@@ -44,6 +208,12 @@ bool I2C_initialize( uint32_t clockRateHz )
         .master.clk_speed = clockRateHz,
     };
 
+    if(i2c_bus_lock == NULL){
+        i2c_bus_lock = xSemaphoreCreateRecursiveMutex();
+        if(i2c_bus_lock == NULL){
+            return false;
+        }
+    }
     i2c_param_config(i2c_master_port, &conf);
 
     return i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
@@ -124,21 +294,18 @@ int8_t I2C_readByte(uint8_t devAddr, uint8_t regAddr, uint8_t *data, uint16_t ti
  * @return I2C_TransferReturn_TypeDef http://downloads.energymicro.com/documentation/doxygen/group__I2C.html
  */
 int8_t I2C_readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout) {
-	i2c_cmd_handle_t cmd;
-	I2C_SelectRegister(devAddr, regAddr);
-
-	cmd = i2c_cmd_link_create();
-	ESP_ERROR_CHECK(i2c_master_start(cmd));
-	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (devAddr << 1) | I2C_MASTER_READ, 1));
-
-	if(length>1)
-	ESP_ERROR_CHECK(i2c_master_read(cmd, data, length-1, I2C_MASTER_ACK));
-
-	ESP_ERROR_CHECK(i2c_master_read_byte(cmd, data+length-1, I2C_MASTER_NACK));
-
-	ESP_ERROR_CHECK(i2c_master_stop(cmd));
-	ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS));
-	i2c_cmd_link_delete(cmd);
+	esp_err_t err;
+	I2C_BusLock();
+	if(I2C_ShadowLoad(devAddr, regAddr, length, data)){
+		I2C_BusUnlock();
+		return length;
+	}
+	/* register select and read in one transaction (repeated start), no other
+	 * transfer can move the register pointer in between */
+	err = i2c_master_write_read_device(I2C_NUM, devAddr, &regAddr, 1, data, length, 1000/portTICK_PERIOD_MS);
+	ESP_ERROR_CHECK(err);
+	I2C_ShadowStore(devAddr, regAddr, length, data, err == ESP_OK);
+	I2C_BusUnlock();
 
 	return length;
 }
@@ -153,6 +320,7 @@ bool I2C_writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data){
 void I2C_SelectRegister(uint8_t devAddr, uint8_t reg){
 	i2c_cmd_handle_t cmd;
 
+	I2C_BusLock();
 	cmd = i2c_cmd_link_create();
 	ESP_ERROR_CHECK(i2c_master_start(cmd));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (devAddr << 1) | I2C_MASTER_WRITE, 1));
@@ -160,6 +328,7 @@ void I2C_SelectRegister(uint8_t devAddr, uint8_t reg){
 	ESP_ERROR_CHECK(i2c_master_stop(cmd));
 	ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS));
 	i2c_cmd_link_delete(cmd);
+	I2C_BusUnlock();
 }
 
 /** write a single bit in an 8-bit device register.
@@ -171,9 +340,13 @@ void I2C_SelectRegister(uint8_t devAddr, uint8_t reg){
  */
 bool I2C_writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data) {
     uint8_t b;
+    bool ok;
+    I2C_BusLock();
     I2C_readByte(devAddr, regAddr, &b, 0);
     b = (data != 0) ? (b | (1 << bitNum)) : (b & ~(1 << bitNum));
-    return I2C_writeByte(devAddr, regAddr, b);
+    ok = I2C_writeByte(devAddr, regAddr, b);
+    I2C_BusUnlock();
+    return ok;
 }
 
 /** Write multiple bits in an 8-bit device register.
@@ -193,16 +366,18 @@ bool I2C_writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t l
     // 10100011 original & ~mask
     // 10101011 masked | value
     uint8_t b = 0;
+    bool ok = false;
+    I2C_BusLock();
     if (I2C_readByte(devAddr, regAddr, &b, 0) != 0) {
         uint8_t mask = ((1 << length) - 1) << (bitStart - length + 1);
         data <<= (bitStart - length + 1); // shift data into correct position
         data &= mask; // zero all non-important bits in data
         b &= ~(mask); // zero all important bits in existing byte
         b |= data; // combine data with existing byte
-        return I2C_writeByte(devAddr, regAddr, b);
-    } else {
-        return false;
+        ok = I2C_writeByte(devAddr, regAddr, b);
     }
+    I2C_BusUnlock();
+    return ok;
 }
 
 /** Write single byte to an 8-bit device register.
@@ -213,15 +388,20 @@ bool I2C_writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t l
  */
 bool I2C_writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data) {
 	i2c_cmd_handle_t cmd;
+	esp_err_t err;
 
+	I2C_BusLock();
 	cmd = i2c_cmd_link_create();
 	ESP_ERROR_CHECK(i2c_master_start(cmd));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (devAddr << 1) | I2C_MASTER_WRITE, 1));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, regAddr, 1));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, data, 1));
 	ESP_ERROR_CHECK(i2c_master_stop(cmd));
-	ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS));
+	err = i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS);
+	ESP_ERROR_CHECK(err);
 	i2c_cmd_link_delete(cmd);
+	I2C_ShadowStore(devAddr, regAddr, 1, &data, err == ESP_OK);
+	I2C_BusUnlock();
 
 	return true;
 }
@@ -235,7 +415,9 @@ bool I2C_writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data) {
  */
 bool I2C_writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data){
 	i2c_cmd_handle_t cmd;
+	esp_err_t err;
 
+	I2C_BusLock();
 	cmd = i2c_cmd_link_create();
 	ESP_ERROR_CHECK(i2c_master_start(cmd));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (devAddr << 1) | I2C_MASTER_WRITE, 1));
@@ -243,8 +425,10 @@ bool I2C_writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *d
 	ESP_ERROR_CHECK(i2c_master_write(cmd, data, length-1, 0));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, data[length-1], 1));
 	ESP_ERROR_CHECK(i2c_master_stop(cmd));
-	i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS);
+	err = i2c_master_cmd_begin(I2C_NUM, cmd, 1000/portTICK_PERIOD_MS);
 	i2c_cmd_link_delete(cmd);
+	I2C_ShadowStore(devAddr, regAddr, length, data, err == ESP_OK);
+	I2C_BusUnlock();
 	return true;
 }
 
@@ -264,4 +448,106 @@ int8_t I2C_readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t t
 	return 0;
 }
 
+bool I2C_ShadowEnable(uint8_t devAddr){
+	bool ok = true;
+	I2C_BusLock();
+	if(I2C_ShadowFind(devAddr) == NULL){
+		ok = false;
+		for(uint8_t i=0; i<I2C_SHADOW_DEV_QTY; i++){
+			if(!shadow[i].enabled){
+				memset(&shadow[i], 0, sizeof(i2c_shadow_t));
+				shadow[i].dev_addr = devAddr;
+				shadow[i].enabled = true;
+				ok = true;
+				break;
+			}
+		}
+	}
+	I2C_BusUnlock();
+	return ok;
+}
+
+void I2C_ShadowDisable(uint8_t devAddr){
+	I2C_BusLock();
+	i2c_shadow_t *dev = I2C_ShadowFind(devAddr);
+	if(dev != NULL){
+		dev->enabled = false;
+	}
+	I2C_BusUnlock();
+}
+
+void I2C_ShadowSetVolatile(uint8_t devAddr, uint8_t regAddr, uint8_t length){
+	I2C_BusLock();
+	i2c_shadow_t *dev = I2C_ShadowFind(devAddr);
+	if(dev != NULL){
+		for(uint8_t i=0; i<length; i++){
+			uint8_t reg = regAddr + i;
+			I2C_SHADOW_BIT_SET(dev->volatile_regs, reg);
+			I2C_SHADOW_BIT_CLR(dev->valid, reg);
+		}
+	}
+	I2C_BusUnlock();
+}
+
+bool I2C_QueueInit(void){
+	if(i2c_queue != NULL){
+		return true;
+	}
+	i2c_queue = xQueueCreate(I2C_QUEUE_DEPTH, sizeof(i2c_queue_item_t));
+	if(i2c_queue == NULL){
+		return false;
+	}
+	if(xTaskCreate(I2C_QueueTask, "I2C_Queue", I2C_QUEUE_TASK_STACK, NULL, I2C_QUEUE_TASK_PRIORITY, NULL) != pdPASS){
+		/* without a worker, nothing may be queued: submissions must keep failing */
+		vQueueDelete(i2c_queue);
+		i2c_queue = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool I2C_Submit(const i2c_transaction_t *trans){
+	i2c_queue_item_t item;
+	if(i2c_queue == NULL){
+		return false;
+	}
+	item.trans = *trans;
+	item.submit_time = esp_timer_get_time();
+	if(xQueueSend(i2c_queue, &item, 0) != pdTRUE){
+		portENTER_CRITICAL(&i2c_stats_lock);
+		i2c_stats.rejected++;
+		portEXIT_CRITICAL(&i2c_stats_lock);
+		return false;
+	}
+	return true;
+}
+
+uint8_t I2C_QueuePending(void){
+	if(i2c_queue == NULL){
+		return 0;
+	}
+	return uxQueueMessagesWaiting(i2c_queue);
+}
+
+void I2C_QueueGetStats(i2c_queue_stats_t *stats){
+	portENTER_CRITICAL(&i2c_stats_lock);
+	*stats = i2c_stats;
+	portEXIT_CRITICAL(&i2c_stats_lock);
+}
+
+void I2C_QueueResetStats(void){
+	portENTER_CRITICAL(&i2c_stats_lock);
+	memset(&i2c_stats, 0, sizeof(i2c_stats));
+	portEXIT_CRITICAL(&i2c_stats_lock);
+}
+
+void I2C_ShadowInvalidate(uint8_t devAddr){
+	I2C_BusLock();
+	i2c_shadow_t *dev = I2C_ShadowFind(devAddr);
+	if(dev != NULL){
+		memset(dev->valid, 0, sizeof(dev->valid));
+	}
+	I2C_BusUnlock();
+}
+
 /*==================[end of file]============================================*/
@@ -11,15 +11,29 @@
 
 /*==================[inclusions]=============================================*/
 #include "pwm_mcu.h"
+#include <stddef.h>
 #include "driver/ledc.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
 /*==================[macros and definitions]=================================*/
-#define DC_MAX  1023
-#define DC_100  100
+#define DC_100          100
+#define PWM_TIMER_QTY   LEDC_TIMER_MAX
+#define PWM_SRC_CLK_HZ  80000000                /*!< LEDC clock (PLL_F80M) */
+#define PWM_DIV_MIN     1                       /*!< LEDC clock divider limits: 18 bits, 8 of them */
+#define PWM_DIV_MAX     1024                    /*!< fractional, so 1 <= div < 1024 */
+#define PWM_RES_MAX     (LEDC_TIMER_BIT_MAX - 1)
+#define PWM_CHANNEL(out)    ((ledc_channel_t)(out))  /*!< PWM_n uses LEDC channel n */
+#define PWM_NO_TIMER    0xFF
+
+typedef struct{
+    uint32_t freq;          /*!< Timer frequency */
+    uint8_t resolution;     /*!< Duty resolution in bits */
+    uint8_t users;          /*!< Number of PWM outputs attached to this timer */
+} pwm_timer_t;
 /*==================[internal data declaration]==============================*/
 static ledc_timer_config_t pwm_timer_cfg = {
     .speed_mode       = LEDC_LOW_SPEED_MODE,
-    .duty_resolution  = LEDC_TIMER_10_BIT,
-    .clk_cfg          = LEDC_AUTO_CLK
+    .clk_cfg          = LEDC_USE_PLL_DIV_CLK
 };
 static ledc_channel_config_t ledc_channel_cfg = {
     .speed_mode     = LEDC_LOW_SPEED_MODE,
@@ -27,150 +41,349 @@ static ledc_channel_config_t ledc_channel_cfg = {
     .duty           = 0,       /*!< Starts in 0% */
     .hpoint         = 0
 };
+static pwm_timer_t pwm_timers[PWM_TIMER_QTY];               /*!< LEDC timers state */
+static uint8_t pwm_timer_sel[PWM_QTY] = {                   /*!< LEDC timer used by each output */
+    PWM_NO_TIMER, PWM_NO_TIMER, PWM_NO_TIMER, PWM_NO_TIMER, PWM_NO_TIMER, PWM_NO_TIMER
+};
+static uint32_t pwm_duty[PWM_QTY];                          /*!< Duty of each output in timer ticks */
+static bool pwm_on[PWM_QTY];                                /*!< Output running (not paused by PWMOff) */
+static uint32_t pwm_hpoint[PWM_QTY];                        /*!< Phase offset of each output in timer ticks */
+static portMUX_TYPE pwm_group_lock = portMUX_INITIALIZER_UNLOCKED;
+static void (*fade_isr_p[PWM_QTY])(void*);    /*!< Pointers to fade end callbacks */
+static void *fade_user_data[PWM_QTY];           /*!< Fade end callbacks parameters */
+static bool fade_installed = false;             /*!< LEDC fade service installed */
 /*==================[internal functions declaration]=========================*/
-
+static uint8_t PWMMaxResolution(uint32_t freq);
+static uint8_t PWMTimerGet(uint32_t freq);
+static void PWMTimerRelease(uint8_t timer);
+static void PWMFadeInstall(void);
+static void PWMFadeAbort(pwm_out_t out);
+static bool IRAM_ATTR PWMFadeIsr(const ledc_cb_param_t *param, void *user_arg);
 /*==================[internal data definition]===============================*/
 
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
+/** Highest duty resolution the LEDC clock allows at freq (lowest clock divider) */
+static uint8_t PWMMaxResolution(uint32_t freq){
+    uint8_t res = 1;
+    if(freq == 0){
+        return 0;
+    }
+    while((res < PWM_RES_MAX) && ((PWM_SRC_CLK_HZ / freq) >> (res + 1)) > 0){
+        res++;
+    }
+    return res;
+}
+
+/** Timer running at freq (shared) or a free one configured at freq, PWM_NO_TIMER if none */
+static uint8_t PWMTimerGet(uint32_t freq){
+    uint8_t timer = PWM_NO_TIMER;
+    uint8_t res = PWMMaxResolution(freq);
+    uint32_t div;
+    for(uint8_t i=0; i<PWM_TIMER_QTY; i++){
+        if((pwm_timers[i].users > 0) && (pwm_timers[i].freq == freq)){
+            pwm_timers[i].users++;
+            return i;
+        }
+        if((timer == PWM_NO_TIMER) && (pwm_timers[i].users == 0)){
+            timer = i;
+        }
+    }
+    if((timer == PWM_NO_TIMER) || (res == 0)){
+        return PWM_NO_TIMER;
+    }
+    /* Lowering the resolution raises the divider, so the highest resolution is the only
+     * candidate: out of range here means freq can't be generated at any resolution */
+    div = (PWM_SRC_CLK_HZ / freq) >> res;
+    if((div < PWM_DIV_MIN) || (div >= PWM_DIV_MAX)){
+        return PWM_NO_TIMER;
+    }
+    pwm_timer_cfg.freq_hz = freq;
+    pwm_timer_cfg.timer_num = timer;
+    pwm_timer_cfg.duty_resolution = res;
+    if(ledc_timer_config(&pwm_timer_cfg) != ESP_OK){
+        return PWM_NO_TIMER;
+    }
+    pwm_timers[timer].freq = freq;
+    pwm_timers[timer].resolution = res;
+    pwm_timers[timer].users = 1;
+    return timer;
+}
+
+static void PWMTimerRelease(uint8_t timer){
+    if((timer != PWM_NO_TIMER) && (pwm_timers[timer].users > 0)){
+        pwm_timers[timer].users--;
+    }
+}
+
+static void PWMFadeInstall(void){
+    if(!fade_installed){
+        ledc_fade_func_install(0);
+        fade_installed = true;
+    }
+}
+
+/** Stop a running fade. With the fade service installed the LEDC driver locks each
+ * channel until its fade ends, so any new duty or fade would block the caller until then */
+static void PWMFadeAbort(pwm_out_t out){
+    if(fade_installed){
+        ledc_fade_stop(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out));
+    }
+}
+
+static bool IRAM_ATTR PWMFadeIsr(const ledc_cb_param_t *param, void *user_arg){
+    pwm_out_t out = (pwm_out_t)(uintptr_t)user_arg;
+    if((param->event == LEDC_FADE_END_EVT) && (fade_isr_p[out] != NULL)){
+        fade_isr_p[out](fade_user_data[out]);
+    }
+    return false;
+}
 
 /*==================[external functions definition]==========================*/
 uint8_t PWMInit(pwm_out_t out, gpio_t gpio, uint16_t freq){
-    switch(out){
-        case PWM_0:
-            pwm_timer_cfg.freq_hz = freq;
-            pwm_timer_cfg.timer_num = LEDC_TIMER_0;
-            ledc_timer_config(&pwm_timer_cfg);
-            ledc_channel_cfg.channel = LEDC_CHANNEL_0;
-            ledc_channel_cfg.timer_sel = LEDC_TIMER_0;
-            ledc_channel_cfg.gpio_num = gpio;
-            ledc_channel_config(&ledc_channel_cfg);
-            break;
-        case PWM_1:
-            pwm_timer_cfg.freq_hz = freq;
-            pwm_timer_cfg.timer_num = LEDC_TIMER_1;
-            ledc_timer_config(&pwm_timer_cfg);
-            ledc_channel_cfg.channel = LEDC_CHANNEL_1;
-            ledc_channel_cfg.timer_sel = LEDC_TIMER_1;
-            ledc_channel_cfg.gpio_num = gpio;
-            ledc_channel_config(&ledc_channel_cfg);
-            break;
-        case PWM_2:
-            pwm_timer_cfg.freq_hz = freq;
-            pwm_timer_cfg.timer_num = LEDC_TIMER_2;
-            ledc_timer_config(&pwm_timer_cfg);
-            ledc_channel_cfg.channel = LEDC_CHANNEL_2;
-            ledc_channel_cfg.timer_sel = LEDC_TIMER_2;
-            ledc_channel_cfg.gpio_num = gpio;
-            ledc_channel_config(&ledc_channel_cfg);
-            break;
-        case PWM_3:
-            pwm_timer_cfg.freq_hz = freq;
-            pwm_timer_cfg.timer_num = LEDC_TIMER_3;
-            ledc_timer_config(&pwm_timer_cfg);
-            ledc_channel_cfg.channel = LEDC_CHANNEL_3;
-            ledc_channel_cfg.timer_sel = LEDC_TIMER_3;
-            ledc_channel_cfg.gpio_num = gpio;
-            ledc_channel_config(&ledc_channel_cfg);
-            break;
+    uint8_t timer;
+    if(out >= PWM_QTY){
+        return 1;
     }
+    PWMTimerRelease(pwm_timer_sel[out]);
+    timer = PWMTimerGet(freq);
+    pwm_timer_sel[out] = timer;
+    if(timer == PWM_NO_TIMER){
+        return 1;
+    }
+    pwm_duty[out] = 0;
+    pwm_hpoint[out] = 0;
+    pwm_on[out] = true;
+    ledc_channel_cfg.channel = PWM_CHANNEL(out);
+    ledc_channel_cfg.timer_sel = timer;
+    ledc_channel_cfg.gpio_num = gpio;
+    ledc_channel_config(&ledc_channel_cfg);
     return 0;
 }
 
 void PWMOn(pwm_out_t out){
-    switch(out){
-        case PWM_0:
-            ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
-            break;
-        case PWM_1:
-            ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1);
-            break;
-        case PWM_2:
-            ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_2);
-            break;
-        case PWM_3:
-            ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_3);
-            break;
+    if(out >= PWM_QTY){
+        return;
     }
+    pwm_on[out] = true;
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out));
 }
 
 void PWMOff(pwm_out_t out){
-    switch(out){
-        case PWM_0:
-            ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
-            break;
-        case PWM_1:
-            ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1);
-            break;
-        case PWM_2:
-            ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_2);
-            break;
-        case PWM_3:
-            ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_3);
-            break;
+    if(out >= PWM_QTY){
+        return;
     }
+    pwm_on[out] = false;
+    ledc_stop(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), 0);
 }
 
 void PWMSetDutyCycle(pwm_out_t out, uint8_t duty_cycle){
     if(duty_cycle > DC_100){
         duty_cycle = DC_100;
     }
-    uint32_t dc = ((uint32_t)duty_cycle * DC_MAX) / DC_100;
-    switch(out){
-        case PWM_0:
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0, dc);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
-            break;
-        case PWM_1:
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1, dc);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1);
-            break;
-        case PWM_2:
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_2, dc);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_2);
-            break;
-        case PWM_3:
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_3, dc);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_TIMER_3);
-            break;
+    PWMSetDutyRaw(out, ((uint64_t)duty_cycle * PWMGetMaxDuty(out)) / DC_100);
+}
+
+void PWMSetDutyRaw(pwm_out_t out, uint32_t duty){
+    uint32_t max;
+    if(out >= PWM_QTY){
+        return;
+    }
+    max = PWMGetMaxDuty(out);
+    if(duty > max){
+        duty = max;
+    }
+    pwm_duty[out] = duty;
+    PWMFadeAbort(out);
+    ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), duty, pwm_hpoint[out]);
+    /* A paused output takes the new duty on PWMOn */
+    if(pwm_on[out]){
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out));
     }
 }
 
+uint32_t PWMGetMaxDuty(pwm_out_t out){
+    if(out >= PWM_QTY){
+        return 0;
+    }
+    if(pwm_timer_sel[out] == PWM_NO_TIMER){
+        return 0;
+    }
+    return 1UL << pwm_timers[pwm_timer_sel[out]].resolution;
+}
+
+uint8_t PWMGetResolution(pwm_out_t out){
+    if(out >= PWM_QTY){
+        return 0;
+    }
+    if(pwm_timer_sel[out] == PWM_NO_TIMER){
+        return 0;
+    }
+    return pwm_timers[pwm_timer_sel[out]].resolution;
+}
+
 uint8_t PWMSetFreq(pwm_out_t out, uint32_t freq){
-    switch(out){
-        case PWM_0:
-            ledc_set_freq(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0, freq);
-            break;
-        case PWM_1:
-            ledc_set_freq(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1, freq);
-            break;
-        case PWM_2:
-            ledc_set_freq(LEDC_LOW_SPEED_MODE, LEDC_TIMER_2, freq);
-            break;
-        case PWM_3:
-            ledc_set_freq(LEDC_LOW_SPEED_MODE, LEDC_TIMER_3, freq);
-            break;
+    uint8_t old_timer;
+    uint8_t old_res, new_timer;
+    if(out >= PWM_QTY){
+        return 1;
+    }
+    old_timer = pwm_timer_sel[out];
+    if(old_timer == PWM_NO_TIMER){
+        return 1;
+    }
+    if(pwm_timers[old_timer].freq == freq){
+        return 0;
+    }
+    old_res = pwm_timers[old_timer].resolution;
+    if((pwm_timers[old_timer].users == 1) && (PWMMaxResolution(freq) == old_res)){
+        /* Timer used only by this output and resolution unchanged: just change the divider */
+        ledc_set_freq(LEDC_LOW_SPEED_MODE, old_timer, freq);
+        pwm_timers[old_timer].freq = freq;
+        return 0;
+    }
+    /* Move the output to a timer at the new frequency, keeping the other outputs untouched */
+    PWMTimerRelease(old_timer);
+    new_timer = PWMTimerGet(freq);
+    if(new_timer == PWM_NO_TIMER){
+        pwm_timers[old_timer].users++;
+        return 1;
+    }
+    pwm_timer_sel[out] = new_timer;
+    ledc_bind_channel_timer(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), new_timer);
+    /* Same duty cycle and phase with the new resolution */
+    if(pwm_timers[new_timer].resolution > old_res){
+        pwm_duty[out] <<= (pwm_timers[new_timer].resolution - old_res);
+        pwm_hpoint[out] <<= (pwm_timers[new_timer].resolution - old_res);
+    } else {
+        pwm_duty[out] >>= (old_res - pwm_timers[new_timer].resolution);
+        pwm_hpoint[out] >>= (old_res - pwm_timers[new_timer].resolution);
+    }
+    PWMFadeAbort(out);
+    ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), pwm_duty[out], pwm_hpoint[out]);
+    if(pwm_on[out]){
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out));
     }
     return 0;
 }
 
+void PWMSetPhaseRaw(pwm_out_t out, uint32_t hpoint){
+    uint32_t max;
+    if(out >= PWM_QTY){
+        return;
+    }
+    max = PWMGetMaxDuty(out);
+    if(max == 0){
+        return;
+    }
+    pwm_hpoint[out] = hpoint % max;
+    PWMFadeAbort(out);
+    ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), pwm_duty[out], pwm_hpoint[out]);
+    if(pwm_on[out]){
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out));
+    }
+}
+
+void PWMSetPhase(pwm_out_t out, uint8_t phase){
+    if(phase >= DC_100){
+        phase = 0;
+    }
+    PWMSetPhaseRaw(out, ((uint64_t)phase * PWMGetMaxDuty(out)) / DC_100);
+}
+
+void PWMSetDutyGroupRaw(const pwm_out_t *outs, const uint32_t *duty, uint8_t qty){
+    uint32_t max;
+    pwm_out_t latch[PWM_QTY];
+    uint8_t latch_qty = 0;
+    if(qty > PWM_QTY){
+        qty = PWM_QTY;
+    }
+    /* Load every duty register first, then latch all of them back to back. Only valid,
+     * initialized and running outputs get to the critical section, where nothing may log */
+    for(uint8_t i=0; i<qty; i++){
+        if((outs[i] >= PWM_QTY) || (pwm_timer_sel[outs[i]] == PWM_NO_TIMER)){
+            continue;
+        }
+        max = PWMGetMaxDuty(outs[i]);
+        pwm_duty[outs[i]] = (duty[i] > max) ? max : duty[i];
+        PWMFadeAbort(outs[i]);
+        ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(outs[i]), pwm_duty[outs[i]], pwm_hpoint[outs[i]]);
+        if(pwm_on[outs[i]]){
+            latch[latch_qty++] = outs[i];
+        }
+    }
+    portENTER_CRITICAL(&pwm_group_lock);
+    for(uint8_t i=0; i<latch_qty; i++){
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(latch[i]));
+    }
+    portEXIT_CRITICAL(&pwm_group_lock);
+}
+
+void PWMSetDutyCycleGroup(const pwm_out_t *outs, const uint8_t *duty_cycle, uint8_t qty){
+    uint32_t duty[PWM_QTY];
+    if(qty > PWM_QTY){
+        qty = PWM_QTY;
+    }
+    for(uint8_t i=0; i<qty; i++){
+        duty[i] = (outs[i] >= PWM_QTY) ? 0 :
+            ((uint64_t)((duty_cycle[i] > DC_100) ? DC_100 : duty_cycle[i]) * PWMGetMaxDuty(outs[i])) / DC_100;
+    }
+    PWMSetDutyGroupRaw(outs, duty, qty);
+}
+
+void PWMFadeTo(pwm_out_t out, uint8_t duty_cycle, uint32_t time_ms){
+    if(out >= PWM_QTY){
+        return;
+    }
+    if(duty_cycle > DC_100){
+        duty_cycle = DC_100;
+    }
+    pwm_duty[out] = ((uint64_t)duty_cycle * PWMGetMaxDuty(out)) / DC_100;
+    pwm_on[out] = true;
+    PWMFadeInstall();
+    PWMFadeAbort(out);
+    ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), pwm_duty[out], time_ms);
+    ledc_fade_start(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), LEDC_FADE_NO_WAIT);
+}
+
+void PWMFadeStep(pwm_out_t out, uint8_t duty_cycle, uint32_t step, uint32_t cycle_num){
+    if(out >= PWM_QTY){
+        return;
+    }
+    if(duty_cycle > DC_100){
+        duty_cycle = DC_100;
+    }
+    pwm_duty[out] = ((uint64_t)duty_cycle * PWMGetMaxDuty(out)) / DC_100;
+    pwm_on[out] = true;
+    PWMFadeInstall();
+    PWMFadeAbort(out);
+    ledc_set_fade_with_step(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), pwm_duty[out], step, cycle_num);
+    ledc_fade_start(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), LEDC_FADE_NO_WAIT);
+}
+
+void PWMFadeCallback(pwm_out_t out, void (*func_p)(void *), void *param_p){
+    ledc_cbs_t fade_cbs = {
+        .fade_cb = PWMFadeIsr,
+    };
+    if(out >= PWM_QTY){
+        return;
+    }
+    PWMFadeInstall();
+    fade_user_data[out] = param_p;
+    fade_isr_p[out] = func_p;
+    ledc_cb_register(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), &fade_cbs, (void *)(uintptr_t)out);
+}
+
 uint8_t PWMDeinit(pwm_out_t out){
-    switch(out){
-        case PWM_0:
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
-            break;
-        case PWM_1:
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 0);
-            break;
-        case PWM_2:
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2, 0);
-            break;
-        case PWM_3:
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 0);
-            break;
+    if(out >= PWM_QTY){
+        return 1;
     }
+    ledc_stop(LEDC_LOW_SPEED_MODE, PWM_CHANNEL(out), 0);
+    pwm_on[out] = false;
+    PWMTimerRelease(pwm_timer_sel[out]);
+    pwm_timer_sel[out] = PWM_NO_TIMER;
     return 0;
 }
 
-/*==================[end of file]============================================*/
\ No newline at end of file
+/*==================[end of file]============================================*/
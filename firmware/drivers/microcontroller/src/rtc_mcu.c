@@ -13,52 +13,132 @@
 #include "rtc_mcu.h"
 #include <stdint.h>
 #include "sys/time.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 /*==================[macros and definitions]=================================*/
-
+#define US_PER_SEC      1000000LL
+#define SEC_PER_DAY     86400
+#define SEC_PER_HOUR    3600
+#define SEC_PER_MIN     60
+#define FLOOR_DIV(a, b) (((a) >= 0) ? ((a) / (b)) : -((-(a) + (b) - 1) / (b)))   /*!< Division rounding down, also for negative a */
 /*==================[internal data declaration]==============================*/
-
+/**
+ * @brief Calendar split of the last converted day, reused while time stays in that day
+ */
+typedef struct {
+    bool valid;             /*!< false: empty */
+    int64_t day_start;      /*!< Epoch second of 00:00:00 of the cached day */
+    uint16_t year;
+    uint8_t  month;
+    uint8_t  mday;
+    uint8_t  wday;
+} rtc_day_cache_t;
 /*==================[internal functions declaration]=========================*/
-
+static int32_t RtcDaysFromCivil(int32_t year, uint8_t month, uint8_t mday);
+static void RtcCivilFromDays(int32_t days, rtc_day_cache_t *day);
 /*==================[internal data definition]===============================*/
-
+static int64_t epoch_offset_us = 0;     /*!< Epoch time (us) minus monotonic time (us) */
+static rtc_day_cache_t day_cache = { .valid = false };
+static portMUX_TYPE rtc_lock = portMUX_INITIALIZER_UNLOCKED;
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
+/** Days since 1970-01-01 of a proleptic Gregorian date */
+static int32_t RtcDaysFromCivil(int32_t year, uint8_t month, uint8_t mday){
+    year -= (month <= 2);
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yoe = (uint32_t)(year - era * 400);
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+/** Proleptic Gregorian date of a number of days since 1970-01-01 */
+static void RtcCivilFromDays(int32_t days, rtc_day_cache_t *day){
+    int32_t z = days + 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    day->mday = doy - (153 * mp + 2) / 5 + 1;
+    day->month = mp < 10 ? mp + 3 : mp - 9;
+    day->year = (int32_t)yoe + era * 400 + (day->month <= 2);
+    day->wday = ((days % 7) + 11) % 7 + 1;     /* 1970-01-01 was thursday (5) */
+}
 
 /*==================[external functions definition]==========================*/
 bool RtcConfig(rtc_t * rtc){
-    struct tm tm;
-    tm.tm_year = rtc->year;
-    if(rtc->month > MAX_MONTH) return false;
-    if(rtc->mday > MAX_MDAY) return false;
+    if((rtc->month < 1) || (rtc->month > MAX_MONTH)) return false;
+    if((rtc->mday < 1) || (rtc->mday > MAX_MDAY)) return false;
     if(rtc->wday > MAX_WDAY) return false;
     if(rtc->hour > MAX_HOUR) return false;
     if(rtc->min > MAX_MIN) return false;
     if(rtc->sec > MAX_SEC) return false;
-    tm.tm_mon = rtc->month;
-    tm.tm_mday = rtc->mday;
-    tm.tm_wday = rtc->wday;
-    tm.tm_hour = rtc->hour;
-    tm.tm_min = rtc->min;
-    tm.tm_sec = rtc->sec;
-    time_t t = mktime(&tm);
-    struct timeval now = { .tv_sec = t };
+    int64_t t = (int64_t)RtcDaysFromCivil(rtc->year, rtc->month, rtc->mday) * SEC_PER_DAY
+                + rtc->hour * SEC_PER_HOUR + rtc->min * SEC_PER_MIN + rtc->sec;
+    portENTER_CRITICAL(&rtc_lock);
+    epoch_offset_us = t * US_PER_SEC - esp_timer_get_time();
+    day_cache.valid = false;
+    portEXIT_CRITICAL(&rtc_lock);
+    /* Keep time() and gettimeofday() in sync with the driver */
+    struct timeval now = { .tv_sec = (time_t)t };
     settimeofday(&now, NULL);
 
     return true;
 }
 
 void RtcRead(rtc_t * rtc){
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    rtc->year = timeinfo.tm_year;
-    rtc->month = timeinfo.tm_mon;
-    rtc->mday = timeinfo.tm_mday;
-    rtc->wday = timeinfo.tm_wday;
-    rtc->hour = timeinfo.tm_hour;
-    rtc->min = timeinfo.tm_min;
-    rtc->sec = timeinfo.tm_sec;
+    RtcEpochToDate(RtcGetEpochUs(), rtc);
+}
+
+int64_t RtcGetUs(void){
+    return esp_timer_get_time();
+}
+
+int64_t RtcGetEpochUs(void){
+    int64_t offset;
+    /* 64-bit read, RtcConfig could change it halfway */
+    portENTER_CRITICAL(&rtc_lock);
+    offset = epoch_offset_us;
+    portEXIT_CRITICAL(&rtc_lock);
+    return esp_timer_get_time() + offset;
+}
+
+void RtcEpochToDate(int64_t epoch_us, rtc_t * rtc){
+    /* rounded down, so times before 1970 belong to the previous second and day */
+    int64_t sec = FLOOR_DIV(epoch_us, US_PER_SEC);
+    int32_t sec_of_day;
+    rtc_day_cache_t day;
+
+    portENTER_CRITICAL(&rtc_lock);
+    day = day_cache;
+    portEXIT_CRITICAL(&rtc_lock);
+    if(!day.valid || (sec < day.day_start) || (sec >= day.day_start + SEC_PER_DAY)){
+        /* Day changed (or first call): full date conversion, once per day */
+        int32_t days = (int32_t)FLOOR_DIV(sec, SEC_PER_DAY);
+        RtcCivilFromDays(days, &day);
+        day.day_start = (int64_t)days * SEC_PER_DAY;
+        day.valid = true;
+        portENTER_CRITICAL(&rtc_lock);
+        day_cache = day;
+        portEXIT_CRITICAL(&rtc_lock);
+    }
+    sec_of_day = (int32_t)(sec - day.day_start);
+    rtc->year = day.year;
+    rtc->month = day.month;
+    rtc->mday = day.mday;
+    rtc->wday = day.wday;
+    rtc->hour = sec_of_day / SEC_PER_HOUR;
+    rtc->min = (sec_of_day % SEC_PER_HOUR) / SEC_PER_MIN;
+    rtc->sec = sec_of_day % SEC_PER_MIN;
+}
+
+void RtcTimestampBatch(int64_t * timestamps, uint16_t qty, uint32_t period_us){
+    int64_t t = RtcGetEpochUs() - (int64_t)period_us * qty;
+    for(uint16_t i = 0; i < qty; i++){
+        t += period_us;
+        timestamps[i] = t;
+    }
 }
 /*==================[end of file]============================================*/
@@ -22,6 +22,7 @@
 #define PIN_NUM_CS1		GPIO_19	/*!<  */
 #define PIN_NUM_CS2		GPIO_18	/*!<  */
 #define PIN_NUM_CS3		GPIO_9	/*!<  */
+#define SPI_DEV_QTY		3
 /*==================[internal data declaration]==============================*/
 spi_device_handle_t spi_1, spi_2, spi_3;
 const spi_bus_config_t bus_cfg = {
@@ -39,6 +40,13 @@ void (*spi_3_isr_p)(void*);	/*!<  */
 void *spi_1_user_data;	    /*!<  */
 void *spi_2_user_data;	    /*!<  */
 void *spi_3_user_data;	    /*!<  */
+void (*spi_1_pre_p)(void*);	/*!< Pre-transfer callbacks */
+void (*spi_2_pre_p)(void*);
+void (*spi_3_pre_p)(void*);
+/* Queued writes of each device: descriptors are reused in order, pending ones are in flight */
+static spi_transaction_t queue_trans[SPI_DEV_QTY][SPI_QUEUE_SIZE];
+static uint8_t queue_next[SPI_DEV_QTY];
+static uint8_t queue_pending[SPI_DEV_QTY];
 /*==================[internal functions declaration]=========================*/
 static void IRAM_ATTR spi_1_isr(spi_transaction_t *t){
 	spi_1_isr_p(spi_1_user_data);
@@ -49,11 +57,38 @@ static void IRAM_ATTR spi_2_isr(spi_transaction_t *t){
 static void IRAM_ATTR spi_3_isr(spi_transaction_t *t){
 	spi_3_isr_p(spi_3_user_data);
 }
+static void IRAM_ATTR spi_1_pre_isr(spi_transaction_t *t){
+	spi_1_pre_p(t->user);
+}
+static void IRAM_ATTR spi_2_pre_isr(spi_transaction_t *t){
+	spi_2_pre_p(t->user);
+}
+static void IRAM_ATTR spi_3_pre_isr(spi_transaction_t *t){
+	spi_3_pre_p(t->user);
+}
 /*==================[internal data definition]===============================*/
 
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
+static spi_device_handle_t spi_handle(spi_dev_t device){
+    switch(device){
+        case SPI_1:
+            return spi_1;
+        case SPI_2:
+            return spi_2;
+        case SPI_3:
+            return spi_3;
+    }
+    return NULL;
+}
+
+/* Waits for the oldest queued write of the device */
+static void queue_get_result(spi_dev_t device){
+    spi_transaction_t *t;
+    spi_device_get_trans_result(spi_handle(device), &t, portMAX_DELAY);
+    queue_pending[device]--;
+}
 
 /*==================[external functions definition]==========================*/
 uint8_t SpiInit(spi_mcu_config_t* spi){
@@ -65,8 +100,13 @@ uint8_t SpiInit(spi_mcu_config_t* spi){
 	spi_device_interface_config_t dev_cfg = {
         .clock_speed_hz = spi->bitrate,     	
         .mode = spi->clk_mode,                  
-        .queue_size = 8,                        
+        .queue_size = SPI_QUEUE_SIZE,                        
     };
+    /* a device initialized again replaces the previous one, instead of taking a new slot of the bus */
+    if(spi_handle(spi->device) != NULL){
+        SpiQueueWait(spi->device);
+        spi_bus_remove_device(spi_handle(spi->device));
+    }
     switch(spi->device){
         case SPI_1:
             dev_cfg.spics_io_num = PIN_NUM_CS1;
@@ -74,29 +114,41 @@ uint8_t SpiInit(spi_mcu_config_t* spi){
             if(transfer_mode_1 == SPI_INTERRUPT){
                 dev_cfg.post_cb = spi_1_isr;
             } 
-            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_1);
+            if(spi->pre_func_p != NULL){
+                dev_cfg.pre_cb = spi_1_pre_isr;
+            }
             spi_1_isr_p = spi->func_p;
             spi_1_user_data = spi->param_p;
+            spi_1_pre_p = spi->pre_func_p;
+            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_1);
             break;
         case SPI_2:
             dev_cfg.spics_io_num = PIN_NUM_CS2;
+            transfer_mode_2 = spi->transfer_mode;
             if(transfer_mode_2 == SPI_INTERRUPT){
                 dev_cfg.post_cb = spi_2_isr;
             } 
-            transfer_mode_1 = spi->transfer_mode;
-            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_2);
+            if(spi->pre_func_p != NULL){
+                dev_cfg.pre_cb = spi_2_pre_isr;
+            }
             spi_2_isr_p = spi->func_p;
             spi_2_user_data = spi->param_p;
+            spi_2_pre_p = spi->pre_func_p;
+            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_2);
             break;
         case SPI_3:
             dev_cfg.spics_io_num = PIN_NUM_CS3;
+            transfer_mode_3 = spi->transfer_mode;
             if(transfer_mode_3 == SPI_INTERRUPT){
                 dev_cfg.post_cb = spi_3_isr;
             } 
-            transfer_mode_1 = spi->transfer_mode;
-            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_3);
+            if(spi->pre_func_p != NULL){
+                dev_cfg.pre_cb = spi_3_pre_isr;
+            }
             spi_3_isr_p = spi->func_p;
             spi_3_user_data = spi->param_p;
+            spi_3_pre_p = spi->pre_func_p;
+            spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_3);
             break;
     }
     return 0;
@@ -104,6 +156,7 @@ uint8_t SpiInit(spi_mcu_config_t* spi){
 
 void SpiRead(spi_dev_t device, uint8_t * rx_buffer, uint32_t rx_buffer_size){
     spi_transaction_t t;
+    SpiQueueWait(device);           // Polling transfers can't start with queued ones pending
     memset(&t, 0, sizeof(t));       // Zero out the transaction
     t.length = rx_buffer_size * 8;  // tx_buffer_size is in bytes, transaction length is in bits.
     t.rxlength = rx_buffer_size * 8;
@@ -144,6 +197,7 @@ void SpiRead(spi_dev_t device, uint8_t * rx_buffer, uint32_t rx_buffer_size){
 
 void SpiWrite(spi_dev_t device, uint8_t * tx_buffer, uint32_t tx_buffer_size){
     spi_transaction_t t;
+    SpiQueueWait(device);           // Polling transfers can't start with queued ones pending
     memset(&t, 0, sizeof(t));       // Zero out the transaction
     t.length = tx_buffer_size * 8;  // tx_buffer_size is in bytes, transaction length is in bits.
     t.tx_buffer = tx_buffer;        // Data
@@ -183,6 +237,7 @@ void SpiWrite(spi_dev_t device, uint8_t * tx_buffer, uint32_t tx_buffer_size){
 
 void SpiReadWrite(spi_dev_t device, uint8_t * tx_buffer, uint8_t * rx_buffer, uint32_t buffer_size){
     spi_transaction_t t;
+    SpiQueueWait(device);           // Polling transfers can't start with queued ones pending
     memset(&t, 0, sizeof(t));       // Zero out the transaction
     t.length = buffer_size * 8;     // tx_buffer_size is in bytes, transaction length is in bits.
     t.rxlength = buffer_size * 8;
@@ -222,6 +277,39 @@ void SpiReadWrite(spi_dev_t device, uint8_t * tx_buffer, uint8_t * rx_buffer, ui
     }
 }
 
+void SpiQueueWrite(spi_dev_t device, const uint8_t * tx_buffer, uint32_t tx_buffer_size, void *user){
+    spi_transaction_t *t;
+    /* all descriptors in flight: the oldest one is the next to reuse */
+    if(queue_pending[device] >= SPI_QUEUE_SIZE){
+        queue_get_result(device);
+    }
+    t = &queue_trans[device][queue_next[device]];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length = tx_buffer_size * 8;
+    t->user = user;
+    if(tx_buffer_size <= SPI_QUEUE_COPY_LEN){
+        /* short writes (commands and parameters) travel in the descriptor */
+        t->flags = SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, tx_buffer, tx_buffer_size);
+    }else{
+        t->tx_buffer = tx_buffer;
+    }
+    if(spi_device_queue_trans(spi_handle(device), t, portMAX_DELAY) == ESP_OK){
+        queue_next[device] = (queue_next[device] + 1) % SPI_QUEUE_SIZE;
+        queue_pending[device]++;
+    }
+}
+
+void SpiQueueWait(spi_dev_t device){
+    SpiQueueWaitPending(device, 0);
+}
+
+void SpiQueueWaitPending(spi_dev_t device, uint8_t pending){
+    while(queue_pending[device] > pending){
+        queue_get_result(device);
+    }
+}
+
 uint8_t SpiDeInit(spi_dev_t device){
     return 0;
 }
@@ -0,0 +1,308 @@
+/**
+ * @file ble_bench_host.c
+ * @brief BLE benchmark on the host: ble_mcu.c against the simulated sim_link of sim_port.c
+ *
+ * For every MTU and connection interval of the sweep it connects the simulated
+ * central and runs two phases of the same length:
+ * - throughput: BleSendBuffer as fast as the sim_link drains the TX buffer.
+ * - latency: one record every pace, time from BleSendBuffer to the central.
+ * During both phases the central writes SIM_WRITE_LEN bytes every write period,
+ * and the time from the write to the read callback is measured as well.
+ *
+ * Records (../main/bench_record.h) are rebuilt by the central, so lost or
+ * corrupted data shows up in the table and in the exit code. With several
+ * centrals (-N) every one of them must get the whole stream, the throughput is
+ * the one of the slowest central and lost records are added up.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "ble_mcu.h"
+#include "sim_port.h"
+#include "bench_record.h"
+/*==================[macros and definitions]=================================*/
+#define LIST_MAX			8
+#define RECORDS_PER_WRITE	16		/* Records per BleSendBuffer call in the throughput phase */
+#define SETUP_TIMEOUT_MS	2000
+#define DRAIN_TIMEOUT_MS	5000
+/*==================[typedef]================================================*/
+typedef struct {
+	uint64_t sum_us;
+	uint32_t max_us;
+	uint32_t count;
+} latency_t;
+
+typedef enum {
+	PHASE_IDLE,
+	PHASE_THROUGHPUT,
+	PHASE_LATENCY
+} phase_t;
+/*==================[internal data declaration]==============================*/
+static uint32_t phase_ms = 1000;
+static uint32_t pace_us = 10000;
+static uint16_t coalesce_ms = 0;
+static uint16_t mtus[LIST_MAX] = {23, 185, 247};
+static uint8_t mtu_qty = 3;
+static uint16_t intervals[LIST_MAX] = {6, 12, 24, 40};
+static uint8_t interval_qty = 4;
+static sim_link_t sim_link = {
+	.dle = true,
+	.phy_2m = false,
+	.max_pdus = 6,
+	.stack_bufs = 12,
+	.error_permille = 0,
+	.write_period_us = 23000,
+	.centrals = 1,
+};
+static pthread_mutex_t rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static bench_rx_t rx[SIM_CENTRALS_MAX];	/* Central side record receivers */
+static volatile phase_t phase = PHASE_IDLE;
+static latency_t tx_latency;			/* Latency phase, BleSendBuffer to central */
+static latency_t rx_latency;			/* Central write to read callback */
+static uint32_t seq;
+/*==================[internal functions definition]==========================*/
+static void latency_add(latency_t *latency, int64_t value_us) {
+	latency->sum_us += value_us;
+	latency->count++;
+	if(value_us > latency->max_us){
+		latency->max_us = value_us;
+	}
+}
+
+static double latency_avg_ms(const latency_t *latency) {
+	return latency->count ? (double)latency->sum_us / latency->count / 1000.0 : 0.0;
+}
+
+/* Central side, from the sim_link thread */
+static void on_record(uint32_t record_seq, int64_t time_us, void *arg) {
+	if(phase == PHASE_LATENCY){
+		latency_add(&tx_latency, esp_timer_get_time() - time_us);
+	}
+}
+
+static void on_notification(uint8_t central, bool stream, const uint8_t *data, uint16_t length) {
+	if(stream){
+		return;
+	}
+	pthread_mutex_lock(&rx_lock);
+	BenchRecordParse(&rx[central], data, length, on_record, NULL);
+	pthread_mutex_unlock(&rx_lock);
+}
+
+/* Peripheral side, from the read task of the driver */
+static void on_write(uint8_t *data, size_t length) {
+	int64_t issued_us = 0;
+	if(length < sizeof(issued_us)){
+		return;
+	}
+	for(uint8_t i = 0; i < sizeof(issued_us); i++){
+		issued_us |= (int64_t)data[i] << (8 * i);
+	}
+	latency_add(&rx_latency, esp_timer_get_time() - issued_us);
+}
+
+static bool wait_for(bool (*cond)(uint16_t, uint16_t), uint16_t mtu, uint16_t interval, uint32_t timeout_ms) {
+	while(!cond(mtu, interval)){
+		if(timeout_ms-- == 0){
+			return false;
+		}
+		vTaskDelay(pdMS_TO_TICKS(1));
+	}
+	return true;
+}
+
+static bool link_ready(uint16_t mtu, uint16_t interval) {
+	ble_conn_params_t params;
+	BleGetConnParams(&params);
+	return (BleConnCount() == sim_link.centrals) && (BleGetMtu() == mtu) && (params.interval == interval);
+}
+
+static bool link_drained(uint16_t mtu, uint16_t interval) {
+	return (BleSendFree() == BLE_TX_BUFFER_SIZE) && !SimBusy();
+}
+
+static bool link_down(uint16_t mtu, uint16_t interval) {
+	return BleStatus() != BLE_CONNECTED;
+}
+
+static void send_records(uint8_t qty) {
+	uint8_t records[RECORDS_PER_WRITE * BENCH_RECORD_SIZE];
+	for(uint8_t i = 0; i < qty; i++){
+		BenchRecordFill(&records[i * BENCH_RECORD_SIZE], seq++, esp_timer_get_time());
+	}
+	BleSendBuffer((const char *)records, qty * BENCH_RECORD_SIZE);
+}
+
+/* Runs both phases for one point of the sweep, returns false on lost or corrupted data */
+static bool run_point(uint16_t mtu, uint16_t interval) {
+	sim_central_t central;
+	ble_stats_t stats;
+	int64_t end_us, next_us;
+	double throughput = 0, central_thr;
+	uint32_t lost = 0, corrupted = 0, notifications = 0, data_events = 0;
+
+	pthread_mutex_lock(&rx_lock);
+	for(uint8_t i = 0; i < SIM_CENTRALS_MAX; i++){
+		BenchRecordReset(&rx[i]);
+	}
+	pthread_mutex_unlock(&rx_lock);
+	memset(&tx_latency, 0, sizeof(tx_latency));
+	memset(&rx_latency, 0, sizeof(rx_latency));
+	seq = 0;
+
+	BleSetConnInterval(interval, interval);
+	sim_link.mtu = mtu;
+	SimConnect(&sim_link);
+	if(!wait_for(link_ready, mtu, interval, SETUP_TIMEOUT_MS)){
+		fprintf(stderr, "MTU %u, interval %u: connection setup timed out\n", mtu, interval);
+		SimDisconnect();
+		wait_for(link_down, 0, 0, SETUP_TIMEOUT_MS);
+		return false;
+	}
+
+	phase = PHASE_THROUGHPUT;
+	end_us = esp_timer_get_time() + (int64_t)phase_ms * 1000;
+	while(esp_timer_get_time() < end_us){
+		send_records(RECORDS_PER_WRITE);
+	}
+	wait_for(link_drained, 0, 0, DRAIN_TIMEOUT_MS);
+	BleGetStats(&stats);
+	for(uint8_t i = 0; i < sim_link.centrals; i++){
+		SimGetCentral(i, &central);
+		central_thr = 0;
+		if(central.last_us > central.first_us){
+			central_thr = (double)central.bytes * 1000.0 / (central.last_us - central.first_us);
+		}
+		if((i == 0) || (central_thr < throughput)){
+			throughput = central_thr;
+		}
+		notifications += central.notifications;
+		data_events += central.data_events;
+	}
+
+	phase = PHASE_LATENCY;
+	next_us = esp_timer_get_time();
+	end_us = next_us + (int64_t)phase_ms * 1000;
+	while(next_us < end_us){
+		send_records(1);
+		next_us += pace_us;
+		while(esp_timer_get_time() < next_us){
+			vTaskDelay(pdMS_TO_TICKS(1));
+		}
+	}
+	wait_for(link_drained, 0, 0, DRAIN_TIMEOUT_MS);
+	phase = PHASE_IDLE;
+
+	SimDisconnect();
+	wait_for(link_down, 0, 0, SETUP_TIMEOUT_MS);
+
+	pthread_mutex_lock(&rx_lock);
+	for(uint8_t i = 0; i < sim_link.centrals; i++){
+		lost += rx[i].lost + (seq - rx[i].next_seq);
+		corrupted += rx[i].corrupted;
+	}
+	pthread_mutex_unlock(&rx_lock);
+	printf("%4u %7.2f %10.2f %9.2f %6u %6u %6u %8.2f %8.2f %8.2f %8.2f %7u %8u\n",
+		mtu, interval * 1.25, throughput,
+		data_events ? (double)notifications / data_events : 0.0,
+		stats.efficiency, stats.congestions, stats.send_errors,
+		latency_avg_ms(&tx_latency), tx_latency.max_us / 1000.0,
+		latency_avg_ms(&rx_latency), rx_latency.max_us / 1000.0,
+		lost, corrupted);
+	fflush(stdout);
+	return (lost == 0) && (corrupted == 0);
+}
+
+static uint8_t parse_list(char *arg, uint16_t *list) {
+	uint8_t qty = 0;
+	for(char *tok = strtok(arg, ","); (tok != NULL) && (qty < LIST_MAX); tok = strtok(NULL, ",")){
+		list[qty++] = strtoul(tok, NULL, 10);
+	}
+	return qty;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -m list   ATT MTUs, comma separated (23,185,247)\n"
+		"  -c list   connection intervals, x 1.25 ms (6,12,24,40)\n"
+		"  -t ms     length of each phase (1000)\n"
+		"  -p us     record period of the latency phase (10000)\n"
+		"  -w us     central write period, 0 disables writes (23000)\n"
+		"  -n pdus   LL PDUs per connection event (6)\n"
+		"  -b bufs   notifications held by the stack (12)\n"
+		"  -e perm   notifications rejected by the stack, per thousand (0)\n"
+		"  -N qty    centrals connected at the same time, up to %d (1)\n"
+		"  -k ms     BleSetCoalescing deadline (0)\n"
+		"  -2        2M PHY\n"
+		"  -d        no Data Length Extension\n"
+		"  -v        driver logs\n", name, SIM_CENTRALS_MAX);
+}
+
+/*==================[external functions definition]==========================*/
+int main(int argc, char *argv[]){
+	ble_config_t ble_configuration = {
+		.device_name = "ESP_EDU_BENCH",
+		.func_p = BLE_NO_INT,
+		.long_func_p = on_write
+	};
+	bool ok = true;
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:c:t:p:w:n:b:e:N:k:2dvh")) != -1){
+		switch(opt){
+			case 'm': mtu_qty = parse_list(optarg, mtus); break;
+			case 'c': interval_qty = parse_list(optarg, intervals); break;
+			case 't': phase_ms = strtoul(optarg, NULL, 10); break;
+			case 'p': pace_us = strtoul(optarg, NULL, 10); break;
+			case 'w': sim_link.write_period_us = strtoul(optarg, NULL, 10); break;
+			case 'n': sim_link.max_pdus = strtoul(optarg, NULL, 10); break;
+			case 'b': sim_link.stack_bufs = strtoul(optarg, NULL, 10); break;
+			case 'e': sim_link.error_permille = strtoul(optarg, NULL, 10); break;
+			case 'N': sim_link.centrals = strtoul(optarg, NULL, 10); break;
+			case 'k': coalesce_ms = strtoul(optarg, NULL, 10); break;
+			case '2': sim_link.phy_2m = true; break;
+			case 'd': sim_link.dle = false; break;
+			case 'v': shim_log_enabled = true; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if((pace_us == 0) || (sim_link.max_pdus == 0) || (sim_link.stack_bufs == 0) ||
+			(sim_link.centrals == 0) || (sim_link.centrals > SIM_CENTRALS_MAX)){
+		usage(argv[0]);
+		return 2;
+	}
+
+	SimSetReceiver(on_notification);
+	BleInit(&ble_configuration);
+	BleSetCoalescing(coalesce_ms);
+
+	printf("# %u central(s), %s PHY, DLE %s, %u PDUs/event, %u stack buffers, %u/1000 errors, coalescing %u ms, %u ms phases\n",
+		sim_link.centrals, sim_link.phy_2m ? "2M" : "1M", sim_link.dle ? "on" : "off", sim_link.max_pdus,
+		sim_link.stack_bufs, sim_link.error_permille, coalesce_ms, phase_ms);
+	printf("# mtu  ci_ms  thr_kB/s  notif/ev  eff_%%   busy   errs  txlat_ms   max_ms  rxlat_ms   max_ms    lost  corrupt\n");
+	for(uint8_t i = 0; i < mtu_qty; i++){
+		for(uint8_t j = 0; j < interval_qty; j++){
+			ok &= run_point(mtus[i], intervals[j]);
+		}
+	}
+	/* with a clean sim_link every record must arrive, so regressions fail the run */
+	return (ok || (sim_link.error_permille > 0)) ? 0 : 1;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,17 @@
+#ifndef SHIM_ESP_ERR_H
+#define SHIM_ESP_ERR_H
+/**
+ * @file esp_err.h
+ * @brief Host shim: ESP-IDF error codes
+ */
+#include <assert.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK						0
+#define ESP_FAIL					-1
+#define ESP_ERR_NVS_NO_FREE_PAGES	0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND	0x1110
+#define ESP_ERROR_CHECK(x)			do { esp_err_t err_rc = (x); assert(err_rc == ESP_OK); (void)err_rc; } while(0)
+
+#endif /* SHIM_ESP_ERR_H */
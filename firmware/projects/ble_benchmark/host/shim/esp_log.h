@@ -0,0 +1,19 @@
+#ifndef SHIM_ESP_LOG_H
+#define SHIM_ESP_LOG_H
+/**
+ * @file esp_log.h
+ * @brief Host shim: driver logs go to stderr when shim_log_enabled is set (-v)
+ */
+#include <stdio.h>
+#include <stdbool.h>
+
+extern bool shim_log_enabled;
+
+#define SHIM_LOG(level, tag, format, ...) do { if(shim_log_enabled) \
+	fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__); } while(0)
+#define ESP_LOGE(tag, format, ...)	SHIM_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	SHIM_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	SHIM_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	do { } while(0)
+
+#endif /* SHIM_ESP_LOG_H */
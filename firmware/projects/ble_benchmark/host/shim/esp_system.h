@@ -0,0 +1,12 @@
+#ifndef SHIM_ESP_SYSTEM_H
+#define SHIM_ESP_SYSTEM_H
+/**
+ * @file esp_system.h
+ * @brief Host shim: there is no heap to account for, always 0
+ */
+#include <stdint.h>
+#include "esp_err.h"
+
+static inline uint32_t esp_get_free_heap_size(void) { return 0; }
+
+#endif /* SHIM_ESP_SYSTEM_H */
@@ -0,0 +1,24 @@
+#ifndef SHIM_ESP_TIMER_H
+#define SHIM_ESP_TIMER_H
+/**
+ * @file esp_timer.h
+ * @brief Host shim: monotonic time and one shot timers (one thread per timer)
+ */
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct shim_timer * esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct {
+	esp_timer_cb_t callback;
+	void *arg;
+	const char *name;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time(void);
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+#endif /* SHIM_ESP_TIMER_H */
@@ -0,0 +1,24 @@
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim: the FreeRTOS subset used by ble_mcu.c, on POSIX threads
+ *
+ * One tick is one millisecond. Priorities and stack sizes are ignored.
+ */
+#include <stdint.h>
+#include <assert.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE				1
+#define pdFALSE				0
+#define pdPASS				pdTRUE
+#define portMAX_DELAY		((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS	1
+#define pdMS_TO_TICKS(ms)	((TickType_t)(ms))
+#define configASSERT(x)		assert(x)
+
+#endif /* SHIM_FREERTOS_H */
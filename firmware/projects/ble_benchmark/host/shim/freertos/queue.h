@@ -0,0 +1,9 @@
+#ifndef SHIM_QUEUE_H
+#define SHIM_QUEUE_H
+/**
+ * @file queue.h
+ * @brief Host shim: ble_mcu.c doesn't use queues any more, kept for the include
+ */
+#include "freertos/FreeRTOS.h"
+
+#endif /* SHIM_QUEUE_H */
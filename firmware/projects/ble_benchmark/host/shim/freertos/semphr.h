@@ -0,0 +1,16 @@
+#ifndef SHIM_SEMPHR_H
+#define SHIM_SEMPHR_H
+/**
+ * @file semphr.h
+ * @brief Host shim: binary semaphores and mutexes (no priority inheritance)
+ */
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_sem * SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif /* SHIM_SEMPHR_H */
@@ -0,0 +1,18 @@
+#ifndef SHIM_TASK_H
+#define SHIM_TASK_H
+/**
+ * @file task.h
+ * @brief Host shim: tasks and direct to task notifications
+ */
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_task * TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stack, void *param,
+	UBaseType_t priority, TaskHandle_t *handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* SHIM_TASK_H */
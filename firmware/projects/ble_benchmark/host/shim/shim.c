@@ -0,0 +1,232 @@
+/**
+ * @file shim.c
+ * @brief Host shim: FreeRTOS and esp_timer subset on POSIX threads
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+/*==================[typedef]================================================*/
+struct shim_task {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t notify;				/* Pending notifications */
+	TaskFunction_t func;
+	void *param;
+};
+
+struct shim_sem {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t count;					/* 0 or 1 */
+};
+
+struct shim_timer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int64_t deadline_us;			/* -1: stopped */
+	esp_timer_cb_t callback;
+	void *arg;
+};
+/*==================[internal data declaration]==============================*/
+static __thread struct shim_task *current_task = NULL;
+/*==================[external data definition]===============================*/
+bool shim_log_enabled = false;
+/*==================[internal functions definition]==========================*/
+static void init_cond(pthread_cond_t *cond) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static struct timespec abs_time_us(int64_t time_us) {
+	struct timespec ts = {
+		.tv_sec = time_us / 1000000,
+		.tv_nsec = (time_us % 1000000) * 1000
+	};
+	return ts;
+}
+
+/* Waits on cond until pred is true or ticks expire, returns pred */
+#define WAIT_UNTIL(pred, cond, lock, ticks) ({ \
+	int64_t deadline_us = esp_timer_get_time() + (int64_t)(ticks) * 1000; \
+	struct timespec ts = abs_time_us(deadline_us); \
+	while(!(pred)){ \
+		if((ticks) == portMAX_DELAY){ \
+			pthread_cond_wait(cond, lock); \
+		}else if(pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT){ \
+			break; \
+		} \
+	} \
+	(pred); })
+
+static void * task_entry(void *arg) {
+	struct shim_task *task = arg;
+	current_task = task;
+	task->func(task->param);
+	return NULL;
+}
+
+static void * timer_thread(void *arg) {
+	struct shim_timer *timer = arg;
+	struct timespec ts;
+	pthread_mutex_lock(&timer->lock);
+	while(1){
+		if(timer->deadline_us < 0){
+			pthread_cond_wait(&timer->cond, &timer->lock);
+			continue;
+		}
+		if(esp_timer_get_time() < timer->deadline_us){
+			ts = abs_time_us(timer->deadline_us);
+			pthread_cond_timedwait(&timer->cond, &timer->lock, &ts);
+			continue;
+		}
+		timer->deadline_us = -1;
+		pthread_mutex_unlock(&timer->lock);
+		timer->callback(timer->arg);
+		pthread_mutex_lock(&timer->lock);
+	}
+	return NULL;
+}
+
+/*==================[external functions definition]==========================*/
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stack, void *param,
+		UBaseType_t priority, TaskHandle_t *handle){
+	struct shim_task *task = calloc(1, sizeof(struct shim_task));
+	configASSERT(task);
+	pthread_mutex_init(&task->lock, NULL);
+	init_cond(&task->cond);
+	task->func = func;
+	task->param = param;
+	/* the handle is valid before the task runs, as the driver expects */
+	if(handle != NULL){
+		*handle = task;
+	}
+	pthread_create(&task->thread, NULL, task_entry, task);
+	pthread_detach(task->thread);
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks){
+	struct shim_task *task = current_task;
+	uint32_t value;
+	configASSERT(task);
+	pthread_mutex_lock(&task->lock);
+	WAIT_UNTIL(task->notify > 0, &task->cond, &task->lock, ticks);
+	value = task->notify;
+	if(value > 0){
+		task->notify = clear ? 0 : value - 1;
+	}
+	pthread_mutex_unlock(&task->lock);
+	return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+	pthread_mutex_lock(&task->lock);
+	task->notify++;
+	pthread_cond_signal(&task->cond);
+	pthread_mutex_unlock(&task->lock);
+	return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks){
+	struct timespec ts = {
+		.tv_sec = ticks / 1000,
+		.tv_nsec = (ticks % 1000) * 1000000L
+	};
+	nanosleep(&ts, NULL);
+}
+
+static SemaphoreHandle_t sem_create(uint32_t count) {
+	struct shim_sem *sem = calloc(1, sizeof(struct shim_sem));
+	if(sem != NULL){
+		pthread_mutex_init(&sem->lock, NULL);
+		init_cond(&sem->cond);
+		sem->count = count;
+	}
+	return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void){
+	return sem_create(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void){
+	return sem_create(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks){
+	BaseType_t taken;
+	pthread_mutex_lock(&sem->lock);
+	taken = WAIT_UNTIL(sem->count > 0, &sem->cond, &sem->lock, ticks) ? pdTRUE : pdFALSE;
+	if(taken){
+		sem->count = 0;
+	}
+	pthread_mutex_unlock(&sem->lock);
+	return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem){
+	pthread_mutex_lock(&sem->lock);
+	sem->count = 1;
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->lock);
+	return pdTRUE;
+}
+
+int64_t esp_timer_get_time(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle){
+	struct shim_timer *timer = calloc(1, sizeof(struct shim_timer));
+	if(timer == NULL){
+		return ESP_FAIL;
+	}
+	pthread_mutex_init(&timer->lock, NULL);
+	init_cond(&timer->cond);
+	timer->deadline_us = -1;
+	timer->callback = args->callback;
+	timer->arg = args->arg;
+	pthread_create(&timer->thread, NULL, timer_thread, timer);
+	pthread_detach(timer->thread);
+	*handle = timer;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us){
+	pthread_mutex_lock(&timer->lock);
+	timer->deadline_us = esp_timer_get_time() + timeout_us;
+	pthread_cond_signal(&timer->cond);
+	pthread_mutex_unlock(&timer->lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer){
+	pthread_mutex_lock(&timer->lock);
+	timer->deadline_us = -1;
+	pthread_cond_signal(&timer->cond);
+	pthread_mutex_unlock(&timer->lock);
+	return ESP_OK;
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,304 @@
+/**
+ * @file sim_port.c
+ * @brief Simulated BLE link (see sim_port.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "sim_port.h"
+#include "ble_mcu_port.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_timer.h"
+/*==================[macros and definitions]=================================*/
+#define STACK_BUFS_MAX		64
+#define INITIAL_INTERVAL	24		/* 30 ms, until the driver asks for other parameters */
+#define SUPERVISION_TIMEOUT	400
+#define LL_PDU_MAX			27		/* LL payload without Data Length Extension */
+#define LL_PDU_DLE			251
+#define L2CAP_HDR_SIZE		4
+#define LL_OVERHEAD			10		/* Preamble, access address, header and CRC (1M PHY) */
+#define T_IFS_US			150		/* Inter frame space */
+#define EMPTY_PDU_US		80		/* Empty PDU from the central, 1M PHY */
+#define ERROR_SEED			1234
+/*==================[typedef]================================================*/
+typedef struct {
+	ble_port_char_t characteristic;
+	uint16_t length;
+	uint8_t data[BLE_MTU_REQUEST - BLE_ATT_HDR_SIZE];
+} sim_buf_t;
+
+/* One connection: notifications held by the stack and central side counters */
+typedef struct {
+	sim_buf_t bufs[STACK_BUFS_MAX];
+	uint8_t buf_head, buf_tail, buf_count;
+	bool tx_busy;								/* BlePortNotify returned busy, report the release */
+	sim_central_t central;
+} sim_peer_t;
+/*==================[internal data declaration]==============================*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t link_thread;
+static sim_link_t sim_link;
+static sim_peer_t peers[SIM_CENTRALS_MAX];
+static sim_notify_func receiver_p = NULL;
+static bool connect_req = false;			/* Requests from the bench, served by the link thread */
+static bool disconnect_req = false;
+static bool connected = false;
+static uint16_t interval = INITIAL_INTERVAL;
+static uint16_t latency = 0;
+static bool params_changed = false;			/* BlePortUpdateConnParams since the last event */
+static unsigned int error_seed = ERROR_SEED;
+/*==================[internal functions definition]==========================*/
+static void sleep_until(int64_t time_us) {
+	struct timespec ts;
+	int64_t now_us = esp_timer_get_time();
+	if(time_us <= now_us){
+		return;
+	}
+	ts.tv_sec = (time_us - now_us) / 1000000;
+	ts.tv_nsec = ((time_us - now_us) % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+/* Air time of a notification and the empty PDUs of the central, in us */
+static uint32_t notification_time(uint16_t length, uint8_t *pdus) {
+	uint32_t bytes = length + BLE_ATT_HDR_SIZE + L2CAP_HDR_SIZE;
+	uint32_t pdu_max = sim_link.dle ? LL_PDU_DLE : LL_PDU_MAX;
+	uint32_t time_us = 0, chunk;
+	uint8_t divider = sim_link.phy_2m ? 2 : 1;
+	*pdus = 0;
+	while(bytes > 0){
+		chunk = (bytes > pdu_max) ? pdu_max : bytes;
+		time_us += (chunk + LL_OVERHEAD) * 8 / divider + T_IFS_US + EMPTY_PDU_US / divider + T_IFS_US;
+		bytes -= chunk;
+		(*pdus)++;
+	}
+	return time_us;
+}
+
+/* Sends the notifications of one central that fit in its connection event, returns the number sent */
+static uint32_t connection_event(uint8_t id) {
+	sim_peer_t *peer = &peers[id];
+	uint32_t budget_us = interval * 1250 / sim_link.centrals - T_IFS_US;
+	uint32_t used_us = 0, time_us, sent = 0;
+	uint8_t pdus, used_pdus = 0;
+	sim_buf_t *buf;
+	pthread_mutex_lock(&lock);
+	while(peer->buf_count > 0){
+		buf = &peer->bufs[peer->buf_tail];
+		time_us = notification_time(buf->length, &pdus);
+		/* the first notification always goes, the event is extended if needed */
+		if((sent > 0) && ((used_us + time_us > budget_us) || (used_pdus + pdus > sim_link.max_pdus))){
+			break;
+		}
+		used_us += time_us;
+		used_pdus += pdus;
+		pthread_mutex_unlock(&lock);
+		/* the buffer isn't reused until it's released below */
+		if(receiver_p != NULL){
+			receiver_p(id, buf->characteristic == BLE_PORT_STREAM, buf->data, buf->length);
+		}
+		pthread_mutex_lock(&lock);
+		peer->central.last_us = esp_timer_get_time();
+		if(peer->central.notifications == 0){
+			peer->central.first_us = peer->central.last_us;
+		}
+		peer->central.notifications++;
+		peer->central.bytes += buf->length;
+		peer->buf_tail = (peer->buf_tail + 1) % STACK_BUFS_MAX;
+		peer->buf_count--;
+		sent++;
+	}
+	peer->central.events++;
+	if(sent > 0){
+		peer->central.data_events++;
+	}
+	pthread_mutex_unlock(&lock);
+	return sent;
+}
+
+static void connect_centrals(void) {
+	ble_conn_params_t params = {
+		.interval = INITIAL_INTERVAL,
+		.latency = 0,
+		.timeout = SUPERVISION_TIMEOUT
+	};
+	pthread_mutex_lock(&lock);
+	interval = INITIAL_INTERVAL;
+	latency = 0;
+	params_changed = false;
+	memset(peers, 0, sizeof(peers));
+	error_seed = ERROR_SEED;
+	connected = true;
+	pthread_mutex_unlock(&lock);
+	/* same order of events as the real hosts */
+	for(uint8_t id = 0; id < sim_link.centrals; id++){
+		BleOnConnect(id, &params);
+		BleOnSecured(id);
+		BleOnMtu(id, sim_link.mtu);
+		BleOnSubscribe(id, BLE_PORT_DATA, true);
+		BleOnSubscribe(id, BLE_PORT_STREAM, true);
+	}
+}
+
+static void * link_task(void *arg) {
+	int64_t event_us, next_write_us = 0;
+	uint8_t write[SIM_WRITE_LEN] = {0};
+	ble_conn_params_t params;
+	bool released;
+	uint8_t id;
+	BleOnAdvertising();
+	while(1){
+		pthread_mutex_lock(&lock);
+		while(!connect_req){
+			pthread_cond_wait(&cond, &lock);
+		}
+		connect_req = false;
+		pthread_mutex_unlock(&lock);
+		connect_centrals();
+		event_us = esp_timer_get_time();
+		next_write_us = event_us + sim_link.write_period_us;
+		while(1){
+			event_us += interval * 1250;
+			sleep_until(event_us);
+			pthread_mutex_lock(&lock);
+			if(disconnect_req){
+				disconnect_req = false;
+				connected = false;
+				for(id = 0; id < sim_link.centrals; id++){
+					peers[id].buf_count = 0;
+				}
+				pthread_mutex_unlock(&lock);
+				for(id = 0; id < sim_link.centrals; id++){
+					BleOnDisconnect(id);
+				}
+				BleOnAdvertising();
+				break;
+			}
+			if(params_changed){
+				params_changed = false;
+				params.interval = interval;
+				params.latency = latency;
+				params.timeout = SUPERVISION_TIMEOUT;
+				pthread_mutex_unlock(&lock);
+				for(id = 0; id < sim_link.centrals; id++){
+					BleOnConnParams(id, &params);
+				}
+			}else{
+				pthread_mutex_unlock(&lock);
+			}
+			/* writes of the first central issued since the last event go in this one */
+			while((sim_link.write_period_us > 0) && (next_write_us <= event_us)){
+				for(uint8_t i = 0; i < sizeof(int64_t); i++){
+					write[i] = ((uint64_t)next_write_us >> (8 * i)) & 0xFF;
+				}
+				BleOnWrite(write, sizeof(write));
+				peers[0].central.writes++;
+				next_write_us += sim_link.write_period_us;
+			}
+			for(id = 0; id < sim_link.centrals; id++){
+				if(connection_event(id) > 0){
+					pthread_mutex_lock(&lock);
+					released = peers[id].tx_busy;
+					peers[id].tx_busy = false;
+					pthread_mutex_unlock(&lock);
+					if(released){
+						BleOnCongest(id, false);
+					}
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+/*==================[external functions definition]==========================*/
+bool BlePortInit(const char *device_name, uint16_t mtu){
+	return pthread_create(&link_thread, NULL, link_task, NULL) == 0;
+}
+
+ble_port_result_t BlePortNotify(uint8_t conn, ble_port_char_t characteristic, const uint8_t *data, uint16_t length){
+	sim_peer_t *peer = &peers[conn];
+	sim_buf_t *buf;
+	ble_port_result_t result = BLE_PORT_OK;
+	pthread_mutex_lock(&lock);
+	if(!connected || (conn >= sim_link.centrals)){
+		result = BLE_PORT_ERROR;
+	}else if((sim_link.error_permille > 0) && ((rand_r(&error_seed) % 1000) < sim_link.error_permille)){
+		result = BLE_PORT_ERROR;
+	}else if(peer->buf_count >= sim_link.stack_bufs){
+		peer->tx_busy = true;
+		result = BLE_PORT_BUSY;
+	}else{
+		/* the stack copies the payload, like ble_hs_mbuf_from_flat */
+		buf = &peer->bufs[peer->buf_head];
+		buf->characteristic = characteristic;
+		buf->length = length;
+		memcpy(buf->data, data, length);
+		peer->buf_head = (peer->buf_head + 1) % STACK_BUFS_MAX;
+		peer->buf_count++;
+	}
+	pthread_mutex_unlock(&lock);
+	return result;
+}
+
+bool BlePortUpdateConnParams(uint8_t conn, const ble_conn_req_t *req){
+	pthread_mutex_lock(&lock);
+	/* the centrals grant the shortest interval of the range, all of them share it */
+	interval = req->min_int;
+	latency = req->latency;
+	params_changed = true;
+	pthread_mutex_unlock(&lock);
+	return true;
+}
+
+void SimSetReceiver(sim_notify_func func_p){
+	receiver_p = func_p;
+}
+
+void SimConnect(const sim_link_t *new_link){
+	pthread_mutex_lock(&lock);
+	sim_link = *new_link;
+	if(sim_link.stack_bufs > STACK_BUFS_MAX){
+		sim_link.stack_bufs = STACK_BUFS_MAX;
+	}
+	if(sim_link.centrals == 0){
+		sim_link.centrals = 1;
+	}else if(sim_link.centrals > SIM_CENTRALS_MAX){
+		sim_link.centrals = SIM_CENTRALS_MAX;
+	}
+	connect_req = true;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+void SimDisconnect(void){
+	pthread_mutex_lock(&lock);
+	disconnect_req = true;
+	pthread_mutex_unlock(&lock);
+}
+
+bool SimBusy(void){
+	bool busy = false;
+	pthread_mutex_lock(&lock);
+	for(uint8_t id = 0; id < SIM_CENTRALS_MAX; id++){
+		busy |= peers[id].buf_count > 0;
+	}
+	pthread_mutex_unlock(&lock);
+	return busy;
+}
+
+void SimGetCentral(uint8_t central, sim_central_t *copy){
+	pthread_mutex_lock(&lock);
+	*copy = peers[central].central;
+	pthread_mutex_unlock(&lock);
+}
+/*==================[end of file]============================================*/
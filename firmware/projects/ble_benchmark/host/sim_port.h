@@ -0,0 +1,91 @@
+#ifndef SIM_PORT_H
+#define SIM_PORT_H
+/**
+ * @file sim_port.h
+ * @brief Simulated BLE link for ble_mcu.c on a host without radio
+ *
+ * Implements the backend interface of the driver (ble_mcu_port.h) with a model
+ * of a connection: the stack holds up to stack_bufs notifications, and every
+ * connection interval the link sends as many of them as fit in the event
+ * (LL PDUs of up to 27 or 251 bytes, at 1M or 2M PHY, capped at max_pdus like
+ * most centrals do). The central writes to the data characteristic every
+ * write_period_us and the write is delivered at the next connection event.
+ * With several centrals each one has its own stack buffers and gets an equal
+ * share of the connection interval, one connection event after the other.
+ *
+ * @version 0.1
+ * @date 19/10/2026
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ble_mcu.h"
+/*==================[macros]=================================================*/
+#define SIM_WRITE_LEN		20		/* Bytes of every central write, starting with its time stamp */
+#define SIM_CENTRALS_MAX	BLE_MAX_CONN
+/*==================[typedef]================================================*/
+/** @brief Link settings, applied on SimConnect */
+typedef struct {
+	uint16_t mtu;				/*!< ATT MTU granted by the central */
+	bool dle;					/*!< Data Length Extension (251 bytes LL PDUs) */
+	bool phy_2m;				/*!< 2M PHY */
+	uint8_t max_pdus;			/*!< LL PDUs the central accepts per connection event */
+	uint8_t stack_bufs;			/*!< Notifications the stack can hold */
+	uint16_t error_permille;	/*!< Notifications rejected by the stack, to check the retries */
+	uint32_t write_period_us;	/*!< Time between writes of the first central (0: no writes) */
+	uint8_t centrals;			/*!< Centrals connected at the same time (1 to SIM_CENTRALS_MAX) */
+} sim_link_t;
+
+/** @brief Counters of the central side, cleared by SimConnect */
+typedef struct {
+	uint32_t events;			/*!< Connection events */
+	uint32_t data_events;		/*!< Connection events with at least one notification */
+	uint32_t notifications;		/*!< Notifications received */
+	uint64_t bytes;				/*!< Payload bytes received */
+	int64_t first_us;			/*!< Time of the first notification */
+	int64_t last_us;			/*!< Time of the last notification */
+	uint32_t writes;			/*!< Writes delivered to the peripheral */
+} sim_central_t;
+
+/**
+ * @brief Prototype of the central side receiver, called for every notification
+ *
+ * @param central   central that got it (0 to centrals - 1)
+ * @param stream    true for the stream characteristic, false for the data one
+ * @param data      notification payload
+ * @param length    payload length
+ */
+typedef void (*sim_notify_func) (uint8_t central, bool stream, const uint8_t *data, uint16_t length);
+/*==================[external functions declaration]=========================*/
+/**
+ * @brief Sets the central side receiver (before BleInit)
+ */
+void SimSetReceiver(sim_notify_func func_p);
+
+/**
+ * @brief Connects the centrals, the driver is notified from the link thread
+ */
+void SimConnect(const sim_link_t *link);
+
+/**
+ * @brief Disconnects the centrals
+ */
+void SimDisconnect(void);
+
+/**
+ * @brief Tells whether the stack has notifications waiting for a connection event
+ */
+bool SimBusy(void);
+
+/**
+ * @brief Copies the counters of one central
+ */
+void SimGetCentral(uint8_t central, sim_central_t *copy);
+
+#endif /* SIM_PORT_H */
+/*==================[end of file]============================================*/
@@ -0,0 +1,97 @@
+/**
+ * @file bench_record.c
+ * @brief Test records of the BLE benchmark (see bench_record.h)
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include "bench_record.h"
+#include <string.h>
+/*==================[macros and definitions]=================================*/
+#define RECORD_SUM_POS		(BENCH_RECORD_SIZE - 2)
+/*==================[internal functions definition]==========================*/
+static uint16_t record_sum(const uint8_t *record) {
+	uint16_t sum = 0;
+	for(uint8_t i = 0; i < RECORD_SUM_POS; i++){
+		sum += record[i];
+	}
+	return sum;
+}
+
+static bool record_valid(const uint8_t *record) {
+	uint16_t sum = record[RECORD_SUM_POS] | (record[RECORD_SUM_POS + 1] << 8);
+	return (record[0] == BENCH_RECORD_MAGIC) && (record[1] == BENCH_RECORD_VERSION) &&
+		(record_sum(record) == sum);
+}
+
+/*==================[external functions definition]==========================*/
+void BenchRecordFill(uint8_t *record, uint32_t seq, int64_t time_us){
+	uint16_t sum;
+	record[0] = BENCH_RECORD_MAGIC;
+	record[1] = BENCH_RECORD_VERSION;
+	for(uint8_t i = 0; i < 4; i++){
+		record[2 + i] = (seq >> (8 * i)) & 0xFF;
+	}
+	for(uint8_t i = 0; i < 8; i++){
+		record[6 + i] = ((uint64_t)time_us >> (8 * i)) & 0xFF;
+	}
+	sum = record_sum(record);
+	record[RECORD_SUM_POS] = sum & 0xFF;
+	record[RECORD_SUM_POS + 1] = sum >> 8;
+}
+
+void BenchRecordReset(bench_rx_t *rx){
+	memset(rx, 0, sizeof(bench_rx_t));
+}
+
+void BenchRecordParse(bench_rx_t *rx, const uint8_t *data, size_t length, bench_record_func func_p, void *arg){
+	uint32_t seq;
+	uint64_t time_us;
+	while(length > 0){
+		/* a record starts with the magic byte, anything else is skipped */
+		if((rx->len == 0) && (*data != BENCH_RECORD_MAGIC)){
+			rx->corrupted++;
+			data++;
+			length--;
+			continue;
+		}
+		rx->buf[rx->len++] = *data++;
+		length--;
+		if(rx->len < BENCH_RECORD_SIZE){
+			continue;
+		}
+		if(!record_valid(rx->buf)){
+			/* resync one byte after the false start */
+			rx->corrupted++;
+			memmove(rx->buf, &rx->buf[1], --rx->len);
+			while((rx->len > 0) && (rx->buf[0] != BENCH_RECORD_MAGIC)){
+				rx->corrupted++;
+				memmove(rx->buf, &rx->buf[1], --rx->len);
+			}
+			continue;
+		}
+		rx->len = 0;
+		seq = 0;
+		time_us = 0;
+		for(uint8_t i = 0; i < 4; i++){
+			seq |= (uint32_t)rx->buf[2 + i] << (8 * i);
+		}
+		for(uint8_t i = 0; i < 8; i++){
+			time_us |= (uint64_t)rx->buf[6 + i] << (8 * i);
+		}
+		if(rx->started && (seq != rx->next_seq)){
+			rx->lost += seq - rx->next_seq;
+		}
+		rx->started = true;
+		rx->next_seq = seq + 1;
+		rx->records++;
+		if(func_p != NULL){
+			func_p(seq, (int64_t)time_us, arg);
+		}
+	}
+}
+/*==================[end of file]============================================*/
@@ -0,0 +1,92 @@
+#ifndef BENCH_RECORD_H
+#define BENCH_RECORD_H
+/** \addtogroup BLE_Benchmark
+ ** @{ */
+
+/** \brief Test records sent by the BLE benchmark.
+ *
+ * The benchmark fills the TX stream with fixed size records (little endian):
+ *
+ * | Bytes  | Content                                              |
+ * |:------:|:-----------------------------------------------------|
+ * | 0      | BENCH_RECORD_MAGIC                                   |
+ * | 1      | BENCH_RECORD_VERSION                                 |
+ * | 2-5    | Sequence number                                      |
+ * | 6-13   | Time stamp of the BleSendBuffer call (us)            |
+ * | 14-15  | Sum of bytes 0 to 13                                 |
+ *
+ * Records don't follow notification boundaries, so they also check the
+ * segmentation of the driver: a receiver rebuilds them from the byte stream,
+ * counts sequence gaps as lost records and bytes that don't form a valid record
+ * as corrupted.
+ *
+ * @section changelog
+ *
+ * |   Date	    | Description                                    						|
+ * |:----------:|:----------------------------------------------------------------------|
+ * | 19/10/2026 | Document creation		                         						|
+ *
+ **/
+
+/*==================[inclusions]=============================================*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+/*==================[macros]=================================================*/
+#define BENCH_RECORD_SIZE		16		/*!< Bytes of every record */
+#define BENCH_RECORD_MAGIC		0xB5	/*!< First byte of every record (not ASCII, text lines start with '#') */
+#define BENCH_RECORD_VERSION	1		/*!< Record format version */
+/*==================[typedef]================================================*/
+/**
+ * @brief Receiver side state, rebuilds records from a byte stream
+ */
+typedef struct {
+	uint8_t buf[BENCH_RECORD_SIZE];	/*!< Bytes of the record being received */
+	uint8_t len;					/*!< Bytes in buf */
+	bool started;					/*!< At least one record received */
+	uint32_t next_seq;				/*!< Expected sequence number */
+	uint32_t records;				/*!< Valid records received */
+	uint32_t lost;					/*!< Records missing in the sequence */
+	uint32_t corrupted;				/*!< Bytes discarded while looking for a valid record */
+} bench_rx_t;
+
+/**
+ * @brief Prototype of the function called for every valid record
+ *
+ * @param seq       sequence number
+ * @param time_us   time stamp of the record
+ * @param arg       argument given to BenchRecordParse
+ */
+typedef void (*bench_record_func) (uint32_t seq, int64_t time_us, void *arg);
+/*==================[external functions declaration]=========================*/
+/**
+ * @brief Writes a record
+ *
+ * @param record    Pointer to a BENCH_RECORD_SIZE bytes array
+ * @param seq       Sequence number
+ * @param time_us   Time stamp
+ */
+void BenchRecordFill(uint8_t *record, uint32_t seq, int64_t time_us);
+
+/**
+ * @brief Clears the receiver state, before a new test
+ *
+ * @param rx    Receiver state
+ */
+void BenchRecordReset(bench_rx_t *rx);
+
+/**
+ * @brief Feeds received bytes to the receiver
+ *
+ * @param rx        Receiver state
+ * @param data      Received bytes (one notification)
+ * @param length    Number of bytes
+ * @param func_p    Called for every valid record (NULL if not required)
+ * @param arg       Argument passed to func_p
+ */
+void BenchRecordParse(bench_rx_t *rx, const uint8_t *data, size_t length, bench_record_func func_p, void *arg);
+
+/** @} doxygen end group definition */
+#endif /* BENCH_RECORD_H */
+
+/*==================[end of file]============================================*/
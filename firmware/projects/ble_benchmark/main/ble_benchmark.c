@@ -0,0 +1,173 @@
+/*! @mainpage BLE benchmark
+ *
+ * @section genDesc General Description
+ *
+ * Mide el rendimiento del driver ble_mcu: throughput de notificaciones, latencia
+ * escritura - notificación (ping) y pérdida de datos, con los parámetros de conexión
+ * y MTU que negocie la central.
+ *
+ * La central (tools/ble/ble_bench.py, o cualquier aplicación BLE) escribe comandos
+ * de texto en la característica 0xFFE1:
+ *
+ * | Comando        | Acción                                                             |
+ * |:---------------|:-------------------------------------------------------------------|
+ * | T<ms>          | Envía registros de prueba (bench_record.h) durante ms milisegundos |
+ * | P<datos>       | Devuelve la misma escritura (ping)                                 |
+ * | C<min>,<max>   | Pide un intervalo de conexión (x 1.25 ms)                          |
+ * | K<ms>          | Plazo de agrupamiento de envíos (BleSetCoalescing)                 |
+ * | S              | Envía las estadísticas de la conexión                              |
+ *
+ * Al terminar una prueba T y ante el comando S se envía una línea de texto:
+ * "#S mtu=.. ci=.. bytes=.. notif=.. thr=.. lat=../.. drop=.. busy=.. err=.. eff=..\n".
+ *
+ * Sin placa se puede ejecutar el mismo driver contra un enlace simulado, ver README.md.
+ *
+ * @section changelog Changelog
+ *
+ * |   Date	    | Description                                    |
+ * |:----------:|:-----------------------------------------------|
+ * | 19/10/2026 | Document creation		                         |
+ *
+ */
+
+/*==================[inclusions]=============================================*/
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "led.h"
+#include "ble_mcu.h"
+#include "bench_record.h"
+/*==================[macros and definitions]=================================*/
+#define CONFIG_BLINK_PERIOD 500
+#define LED_BT				LED_1
+#define LED_TEST			LED_2
+#define RECORDS_PER_WRITE	16		/* Records per BleSendBuffer call */
+#define DRAIN_TIMEOUT_MS	5000	/* Maximum wait for the TX buffer to empty after a test */
+#define CMD_MAX_LEN			32
+/*==================[internal data definition]===============================*/
+static TaskHandle_t bench_task_handle = NULL;
+static char command[CMD_MAX_LEN + 1];		/* Last command, for the benchmark task */
+static uint8_t records[RECORDS_PER_WRITE * BENCH_RECORD_SIZE];
+static uint32_t seq = 0;
+/*==================[internal functions declaration]=========================*/
+/**
+ * @brief Función a ejecutarse ante la recepción de datos a través de la conexión BLE.
+ *
+ * @param data      Puntero a array de datos recibidos
+ * @param length    Longitud del array de datos recibidos
+ */
+void read_data(uint8_t * data, size_t length){
+	if(length == 0){
+		return;
+	}
+	if(data[0] == 'P'){
+		/* el ping se responde acá mismo, para no sumar el cambio de tarea */
+		BleSendBuffer((const char *)data, length);
+		return;
+	}
+	if(length > CMD_MAX_LEN){
+		length = CMD_MAX_LEN;
+	}
+	memcpy(command, data, length);
+	command[length] = '\0';
+	xTaskNotifyGive(bench_task_handle);
+}
+
+/**
+ * @brief Envía las estadísticas de la conexión como una línea de texto.
+ */
+static void send_stats(void){
+	ble_stats_t stats;
+	ble_conn_params_t params;
+	char msg[160];
+	BleGetStats(&stats);
+	BleGetConnParams(&params);
+	snprintf(msg, sizeof(msg), "#S mtu=%u ci=%u bytes=%" PRIu32 " notif=%" PRIu32 " thr=%" PRIu32 " lat=%" PRIu32 "/%" PRIu32
+		" drop=%" PRIu32 " busy=%" PRIu32 " err=%" PRIu32 " eff=%u\n",
+		BleGetMtu(), params.interval, stats.bytes_sent, stats.notifications, stats.throughput,
+		stats.avg_latency_us, stats.max_latency_us, stats.dropped, stats.congestions,
+		stats.send_errors, stats.efficiency);
+	BleSendString(msg);
+}
+
+/**
+ * @brief Llena el buffer de transmisión con registros de prueba durante duration_ms.
+ */
+static void throughput_test(uint32_t duration_ms){
+	int64_t end_us = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+	uint32_t waited = 0;
+	LedOn(LED_TEST);
+	while((esp_timer_get_time() < end_us) && (BleStatus() == BLE_CONNECTED)){
+		for(uint8_t i = 0; i < RECORDS_PER_WRITE; i++){
+			BenchRecordFill(&records[i * BENCH_RECORD_SIZE], seq++, esp_timer_get_time());
+		}
+		/* bloquea mientras el buffer está lleno: el enlace marca el ritmo */
+		BleSendBuffer((const char *)records, sizeof(records));
+	}
+	while((BleSendFree() < BLE_TX_BUFFER_SIZE) && (waited < DRAIN_TIMEOUT_MS)){
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+		waited += 10;
+	}
+	LedOff(LED_TEST);
+	send_stats();
+}
+
+static void bench_task(void *pvParameter){
+	char *end;
+	uint16_t min_int, max_int;
+	while(1){
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		switch(command[0]){
+			case 'T':
+				throughput_test(strtoul(&command[1], NULL, 10));
+			break;
+			case 'C':
+				min_int = strtoul(&command[1], &end, 10);
+				max_int = (*end == ',') ? strtoul(end + 1, NULL, 10) : min_int;
+				BleSetConnInterval(min_int, max_int);
+			break;
+			case 'K':
+				BleSetCoalescing(strtoul(&command[1], NULL, 10));
+			break;
+			case 'S':
+				send_stats();
+			break;
+		}
+	}
+}
+
+/*==================[external functions definition]==========================*/
+void app_main(void){
+	ble_config_t ble_configuration = {
+		.device_name = "ESP_EDU_BENCH",
+		.func_p = BLE_NO_INT,
+		.long_func_p = read_data
+	};
+
+	LedsInit();
+	xTaskCreate(&bench_task, "bench", 4096, NULL, 5, &bench_task_handle);
+	BleInit(&ble_configuration);
+	while(1){
+		vTaskDelay(CONFIG_BLINK_PERIOD / portTICK_PERIOD_MS);
+		switch(BleStatus()){
+			case BLE_OFF:
+				LedOff(LED_BT);
+			break;
+			case BLE_DISCONNECTED:
+				LedToggle(LED_BT);
+			break;
+			case BLE_CONNECTED:
+				LedOn(LED_BT);
+			break;
+		}
+	}
+}
+
+/*==================[end of file]============================================*/
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Reference decoder for the ble_beacon_mcu telemetry advertisements.
+
+The readings travel in a Manufacturer Specific Data structure (AD type 0xFF),
+little endian:
+
+    byte 0-1  company id 0xFFFF
+    byte 2    format version
+    byte 3    node id
+    byte 4    frame counter, incremented every time a reading changes
+    byte 5-   readings: tag (id << 3 | format) followed by the value
+
+Scanners receive every frame many times (once per advertising event), repeated
+frames of a node are dropped and counter gaps are reported as missed frames.
+Input is a capture with one advertisement per line in hex, either the whole AD
+structure list or just the manufacturer data, or a live scan when the optional
+`bleak` package is installed:
+
+    python3 ble_beacon_decoder.py capture.txt > readings.csv
+    python3 ble_beacon_decoder.py --live --seconds 60 > readings.csv
+
+The live scan only sees legacy and extended advertising, the periodic train of
+BLE_BEACON_PERIODIC needs a scanner able to synchronize (nRF Connect does).
+"""
+import argparse
+import struct
+import sys
+import time
+from dataclasses import dataclass
+
+COMPANY_ID = 0xFFFF
+VERSION = 1
+AD_MANUFACTURER = 0xFF
+HEADER = struct.Struct("<HBBB")
+
+# ble_beacon_format_t -> struct format character
+FORMATS = {0: "b", 1: "B", 2: "h", 3: "H", 4: "i", 5: "f"}
+
+
+@dataclass
+class Frame:
+    node: int
+    counter: int
+    readings: dict
+
+
+def manufacturer_data(data):
+    """Manufacturer data of an AD structure list, or data itself if it already is."""
+    if len(data) >= 2 and struct.unpack_from("<H", data)[0] == COMPANY_ID:
+        return data
+    pos = 0
+    while pos + 1 < len(data) and data[pos] > 0:
+        length, ad_type = data[pos], data[pos + 1]
+        if ad_type == AD_MANUFACTURER:
+            return data[pos + 2:pos + 1 + length]
+        pos += 1 + length
+    return None
+
+
+def parse_frame(data):
+    """Decode the manufacturer data (company id included) into a Frame."""
+    if len(data) < HEADER.size:
+        raise ValueError("frame shorter than the header")
+    company, version, node, counter = HEADER.unpack_from(data)
+    if company != COMPANY_ID:
+        raise ValueError("company id 0x%04X is not a beacon" % company)
+    if version != VERSION:
+        raise ValueError("unsupported format version %d" % version)
+    readings = {}
+    pos = HEADER.size
+    while pos < len(data):
+        tag = data[pos]
+        reading_id, fmt = tag >> 3, tag & 0x07
+        if fmt not in FORMATS:
+            # the size of an unknown format is unknown too, nothing after it can be read
+            raise ValueError("unknown format %d of reading %d" % (fmt, reading_id))
+        readings[reading_id] = struct.unpack_from("<" + FORMATS[fmt], data, pos + 1)[0]
+        pos += 1 + struct.calcsize(FORMATS[fmt])
+    return Frame(node, counter, readings)
+
+
+class BeaconDecoder:
+    """Drops repeated frames of every node and counts the missed ones."""
+
+    def __init__(self):
+        self.last = {}
+        self.frames = {}
+        self.missed = {}
+
+    def feed(self, frame):
+        """Returns the frame if it's new, None if it was already received."""
+        last = self.last.get(frame.node)
+        if not frame.readings or last == frame.counter:
+            # header only: no readings yet, or the advertising set of a periodic beacon
+            return None
+        if last is not None:
+            self.missed[frame.node] = self.missed.get(frame.node, 0) + ((frame.counter - last - 1) & 0xFF)
+        self.last[frame.node] = frame.counter
+        self.frames[frame.node] = self.frames.get(frame.node, 0) + 1
+        return frame
+
+
+def write_csv(frame, stamp, out):
+    for reading_id, value in sorted(frame.readings.items()):
+        out.write("%s,%d,%d,%d,%s\n" % (stamp, frame.node, frame.counter, reading_id, value))
+
+
+def summary(decoder, out):
+    for node, frames in sorted(decoder.frames.items()):
+        out.write("node %d: %d frames, %d missed\n" % (node, frames, decoder.missed.get(node, 0)))
+
+
+def decode_capture(path, decoder, out):
+    src = sys.stdin if path == "-" else open(path)
+    with src:
+        for number, line in enumerate(src, 1):
+            text = line.strip().replace("0x", "").replace("-", "").replace(":", "").replace(" ", "")
+            if not text or text.startswith("#"):
+                continue
+            try:
+                data = manufacturer_data(bytes.fromhex(text))
+                if data is None:
+                    continue
+                frame = decoder.feed(parse_frame(data))
+            except (ValueError, struct.error) as error:
+                # a bad line (truncated capture, other beacon) doesn't stop the decode
+                sys.stderr.write("line %d: %s\n" % (number, error))
+                continue
+            if frame is not None:
+                write_csv(frame, number, out)
+
+
+def decode_live(decoder, out, seconds):
+    import asyncio
+    from bleak import BleakScanner
+
+    start = time.monotonic()
+
+    def on_advertisement(_, adv):
+        data = adv.manufacturer_data.get(COMPANY_ID)
+        if data is None:
+            return
+        try:
+            # bleak strips the company id
+            frame = decoder.feed(parse_frame(struct.pack("<H", COMPANY_ID) + bytes(data)))
+        except (ValueError, struct.error):
+            return
+        if frame is not None:
+            write_csv(frame, "%.3f" % (time.monotonic() - start), out)
+            out.flush()
+
+    async def run():
+        async with BleakScanner(on_advertisement):
+            await asyncio.sleep(seconds)
+
+    asyncio.run(run())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", default="-", help="hex capture file ('-' for stdin)")
+    parser.add_argument("--live", action="store_true", help="scan for beacons instead (needs bleak)")
+    parser.add_argument("--seconds", type=float, default=30.0, help="live scan length")
+    args = parser.parse_args()
+
+    decoder = BeaconDecoder()
+    # time: seconds since the scan started, or line number of the capture
+    sys.stdout.write("time,node,frame,reading,value\n")
+    if args.live:
+        decode_live(decoder, sys.stdout, args.seconds)
+    else:
+        decode_capture(args.capture, decoder, sys.stdout)
+    summary(decoder, sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Central side of the BLE benchmark (firmware/projects/ble_benchmark).
+
+For every connection interval of the sweep it asks the board for the interval
+(command C), measures the write - notification round trip with pings (command
+P) and runs a throughput test (command T). The board fills the data
+characteristic (0xFFE1) with 16 bytes records, little endian:
+
+    byte 0      0xB5 (magic)
+    byte 1      record version
+    byte 2-5    sequence number
+    byte 6-13   time stamp on the board (us)
+    byte 14-15  sum of bytes 0 to 13
+
+Records are rebuilt from the notifications, sequence gaps are counted as lost
+records. At the end of every test the board sends its own counters in a text
+line starting with "#S". Needs the `bleak` package and a Bluetooth adapter:
+
+    python3 ble_bench.py AA:BB:CC:DD:EE:FF --intervals 6,12,24,40
+
+Without a radio use the simulated link instead (ble_benchmark/host).
+"""
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+DATA_CHAR_UUID = "0000ffe1-0000-1000-8000-00805f9b34fb"
+RECORD = struct.Struct("<BBIqH")
+RECORD_MAGIC = 0xB5
+RECORD_VERSION = 1
+
+
+class RecordReceiver:
+    """Rebuilds records from the byte stream, same rules as bench_record.c."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.lines = []
+        self.next_seq = None
+        self.records = 0
+        self.lost = 0
+        self.corrupted = 0
+        self.bytes = 0
+        self.first = None
+        self.last = None
+
+    def feed(self, data):
+        now = time.monotonic()
+        self.first = self.first if self.first is not None else now
+        self.last = now
+        self.bytes += len(data)
+        for byte in data:
+            if self.text or (not self.buf and byte == ord("#")):
+                self._text(byte)
+            elif not self.buf and byte != RECORD_MAGIC:
+                self.corrupted += 1
+            else:
+                self.buf.append(byte)
+                if len(self.buf) == RECORD.size:
+                    self._record()
+
+    def _text(self, byte):
+        if byte == ord("\n"):
+            self.lines.append(self.text.decode(errors="replace"))
+            self.text.clear()
+        else:
+            self.text.append(byte)
+
+    def _record(self):
+        magic, version, seq, _, checksum = RECORD.unpack(self.buf)
+        if version != RECORD_VERSION or sum(self.buf[:-2]) & 0xFFFF != checksum:
+            # resync one byte after the false start
+            self.corrupted += 1
+            del self.buf[0]
+            while self.buf and self.buf[0] != RECORD_MAGIC:
+                self.corrupted += 1
+                del self.buf[0]
+            return
+        self.buf.clear()
+        if self.next_seq is not None and seq != self.next_seq:
+            self.lost += (seq - self.next_seq) & 0xFFFFFFFF
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+        self.records += 1
+
+
+async def wait_line(receiver, prefix, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for line in receiver.lines:
+            if line.startswith(prefix):
+                receiver.lines.remove(line)
+                return line
+        await asyncio.sleep(0.01)
+    return None
+
+
+async def ping(client, pongs, count):
+    """Round trip of a write answered by a notification, in ms."""
+    times = []
+    for i in range(count):
+        payload = ("P%03d" % i).encode()
+        pongs.clear()
+        start = time.monotonic()
+        await client.write_gatt_char(DATA_CHAR_UUID, payload, response=False)
+        while payload not in pongs and time.monotonic() - start < 2.0:
+            await asyncio.sleep(0.001)
+        if payload in pongs:
+            times.append((time.monotonic() - start) * 1000.0)
+    return times
+
+
+async def run(args):
+    from bleak import BleakClient
+
+    async with BleakClient(args.address) as client:
+        receiver = RecordReceiver()
+        pongs = []
+
+        def on_notify(_, data):
+            data = bytes(data)
+            if data.startswith(b"P"):
+                pongs.append(data)
+            else:
+                receiver.feed(data)
+
+        await client.start_notify(DATA_CHAR_UUID, on_notify)
+        print("# mtu %d, %d ms tests" % (client.mtu_size, args.ms))
+        print("# ci   thr_kB/s  rtt_ms  rtt_max   records   lost  corrupt  board")
+        for interval in args.intervals:
+            await client.write_gatt_char(DATA_CHAR_UUID, b"C%d,%d" % (interval, interval), response=True)
+            await asyncio.sleep(1.0)        # the central takes a few events to apply it
+            rtt = await ping(client, pongs, args.pings)
+            receiver.__init__()
+            await client.write_gatt_char(DATA_CHAR_UUID, b"T%d" % args.ms, response=True)
+            stats = await wait_line(receiver, "#S", args.ms / 1000.0 + 10.0)
+            elapsed = (receiver.last - receiver.first) if receiver.first is not None else 0
+            thr = receiver.bytes / elapsed / 1000.0 if elapsed > 0 else 0.0
+            print("%4d %10.2f %7.2f %8.2f %9d %6d %8d  %s" % (
+                interval, thr, sum(rtt) / len(rtt) if rtt else 0.0, max(rtt) if rtt else 0.0,
+                receiver.records, receiver.lost, receiver.corrupted, stats[3:] if stats else "no stats"))
+            sys.stdout.flush()
+        await client.stop_notify(DATA_CHAR_UUID)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("address", help="board address (or UUID on macOS)")
+    parser.add_argument("--intervals", default="6,12,24,40",
+                        help="connection intervals to test, x 1.25 ms")
+    parser.add_argument("--ms", type=int, default=5000, help="length of every throughput test")
+    parser.add_argument("--pings", type=int, default=20, help="pings per interval")
+    args = parser.parse_args()
+    args.intervals = [int(i) for i in args.intervals.split(",")]
+    asyncio.run(run(args))
+
+
+if __name__ == "__main__":
+    main()
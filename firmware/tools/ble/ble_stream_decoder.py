@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Reference decoder for the ble_mcu binary sensor stream (characteristic 0xFFE2).
+
+Every notification holds one packet, little endian:
+
+    byte 0    stream id
+    byte 1    header version (high nibble) | sample format (low nibble)
+    byte 2-3  sequence number, per stream
+    byte 4-7  time stamp of the first sample (us, low 32 bits)
+    byte 8-   samples
+
+Packets are reordered inside a small window and sequence gaps are reported as
+lost packets. Input is a capture with one notification per line in hex (as
+exported by nRF Connect or printed by a gateway), or a live connection when the
+optional `bleak` package is installed:
+
+    python3 ble_stream_decoder.py capture.txt > samples.csv
+    python3 ble_stream_decoder.py --live AA:BB:CC:DD:EE:FF > samples.csv
+"""
+import argparse
+import struct
+import sys
+from dataclasses import dataclass, field
+
+HEADER = struct.Struct("<BBHI")
+HEADER_VERSION = 1
+STREAM_CHAR_UUID = "0000ffe2-0000-1000-8000-00805f9b34fb"
+
+# ble_stream_format_t -> struct format character
+FORMATS = {0: "b", 1: "B", 2: "h", 3: "H", 4: "i", 5: "f"}
+
+
+@dataclass
+class Packet:
+    stream_id: int
+    fmt: int
+    seq: int
+    timestamp_us: int
+    samples: tuple
+
+
+@dataclass
+class StreamState:
+    next_seq: int = None
+    pending: dict = field(default_factory=dict)
+    received: int = 0
+    lost: int = 0
+    duplicated: int = 0
+    time_base: int = 0
+    last_stamp: int = None
+
+
+def parse_packet(data):
+    """Decode one notification payload into a Packet."""
+    if len(data) < HEADER.size:
+        raise ValueError("packet shorter than the header")
+    stream_id, ver_fmt, seq, stamp = HEADER.unpack_from(data)
+    version, fmt = ver_fmt >> 4, ver_fmt & 0x0F
+    if version != HEADER_VERSION:
+        raise ValueError("unsupported header version %d" % version)
+    if fmt not in FORMATS:
+        raise ValueError("unknown sample format %d" % fmt)
+    size = struct.calcsize(FORMATS[fmt])
+    count = (len(data) - HEADER.size) // size
+    samples = struct.unpack_from("<%d%s" % (count, FORMATS[fmt]), data, HEADER.size)
+    return Packet(stream_id, fmt, seq, stamp, samples)
+
+
+class StreamDecoder:
+    """Reorders packets per stream and accounts for lost ones.
+
+    A packet is released once it is the next expected sequence number, or when
+    more than `window` newer packets are waiting (the missing ones are then
+    declared lost).
+    """
+
+    def __init__(self, window=16):
+        self.window = window
+        self.streams = {}
+
+    def feed(self, packet):
+        """Add a packet, returns the list of packets released in order."""
+        st = self.streams.setdefault(packet.stream_id, StreamState())
+        if st.next_seq is None:
+            st.next_seq = packet.seq
+        ahead = (packet.seq - st.next_seq) & 0xFFFF
+        if ahead >= 0x8000 or packet.seq in st.pending:
+            st.duplicated += 1          # older than the window or repeated
+            return []
+        st.pending[packet.seq] = packet
+        released = []
+        while st.pending:
+            if st.next_seq in st.pending:
+                released.append(self._release(st, st.pending.pop(st.next_seq)))
+            elif len(st.pending) > self.window:
+                st.lost += 1
+            else:
+                break
+            st.next_seq = (st.next_seq + 1) & 0xFFFF
+        return released
+
+    def flush(self):
+        """Release everything still waiting, counting the holes as lost."""
+        released = []
+        for st in self.streams.values():
+            while st.pending:
+                if st.next_seq in st.pending:
+                    released.append(self._release(st, st.pending.pop(st.next_seq)))
+                else:
+                    st.lost += 1
+                st.next_seq = (st.next_seq + 1) & 0xFFFF
+        return released
+
+    @staticmethod
+    def _release(st, packet):
+        # extend the 32 bits time stamp, packets are already in order here
+        if st.last_stamp is not None and packet.timestamp_us < st.last_stamp:
+            st.time_base += 1 << 32
+        st.last_stamp = packet.timestamp_us
+        packet.timestamp_us += st.time_base
+        st.received += 1
+        return packet
+
+
+def write_csv(packets, period_us, out):
+    for p in packets:
+        for i, value in enumerate(p.samples):
+            t = p.timestamp_us + i * period_us.get(p.stream_id, 0)
+            out.write("%d,%d,%d,%s\n" % (p.stream_id, p.seq, t, value))
+
+
+def summary(decoder, out):
+    for sid, st in sorted(decoder.streams.items()):
+        total = st.received + st.lost
+        loss = 100.0 * st.lost / total if total else 0.0
+        out.write("stream %d: %d packets, %d lost (%.2f %%), %d duplicated/late\n"
+                  % (sid, st.received, st.lost, loss, st.duplicated))
+
+
+def decode_capture(path, decoder, period_us, out):
+    src = sys.stdin if path == "-" else open(path)
+    with src:
+        for line in src:
+            text = line.strip().replace("0x", "").replace("-", "").replace(":", "").replace(" ", "")
+            if not text or text.startswith("#"):
+                continue
+            write_csv(decoder.feed(parse_packet(bytes.fromhex(text))), period_us, out)
+    write_csv(decoder.flush(), period_us, out)
+
+
+def decode_live(address, decoder, period_us, out, seconds):
+    import asyncio
+    from bleak import BleakClient
+
+    async def run():
+        async with BleakClient(address) as client:
+            def on_notify(_, data):
+                write_csv(decoder.feed(parse_packet(bytes(data))), period_us, out)
+            await client.start_notify(STREAM_CHAR_UUID, on_notify)
+            await asyncio.sleep(seconds)
+            await client.stop_notify(STREAM_CHAR_UUID)
+
+    asyncio.run(run())
+    write_csv(decoder.flush(), period_us, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", default="-", help="hex capture file ('-' for stdin)")
+    parser.add_argument("--live", metavar="ADDRESS", help="connect to the device instead (needs bleak)")
+    parser.add_argument("--seconds", type=float, default=30.0, help="live capture length")
+    parser.add_argument("--window", type=int, default=16, help="reorder window in packets")
+    parser.add_argument("--period", action="append", default=[], metavar="ID:US",
+                        help="sample period of a stream, to time stamp every sample")
+    args = parser.parse_args()
+
+    period_us = {}
+    for item in args.period:
+        sid, us = item.split(":")
+        period_us[int(sid)] = int(us)
+    decoder = StreamDecoder(args.window)
+    sys.stdout.write("stream,seq,time_us,value\n")
+    if args.live:
+        decode_live(args.live, decoder, period_us, sys.stdout, args.seconds)
+    else:
+        decode_capture(args.capture, decoder, period_us, sys.stdout)
+    summary(decoder, sys.stderr)
+
+
+if __name__ == "__main__":
+    main()